@@ -0,0 +1,137 @@
+#include <benchmark/benchmark.h>
+
+#include <Database.hpp>
+#include <Filter.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+constexpr int kRows = 1 << 16;
+
+std::string tableName = "readings";
+
+void createTable()
+{
+    static std::once_flag created;
+    std::call_once(
+        created,
+        []
+        {
+            // DEBUG builds trace every insert to stdout
+            auto* coutBuffer = std::cout.rdbuf(nullptr);
+            auto& database = db::Database::getInstance();
+            database.execute("create table readings ({key, autoincrement} "
+                             "id : int32, sensor: int32, value: int32)");
+            for (int i = 0; i < kRows; ++i)
+            {
+                database.insert(tableName, { { "sensor", i % 64 },
+                                             { "value", (i * 7919) % 1000 } });
+            }
+            std::cout.rdbuf(coutBuffer);
+        });
+}
+
+// sensor = 17, about one row in 64
+std::unique_ptr<db::filters::Filter> sensorFilter()
+{
+    return std::make_unique<db::filters::ComparisonFilter>(
+        "sensor", db::filters::ComparisonFilter::EQUAL, 17);
+}
+
+// Every thread runs selects, they only share the lock of the table
+void BM_ConcurrentSelect(benchmark::State& state)
+{
+    createTable();
+    auto& database = db::Database::getInstance();
+    std::vector<std::string> selectAll{};
+    for (auto _ : state)
+    {
+        auto lock = database.lockShared(tableName);
+        auto view = database.select(tableName, selectAll, sensorFilter());
+        benchmark::DoNotOptimize(view->size());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Thread 0 updates the table while the others keep selecting
+void BM_SelectWithWriter(benchmark::State& state)
+{
+    createTable();
+    auto& database = db::Database::getInstance();
+    std::vector<std::string> selectAll{};
+    for (auto _ : state)
+    {
+        if (state.thread_index() == 0)
+        {
+            database.update(tableName, sensorFilter(), { { "value", 1 } });
+            continue;
+        }
+        auto lock = database.lockShared(tableName);
+        auto view = database.select(tableName, selectAll, sensorFilter());
+        benchmark::DoNotOptimize(view->size());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Latency of single row updates while state.range(0) threads keep
+// scanning the whole table, the readers work on snapshots and never hold
+// the writer off
+void BM_UpdateLatencyUnderScans(benchmark::State& state)
+{
+    createTable();
+    auto& database = db::Database::getInstance();
+    std::atomic<bool> done = false;
+    std::vector<std::jthread> readers;
+    for (int64_t i = 0; i < state.range(0); ++i)
+    {
+        readers.emplace_back(
+            [&]
+            {
+                std::vector<std::string> selectAll{};
+                while (!done.load(std::memory_order_relaxed))
+                {
+                    auto lock = database.lockShared(tableName);
+                    auto view = database.select(tableName, selectAll, nullptr);
+                    int64_t sum = 0;
+                    for (size_t row = 0; row < view->size(); ++row)
+                    {
+                        sum += std::get<int>(view->value(row, "value"));
+                    }
+                    benchmark::DoNotOptimize(sum);
+                }
+            });
+    }
+    int id = 0;
+    for (auto _ : state)
+    {
+        database.update(tableName,
+                        std::make_unique<db::filters::ComparisonFilter>(
+                            "id", db::filters::ComparisonFilter::EQUAL, id),
+                        { { "value", id % 1000 } });
+        id = (id + 4099) % kRows;
+    }
+    done = true;
+    state.SetItemsProcessed(state.iterations());
+}
+
+} // namespace
+
+BENCHMARK(BM_ConcurrentSelect)
+    ->ThreadRange(1, std::max(1u, std::thread::hardware_concurrency()))
+    ->UseRealTime();
+BENCHMARK(BM_SelectWithWriter)
+    ->ThreadRange(2, std::max(2u, std::thread::hardware_concurrency()))
+    ->UseRealTime();
+
+BENCHMARK(BM_UpdateLatencyUnderScans)->Arg(0)->Arg(1)->Arg(3)->UseRealTime();
+
+BENCHMARK_MAIN();
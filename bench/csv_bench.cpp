@@ -0,0 +1,130 @@
+#include <benchmark/benchmark.h>
+
+#include <Column.hpp>
+#include <CsvWriter.hpp>
+#include <Helpers.hpp>
+#include <Table.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+constexpr int kRows = 1 << 20;
+
+struct Rows
+{
+    std::vector<int> ids;
+    std::vector<int> amounts;
+    std::vector<bool> flags;
+    std::vector<std::string> tags;
+};
+
+const Rows& rows()
+{
+    static auto data = []
+    {
+        Rows data;
+        for (int i = 0; i < kRows; ++i)
+        {
+            data.ids.push_back(i);
+            data.amounts.push_back(i % 10007 - 5000);
+            data.flags.push_back(i % 3 == 0);
+            // every tenth tag needs quoting
+            data.tags.push_back(i % 10 == 0 ? "tag," + std::to_string(i)
+                                            : "tag" + std::to_string(i % 1000));
+        }
+        return data;
+    }();
+    return data;
+}
+
+std::filesystem::path outputPath()
+{
+    return std::filesystem::temp_directory_path() / "small-sql-csv-bench.csv";
+}
+
+// The writer serializeCSV used before: std::endl after every row, fields
+// built with std::to_string and escapeCSVField
+void BM_OfstreamEndl(benchmark::State& state)
+{
+    auto&& data = rows();
+    for (auto _ : state)
+    {
+        std::ofstream file(outputPath());
+        for (int row = 0; row < kRows; ++row)
+        {
+            file << std::to_string(data.ids[row]) << ",";
+            file << std::to_string(data.amounts[row]) << ",";
+            file << (data.flags[row] ? "true" : "false") << ",";
+            file << db::escapeCSVField(data.tags[row]);
+            file << std::endl;
+        }
+        file.close();
+    }
+    state.SetBytesProcessed(state.iterations() *
+                            std::filesystem::file_size(outputPath()));
+    state.SetItemsProcessed(state.iterations() * kRows);
+}
+
+void BM_CsvWriter(benchmark::State& state)
+{
+    auto&& data = rows();
+    for (auto _ : state)
+    {
+        db::csv::Writer file(outputPath(), { .direct = state.range(0) != 0 });
+        for (int row = 0; row < kRows; ++row)
+        {
+            file.field(data.ids[row]);
+            file.field(data.amounts[row]);
+            file.field(static_cast<bool>(data.flags[row]));
+            file.field(data.tags[row]);
+            file.endRow();
+        }
+        file.close();
+    }
+    state.SetBytesProcessed(state.iterations() *
+                            std::filesystem::file_size(outputPath()));
+    state.SetItemsProcessed(state.iterations() * kRows);
+}
+
+void BM_SerializeCSV(benchmark::State& state)
+{
+    // DEBUG builds trace every insert to stdout
+    auto* coutBuffer = std::cout.rdbuf(nullptr);
+    auto&& data = rows();
+    db::Table table(
+        "events", std::vector<db::Table::ColumnType>{
+                      std::make_shared<db::columns::Integer>("amount"),
+                      std::make_shared<db::columns::Bool>("flag"),
+                      std::make_shared<db::columns::String>("tag", 16) });
+    for (int row = 0; row < kRows; ++row)
+    {
+        table.insert({ { "amount", data.amounts[row] },
+                       { "flag", static_cast<bool>(data.flags[row]) },
+                       { "tag", data.tags[row] } });
+    }
+    std::cout.rdbuf(coutBuffer);
+
+    for (auto _ : state)
+    {
+        table.serializeCSV(outputPath());
+    }
+    state.SetBytesProcessed(state.iterations() *
+                            std::filesystem::file_size(outputPath()));
+    state.SetItemsProcessed(state.iterations() * kRows);
+}
+
+} // namespace
+
+BENCHMARK(BM_OfstreamEndl)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_CsvWriter)->ArgName("direct")->Arg(0)->Arg(1)->Unit(
+    benchmark::kMillisecond);
+BENCHMARK(BM_SerializeCSV)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,181 @@
+#include <benchmark/benchmark.h>
+
+#include <CsvReader.hpp>
+#include <Helpers.hpp>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+
+constexpr int kRows = 1 << 16;
+
+// The routines Helpers.cpp had before the tokenizer: one character at a
+// time, escaping with find and insert
+std::string escapeScalar(const std::string& field)
+{
+    std::string escaped = field;
+    size_t pos = 0;
+    while ((pos = escaped.find('"', pos)) != std::string::npos)
+    {
+        escaped.insert(pos, 1, '"');
+        pos += 2;
+    }
+    if (escaped.find(',') != std::string::npos ||
+        escaped.find('"') != std::string::npos)
+    {
+        escaped = "\"" + escaped + "\"";
+    }
+    return escaped;
+}
+
+std::vector<std::string> parseScalar(const std::string& line)
+{
+    std::vector<std::string> fields;
+    std::string field;
+    bool inQuotes = false;
+
+    for (size_t i = 0; i < line.length(); ++i)
+    {
+        char c = line[i];
+        if (c == '"')
+        {
+            inQuotes = !inQuotes;
+            if (inQuotes && i + 1 < line.length() && line[i + 1] == '"')
+            {
+                field += '"';
+                ++i;
+            }
+        }
+        else if (c == ',' && !inQuotes)
+        {
+            fields.push_back(field);
+            field.clear();
+        }
+        else
+        {
+            field += c;
+        }
+    }
+    fields.push_back(field);
+    return fields;
+}
+
+// Rows of a user, an amount, a flag, a free text note and a short tag;
+// every eighth note needs quoting
+const std::vector<std::string>& lines()
+{
+    static auto data = []
+    {
+        std::vector<std::string> data;
+        for (int i = 0; i < kRows; ++i)
+        {
+            std::string note = "customer note number " + std::to_string(i) +
+                               " with some more words in it";
+            if (i % 8 == 0)
+            {
+                note = db::escapeCSVField(note + ", said \"ok\"");
+            }
+            data.push_back(std::to_string(i * 7919) + "," +
+                           std::to_string(i % 10007 - 5000) + "," +
+                           (i % 3 == 0 ? "true" : "false") + "," + note +
+                           ",tag" + std::to_string(i % 1000));
+        }
+        return data;
+    }();
+    return data;
+}
+
+size_t totalBytes()
+{
+    size_t bytes = 0;
+    for (auto&& line : lines())
+    {
+        bytes += line.size() + 1;
+    }
+    return bytes;
+}
+
+void BM_ParseLineScalar(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        for (auto&& line : lines())
+        {
+            benchmark::DoNotOptimize(parseScalar(line));
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * totalBytes());
+}
+
+void BM_ParseLine(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        for (auto&& line : lines())
+        {
+            benchmark::DoNotOptimize(db::parseCSVLine(line));
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * totalBytes());
+}
+
+// Field views over the whole text, the way the table loader walks it
+void BM_Tokenize(benchmark::State& state)
+{
+    std::string text;
+    for (auto&& line : lines())
+    {
+        text += line;
+        text += '\n';
+    }
+    for (auto _ : state)
+    {
+        db::csv::Tokenizer tokens(text);
+        std::string_view field;
+        bool rowEnd = false;
+        size_t fields = 0;
+        while (tokens.next(field, rowEnd))
+        {
+            fields += field.size();
+        }
+        benchmark::DoNotOptimize(fields);
+    }
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+
+void BM_EscapeScalar(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        for (auto&& line : lines())
+        {
+            benchmark::DoNotOptimize(escapeScalar(line));
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * totalBytes());
+}
+
+void BM_Escape(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        for (auto&& line : lines())
+        {
+            benchmark::DoNotOptimize(db::escapeCSVField(line));
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * totalBytes());
+}
+
+} // namespace
+
+BENCHMARK(BM_ParseLineScalar)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ParseLine)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Tokenize)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_EscapeScalar)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Escape)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
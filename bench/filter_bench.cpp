@@ -0,0 +1,145 @@
+#include <benchmark/benchmark.h>
+
+#include <Column.hpp>
+#include <Filter.hpp>
+#include <Table.hpp>
+
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+constexpr int kRows = 1 << 18;
+
+db::Table& samples()
+{
+    static auto table = []
+    {
+        // DEBUG builds trace every insert to stdout
+        auto* coutBuffer = std::cout.rdbuf(nullptr);
+        auto table = std::make_unique<db::Table>(
+            "samples", std::vector<db::Table::ColumnType>{
+                           std::make_shared<db::columns::Integer>("bucket"),
+                           std::make_shared<db::columns::Integer>("shard"),
+                           std::make_shared<db::columns::Bool>("flag"),
+                           std::make_shared<db::columns::String>("tag", 8) });
+        for (int i = 0; i < kRows; ++i)
+        {
+            table->insert({ { "bucket", i % 1000 },
+                            { "shard", (i * 7) % 16 },
+                            { "flag", i % 3 == 0 },
+                            { "tag", std::to_string(i % 10) } });
+        }
+        std::cout.rdbuf(coutBuffer);
+        return table;
+    }();
+    return *table;
+}
+
+// (bucket < 100 || shard = 3) && !(flag = true) && tag != "5"
+std::unique_ptr<db::filters::Filter> complexFilter()
+{
+    using db::filters::ComparisonFilter;
+    using db::filters::LogicalFilter;
+    auto range = std::make_unique<LogicalFilter>(
+        LogicalFilter::OR,
+        std::make_unique<ComparisonFilter>("bucket",
+                                           ComparisonFilter::LESS_THAN, 100),
+        std::make_unique<ComparisonFilter>("shard", ComparisonFilter::EQUAL,
+                                           3));
+    auto notFlag = std::make_unique<db::filters::NotFilter>(
+        std::make_unique<ComparisonFilter>("flag", ComparisonFilter::EQUAL,
+                                           true));
+    auto tag = std::make_unique<ComparisonFilter>(
+        "tag", ComparisonFilter::NOT_EQUAL, std::string("5"));
+    auto filter = std::make_unique<LogicalFilter>(
+        LogicalFilter::AND,
+        std::make_unique<LogicalFilter>(LogicalFilter::AND, std::move(range),
+                                        std::move(notFlag)),
+        std::move(tag));
+    filter->bind(samples());
+    return filter;
+}
+
+std::vector<size_t> allRows()
+{
+    std::vector<size_t> rows(kRows);
+    std::iota(rows.begin(), rows.end(), 0);
+    return rows;
+}
+
+// One virtual matches() call per node and row
+void BM_TreeWalker(benchmark::State& state)
+{
+    auto& table = samples();
+    auto filter = complexFilter();
+    for (auto _ : state)
+    {
+        size_t matched = 0;
+        for (size_t row = 0; row < kRows; ++row)
+        {
+            matched += filter->matches(row, table) ? 1 : 0;
+        }
+        benchmark::DoNotOptimize(matched);
+    }
+    state.SetItemsProcessed(state.iterations() * kRows);
+}
+
+// Batch-at-a-time tree evaluation over selection vectors
+void BM_TreeBatch(benchmark::State& state)
+{
+    auto& table = samples();
+    auto filter = complexFilter();
+    auto rows = allRows();
+    db::filters::Selection selection;
+    for (auto _ : state)
+    {
+        size_t matched = 0;
+        for (size_t begin = 0; begin < rows.size();
+             begin += db::filters::kBatchSize)
+        {
+            selection.assign(rows.begin() + begin,
+                             rows.begin() + begin + db::filters::kBatchSize);
+            filter->filterBatch(selection, table);
+            matched += selection.size();
+        }
+        benchmark::DoNotOptimize(matched);
+    }
+    state.SetItemsProcessed(state.iterations() * kRows);
+}
+
+void BM_Bytecode(benchmark::State& state)
+{
+    auto& table = samples();
+    auto filter = complexFilter();
+    auto program = db::filters::Program::compile(*filter, table);
+    auto rows = allRows();
+    db::filters::Selection selection;
+    db::filters::Program::Registers registers;
+    for (auto _ : state)
+    {
+        size_t matched = 0;
+        for (size_t begin = 0; begin < rows.size();
+             begin += db::filters::kBatchSize)
+        {
+            selection.assign(rows.begin() + begin,
+                             rows.begin() + begin + db::filters::kBatchSize);
+            program.filterBatch(selection, registers);
+            matched += selection.size();
+        }
+        benchmark::DoNotOptimize(matched);
+    }
+    state.SetItemsProcessed(state.iterations() * kRows);
+}
+
+} // namespace
+
+BENCHMARK(BM_TreeWalker)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_TreeBatch)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Bytecode)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,130 @@
+#include <benchmark/benchmark.h>
+
+#include <Column.hpp>
+#include <Table.hpp>
+#include <Wal.hpp>
+
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+// Same layout as the `users` table from tests/tests.cpp
+std::vector<db::Table::ColumnType> usersSchema()
+{
+    return { std::make_shared<db::columns::Integer>("id", 0, false, true, true,
+                                                    true),
+             std::make_shared<db::columns::String>("login", 32, "", false,
+                                                   true),
+             std::make_shared<db::columns::Bytes>("password_hash", 8),
+             std::make_shared<db::columns::Bool>("is_admin") };
+}
+
+void BM_SequentialUserInserts(benchmark::State& state)
+{
+    // DEBUG builds trace every insert to stdout
+    auto* coutBuffer = std::cout.rdbuf(nullptr);
+
+    db::columns::Bytes::value_type hash{ 0xde, 0xad, 0xbe, 0xef };
+    for (auto _ : state)
+    {
+        db::Table users{ "users", usersSchema() };
+        for (int64_t i = 0; i < state.range(0); ++i)
+        {
+            users.insert({ { "login", "user_" + std::to_string(i) },
+                           { "password_hash", hash },
+                           { "is_admin", false } });
+        }
+        benchmark::DoNotOptimize(users.size());
+    }
+    state.SetComplexityN(state.range(0));
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+
+    std::cout.rdbuf(coutBuffer);
+}
+
+// The same rows in one batch: one writer lock, one commit and the ordered
+// indexes filled once at the end
+void BM_BatchedUserInserts(benchmark::State& state)
+{
+    auto* coutBuffer = std::cout.rdbuf(nullptr);
+
+    db::columns::Bytes::value_type hash{ 0xde, 0xad, 0xbe, 0xef };
+    for (auto _ : state)
+    {
+        db::Table users{ "users", usersSchema() };
+        db::Table::Batch batch{ users };
+        for (int64_t i = 0; i < state.range(0); ++i)
+        {
+            batch.insert({ { "login", "user_" + std::to_string(i) },
+                           { "password_hash", hash },
+                           { "is_admin", false } });
+        }
+        batch.commit();
+        benchmark::DoNotOptimize(users.size());
+    }
+    state.SetComplexityN(state.range(0));
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+
+    std::cout.rdbuf(coutBuffer);
+}
+
+// 1024 logged inserts with fsyncs, state.range(0) of them per batch: each
+// batch is one log append waiting for one sync
+void BM_LoggedUserInserts(benchmark::State& state)
+{
+    auto* coutBuffer = std::cout.rdbuf(nullptr);
+    auto path = std::filesystem::temp_directory_path() /
+                "small-sql-insert-bench.log";
+
+    db::columns::Bytes::value_type hash{ 0xde, 0xad, 0xbe, 0xef };
+    constexpr int64_t kInserts = 1024;
+    for (auto _ : state)
+    {
+        std::filesystem::remove(path);
+        db::Table users{ "users", usersSchema() };
+        users.setLog(std::make_shared<db::wal::Log>(path));
+        for (int64_t first = 0; first < kInserts; first += state.range(0))
+        {
+            db::Table::Batch batch{ users };
+            for (int64_t i = first; i < first + state.range(0); ++i)
+            {
+                batch.insert({ { "login", "user_" + std::to_string(i) },
+                               { "password_hash", hash },
+                               { "is_admin", false } });
+            }
+            batch.commit();
+        }
+        benchmark::DoNotOptimize(users.size());
+    }
+    state.SetItemsProcessed(state.iterations() * kInserts);
+    std::filesystem::remove(path);
+
+    std::cout.rdbuf(coutBuffer);
+}
+
+} // namespace
+
+BENCHMARK(BM_SequentialUserInserts)
+    ->RangeMultiplier(4)
+    ->Range(1 << 10, 1 << 20)
+    ->Unit(benchmark::kMillisecond)
+    ->Complexity(benchmark::oN);
+BENCHMARK(BM_BatchedUserInserts)
+    ->RangeMultiplier(4)
+    ->Range(1 << 10, 1 << 20)
+    ->Unit(benchmark::kMillisecond)
+    ->Complexity(benchmark::oN);
+BENCHMARK(BM_LoggedUserInserts)
+    ->ArgName("batch")
+    ->Arg(1)
+    ->Arg(64)
+    ->Arg(1024)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
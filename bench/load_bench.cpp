@@ -0,0 +1,107 @@
+#include <benchmark/benchmark.h>
+
+#include <Column.hpp>
+#include <Table.hpp>
+#include <WorkerPool.hpp>
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+constexpr int kRows = 1 << 18;
+
+const std::filesystem::path& savedTable(bool binary)
+{
+    static auto paths = []
+    {
+        // DEBUG builds trace every insert to stdout
+        auto* coutBuffer = std::cout.rdbuf(nullptr);
+        db::Table table(
+            "events", std::vector<db::Table::ColumnType>{
+                          std::make_shared<db::columns::Integer>("user"),
+                          std::make_shared<db::columns::Integer>("amount"),
+                          std::make_shared<db::columns::Bool>("flag"),
+                          std::make_shared<db::columns::String>("tag", 16) });
+        for (int i = 0; i < kRows; ++i)
+        {
+            table.insert({ { "user", i * 7919 },
+                           { "amount", i % 10007 - 5000 },
+                           { "flag", i % 3 == 0 },
+                           { "tag", std::to_string(i % 1000) } });
+        }
+        std::cout.rdbuf(coutBuffer);
+
+        auto directory = std::filesystem::temp_directory_path();
+        std::pair<std::filesystem::path, std::filesystem::path> paths{
+            directory / "small-sql-load-bench.csv",
+            directory / "small-sql-load-bench.bin"
+        };
+        table.serializeCSV(paths.first);
+        table.serialize(paths.second);
+        return paths;
+    }();
+    return binary ? paths.second : paths.first;
+}
+
+void BM_LoadCSV(benchmark::State& state)
+{
+    auto&& path = savedTable(false);
+    // the calling thread parses too
+    size_t threads = static_cast<size_t>(state.range(0));
+    auto workers = threads > 1 ? std::make_shared<db::WorkerPool>(threads - 1)
+                               : nullptr;
+    for (auto _ : state)
+    {
+        db::Table table("events");
+        table.setWorkerPool(workers);
+        table.deserializeCSV(path);
+        benchmark::DoNotOptimize(table.size());
+    }
+    state.SetBytesProcessed(state.iterations() *
+                            std::filesystem::file_size(path));
+    state.SetItemsProcessed(state.iterations() * kRows);
+}
+
+void BM_LoadBinary(benchmark::State& state)
+{
+    auto&& path = savedTable(true);
+    for (auto _ : state)
+    {
+        db::Table table("events");
+        table.deserialize(path);
+        benchmark::DoNotOptimize(table.size());
+    }
+    state.SetBytesProcessed(state.iterations() *
+                            std::filesystem::file_size(path));
+    state.SetItemsProcessed(state.iterations() * kRows);
+}
+
+void BM_MapBinary(benchmark::State& state)
+{
+    auto&& path = savedTable(true);
+    for (auto _ : state)
+    {
+        db::Table table("events");
+        table.map(path);
+        benchmark::DoNotOptimize(table.size());
+    }
+    state.SetItemsProcessed(state.iterations() * kRows);
+}
+
+} // namespace
+
+BENCHMARK(BM_LoadCSV)
+    ->RangeMultiplier(2)
+    ->Range(1, std::max(1u, std::thread::hardware_concurrency()))
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_LoadBinary)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_MapBinary)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,79 @@
+#include <benchmark/benchmark.h>
+
+#include <Column.hpp>
+#include <Filter.hpp>
+#include <Table.hpp>
+#include <WorkerPool.hpp>
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+constexpr int kRows = 1 << 20;
+
+db::Table& samples()
+{
+    static auto table = []
+    {
+        // DEBUG builds trace every insert to stdout
+        auto* coutBuffer = std::cout.rdbuf(nullptr);
+        auto table = std::make_unique<db::Table>(
+            "samples", std::vector<db::Table::ColumnType>{
+                           std::make_shared<db::columns::Integer>("bucket"),
+                           std::make_shared<db::columns::Bool>("flag") });
+        for (int i = 0; i < kRows; ++i)
+        {
+            table->insert({ { "bucket", i % 1000 }, { "flag", i % 3 == 0 } });
+        }
+        std::cout.rdbuf(coutBuffer);
+        return table;
+    }();
+    return *table;
+}
+
+// bucket < 100 && flag == true, about 3% of the rows
+std::unique_ptr<db::filters::Filter> scanFilter()
+{
+    using db::filters::ComparisonFilter;
+    return std::make_unique<db::filters::LogicalFilter>(
+        db::filters::LogicalFilter::AND,
+        std::make_unique<ComparisonFilter>("bucket",
+                                           ComparisonFilter::LESS_THAN, 100),
+        std::make_unique<ComparisonFilter>("flag", ComparisonFilter::EQUAL,
+                                           true));
+}
+
+void BM_ParallelScan(benchmark::State& state)
+{
+    auto& table = samples();
+    // the calling thread scans too
+    size_t threads = static_cast<size_t>(state.range(0));
+    table.setWorkerPool(threads > 1
+                            ? std::make_shared<db::WorkerPool>(threads - 1)
+                            : nullptr);
+
+    std::vector<std::string> selectAll{};
+    for (auto _ : state)
+    {
+        auto view = table.select(selectAll, scanFilter());
+        benchmark::DoNotOptimize(view->size());
+    }
+    state.SetItemsProcessed(state.iterations() * kRows);
+
+    table.setWorkerPool(nullptr);
+}
+
+} // namespace
+
+BENCHMARK(BM_ParallelScan)
+    ->RangeMultiplier(2)
+    ->Range(1, std::max(1u, std::thread::hardware_concurrency()))
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
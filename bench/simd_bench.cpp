@@ -0,0 +1,95 @@
+#include <benchmark/benchmark.h>
+
+#include <Column.hpp>
+#include <Simd.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace
+{
+
+constexpr size_t kValues = 1 << 20;
+
+std::vector<int32_t> makeValues()
+{
+    std::vector<int32_t> values(kValues);
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        values[i] = static_cast<int32_t>((i * 2654435761u) % 1000);
+    }
+    return values;
+}
+
+void BM_CompareInt32(benchmark::State& state)
+{
+    auto level = static_cast<db::simd::Level>(state.range(0));
+    auto values = makeValues();
+    std::vector<uint64_t> mask(db::simd::maskWords(values.size()));
+
+    for (auto _ : state)
+    {
+        db::simd::compareInt32(values.data(), values.size(),
+                               db::simd::CompareOp::Less, 500, mask.data(),
+                               level);
+        benchmark::DoNotOptimize(mask.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetLabel(db::simd::levelName(level));
+    state.SetItemsProcessed(state.iterations() * values.size());
+    state.SetBytesProcessed(state.iterations() * values.size() *
+                            sizeof(int32_t));
+}
+
+// What a row store pays: one std::variant comparison per value
+void BM_CompareVariant(benchmark::State& state)
+{
+    auto values = makeValues();
+    std::vector<db::columns::BaseColumn::value_type> variants(values.begin(),
+                                                              values.end());
+    db::columns::BaseColumn::value_type needle = 500;
+    std::vector<uint64_t> mask(db::simd::maskWords(values.size()));
+
+    for (auto _ : state)
+    {
+        for (size_t i = 0; i < variants.size(); ++i)
+        {
+            if (i % 64 == 0)
+            {
+                mask[i / 64] = 0;
+            }
+            mask[i / 64] |= static_cast<uint64_t>(variants[i] < needle)
+                            << (i % 64);
+        }
+        benchmark::DoNotOptimize(mask.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * values.size());
+}
+
+void BM_CompareBool(benchmark::State& state)
+{
+    std::vector<uint64_t> words(db::simd::maskWords(kValues),
+                                0xA5A5A5A5A5A5A5A5ull);
+    std::vector<uint64_t> mask(words.size());
+
+    for (auto _ : state)
+    {
+        db::simd::compareBool(words.data(), kValues,
+                              db::simd::CompareOp::Equal, false, mask.data());
+        benchmark::DoNotOptimize(mask.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * kValues);
+}
+
+} // namespace
+
+BENCHMARK(BM_CompareInt32)
+    ->Arg(static_cast<int>(db::simd::Level::Scalar))
+    ->Arg(static_cast<int>(db::simd::Level::Sse42))
+    ->Arg(static_cast<int>(db::simd::Level::Avx2));
+BENCHMARK(BM_CompareVariant);
+BENCHMARK(BM_CompareBool);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,126 @@
+#include <benchmark/benchmark.h>
+
+#include <Column.hpp>
+#include <Filter.hpp>
+#include <Table.hpp>
+#include <Wal.hpp>
+
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+std::unique_ptr<db::wal::Log> sharedLog;
+
+// Every thread appends insert entries of a small row, each append waits
+// for its fsync in Full mode. More threads share each fsync.
+void BM_WalAppend(benchmark::State& state)
+{
+    auto path = std::filesystem::temp_directory_path() / "small-sql-wal-bench.log";
+    if (state.thread_index() == 0)
+    {
+        std::filesystem::remove(path);
+        sharedLog = std::make_unique<db::wal::Log>(
+            path, db::wal::Options{ static_cast<db::wal::SyncMode>(
+                      state.range(0)) });
+    }
+    db::wal::Entry entry{ db::wal::kInsert, "events" };
+    entry.values = { 42, std::string("payload"), true };
+    for (auto _ : state)
+    {
+        sharedLog->append(entry);
+    }
+    state.SetItemsProcessed(state.iterations());
+    if (state.thread_index() == 0)
+    {
+        sharedLog.reset();
+        std::filesystem::remove(path);
+    }
+}
+
+// `rows` rows of an indexed key and a value, without a log
+std::unique_ptr<db::Table> readingsTable(int64_t rows)
+{
+    auto table = std::make_unique<db::Table>(
+        "readings",
+        std::vector<db::Table::ColumnType>{
+            std::make_shared<db::columns::Id>(),
+            std::make_shared<db::columns::Integer>("value", 0) });
+    db::Table::Batch batch{ *table };
+    for (int64_t i = 0; i < rows; ++i)
+    {
+        batch.insert({ { "value", static_cast<int>(i % 1000) } });
+    }
+    batch.commit();
+    return table;
+}
+
+// Logged single row updates spread over the table: the log records each
+// row as its position among the current versions, with the versions of
+// earlier updates still in place
+void BM_LoggedPointUpdates(benchmark::State& state)
+{
+    // DEBUG builds trace every statement to stdout
+    auto* coutBuffer = std::cout.rdbuf(nullptr);
+    auto path =
+        std::filesystem::temp_directory_path() / "small-sql-update-bench.log";
+    std::filesystem::remove(path);
+    const int rows = static_cast<int>(state.range(0));
+    auto table = readingsTable(rows);
+    table->setLog(std::make_shared<db::wal::Log>(
+        path, db::wal::Options{ db::wal::SyncMode::Off }));
+    int id = 0;
+    for (auto _ : state)
+    {
+        table->update(std::make_unique<db::filters::ComparisonFilter>(
+                          "id", db::filters::ComparisonFilter::EQUAL, id),
+                      { { "value", id % 1000 } });
+        id = (id + 4099) % rows;
+    }
+    state.SetItemsProcessed(state.iterations());
+    table.reset();
+    std::filesystem::remove(path);
+    std::cout.rdbuf(coutBuffer);
+}
+
+// Replays logged point updates, which find their rows by position
+void BM_ReplayPointUpdates(benchmark::State& state)
+{
+    const int rows = static_cast<int>(state.range(0));
+    auto table = readingsTable(rows);
+    db::wal::Entry entry{ db::wal::kUpdate, "readings" };
+    entry.assignments = { { 1, 7 } };
+    size_t position = 0;
+    for (auto _ : state)
+    {
+        entry.rows = { position };
+        table->replay(entry);
+        position = (position + 4099) % rows;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+} // namespace
+
+BENCHMARK(BM_LoggedPointUpdates)
+    ->ArgName("rows")
+    ->Arg(4096)
+    ->Arg(400000);
+BENCHMARK(BM_ReplayPointUpdates)
+    ->ArgName("rows")
+    ->Arg(4096)
+    ->Arg(400000);
+BENCHMARK(BM_WalAppend)
+    ->ArgName("sync")
+    ->Arg(static_cast<int>(db::wal::SyncMode::Full))
+    ->Arg(static_cast<int>(db::wal::SyncMode::Normal))
+    ->Threads(1)
+    ->Threads(8)
+    ->Threads(32)
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "Storage.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace db
+{
+
+namespace aggregate
+{
+
+enum class Function
+{
+    COUNT,
+    SUM,
+    MIN,
+    MAX,
+    AVG,
+};
+
+// Case-insensitive, std::nullopt for anything but the five functions
+std::optional<Function> functionByName(std::string_view name);
+
+// `function(column)`, `count(*)` has an empty column
+struct Aggregate
+{
+    Function function;
+    std::string column{};
+
+    // Name of the result column, e.g. `sum(points)`
+    std::string name() const;
+};
+
+// `group by columns` with the aggregates of the select list
+struct Grouping
+{
+    std::vector<std::string> columns{};
+    std::vector<Aggregate> aggregates{};
+
+    bool empty() const
+    {
+        return columns.empty() && aggregates.empty();
+    }
+};
+
+// Aggregate resolved to a column of the store, std::nullopt for `count(*)`
+struct BoundAggregate
+{
+    Function function;
+    std::optional<size_t> column{};
+};
+
+// Hash aggregation over rows of a column store. Groups live in an
+// open-addressing table keyed by the encoded group columns, so each worker
+// can fill its own instance and the partial results are merged afterwards.
+// There are no NULLs: aggregates over no rows are 0 or the empty value.
+class HashAggregation
+{
+
+public:
+    HashAggregation(const storage::ColumnStore& store,
+                    std::vector<size_t> groupColumns,
+                    std::vector<BoundAggregate> aggregates);
+
+public:
+    void add(std::span<const size_t> rows);
+
+    // Folds the groups of `other` into this one
+    void merge(const HashAggregation& other);
+
+    size_t size() const
+    {
+        return firstRows_.size();
+    }
+
+    // One row per group in the order their first rows have in the table:
+    // the group columns followed by the aggregates. Without group columns
+    // there is always exactly one row.
+    std::vector<std::vector<storage::ColumnData::value_type>> results() const;
+
+private:
+    struct State
+    {
+        int64_t count = 0;
+        int64_t sum = 0;
+        int64_t low = 0;
+        int64_t high = 0;
+    };
+
+    struct Slot
+    {
+        uint64_t hash = 0;
+        uint32_t group = kEmpty;
+    };
+
+    static constexpr uint32_t kEmpty = UINT32_MAX;
+
+    void encodeKey(size_t row);
+    size_t findOrInsert(uint64_t hash, size_t firstRow);
+    void grow();
+    void update(size_t group, size_t aggregate, size_t row);
+    void combine(size_t group, size_t aggregate, const HashAggregation& other,
+                 size_t otherGroup);
+    storage::ColumnData::value_type finish(size_t group,
+                                           size_t aggregate) const;
+
+private:
+    const storage::ColumnStore& store_;
+    std::vector<size_t> groupColumns_;
+    std::vector<BoundAggregate> aggregates_;
+    // MIN/MAX over strings and bytes keep the extremes as text
+    std::vector<bool> textual_;
+
+    std::vector<Slot> slots_;
+    std::string key_{};
+
+    // per group
+    std::vector<std::string> keys_{};
+    std::vector<uint64_t> hashes_{};
+    std::vector<size_t> firstRows_{};
+    std::vector<State> states_{};
+    std::vector<std::string> texts_{};
+};
+
+} // namespace aggregate
+
+} // namespace db
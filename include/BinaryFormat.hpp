@@ -0,0 +1,276 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <istream>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace db
+{
+
+namespace binary
+{
+
+// Binary table file, little endian throughout:
+//
+//   header   magic "SSQLTBL\0", u32 version, u32 column count,
+//            u64 row count, u32 crc of the previous 24 bytes, u32 zero
+//   blocks   u32 kind, u32 crc of the payload, u64 payload length,
+//            payload, zero padding to a multiple of 8 bytes
+//
+// The first block holds the schema, one block per column follows in column
+// order. Every block starts 8-byte aligned, so fixed-width payloads can be
+// used in place once the file is mapped.
+
+constexpr char kMagic[8] = { 'S', 'S', 'Q', 'L', 'T', 'B', 'L', '\0' };
+
+constexpr uint32_t kVersion = 1;
+
+constexpr size_t kHeaderSize = 32;
+
+constexpr size_t kBlockHeaderSize = 16;
+
+// Block kinds, column blocks use their columns::ColumType
+constexpr uint32_t kSchemaBlock = 0x100;
+
+struct Header
+{
+    uint32_t version = kVersion;
+    uint32_t columnCount = 0;
+    uint64_t rowCount = 0;
+};
+
+// CRC-32C (Castagnoli), continues from `crc`
+uint32_t crc32c(uint32_t crc, const void* data, size_t size);
+
+constexpr size_t padding(size_t size)
+{
+    return (8 - size % 8) % 8;
+}
+
+class Writer
+{
+
+public:
+    explicit Writer(std::ostream& out)
+        : out_(out)
+    {
+    }
+
+public:
+    void header(const Header& header);
+
+    // The length and checksum are patched in by endBlock(),
+    // so the stream must be seekable
+    void beginBlock(uint32_t kind);
+    void endBlock();
+
+    void bytes(const void* data, size_t size);
+
+    template <typename T>
+    void pod(const T& value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        bytes(&value, sizeof(value));
+    }
+
+    // u32 length followed by the bytes
+    void string(std::string_view value);
+
+    // Zero bytes up to the next multiple of 8 inside the block
+    void align();
+
+private:
+    std::ostream& out_;
+    std::streampos blockStart_{};
+    uint64_t blockLength_ = 0;
+    uint32_t crc_ = 0;
+};
+
+// Reads what Writer wrote, every malformed or truncated input throws
+// DatabaseException
+class Reader
+{
+
+public:
+    explicit Reader(std::istream& in)
+        : in_(in)
+    {
+    }
+
+public:
+    Header header();
+
+    // Returns the payload length of the block
+    uint64_t beginBlock(uint32_t kind);
+    // Starts the next block whatever its kind, returns the kind
+    uint32_t nextBlock();
+    // Verifies the checksum, the whole payload must have been read
+    void endBlock();
+
+    void bytes(void* data, size_t size);
+
+    template <typename T>
+    T pod()
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        T value;
+        bytes(&value, sizeof(value));
+        return value;
+    }
+
+    std::string string();
+
+    void align();
+
+    // Throws unless `count` more items of `size` bytes are left in the
+    // payload, checked before allocating for counts taken from the file
+    void require(uint64_t count, size_t size = 1) const;
+
+    // Payload bytes of the current block not read yet
+    uint64_t remaining() const
+    {
+        return blockLength_ - consumed_;
+    }
+
+private:
+    // bytes of the stream left after the current position, unknown for
+    // streams that cannot seek
+    std::optional<uint64_t> available();
+
+private:
+    std::istream& in_;
+    std::optional<std::streampos> end_{};
+    uint64_t blockLength_ = 0;
+    uint64_t consumed_ = 0;
+    uint32_t expectedCrc_ = 0;
+    uint32_t crc_ = 0;
+};
+
+// Whole file mapped copy-on-write: pages are read from the file on first
+// access, writes go to private copies of the touched pages and never reach
+// the file.
+class MappedFile
+{
+
+public:
+    explicit MappedFile(const std::filesystem::path& path);
+
+    MappedFile(const MappedFile&) = delete;
+
+    ~MappedFile();
+
+public:
+    std::span<char> bytes() const
+    {
+        return { data_, size_ };
+    }
+
+    int descriptor() const
+    {
+        return fd_;
+    }
+
+private:
+    int fd_ = -1;
+    char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// `size` bytes of a mapped file at `offset`, mapped again copy-on-write and
+// followed by `room` bytes of zeroed private memory. Values appended after
+// the file bytes stay next to them, the file bytes are never copied; the
+// room is only backed by memory once it is written.
+class MappedRegion
+{
+
+public:
+    MappedRegion(const MappedFile& file, uint64_t offset, size_t size,
+                 size_t room);
+
+    MappedRegion(const MappedRegion&) = delete;
+
+    ~MappedRegion();
+
+public:
+    char* data() const
+    {
+        return data_;
+    }
+
+private:
+    void* base_ = nullptr;
+    size_t length_ = 0;
+    char* data_ = nullptr;
+};
+
+// Walks the column blocks of a mapped table file and hands out their
+// payloads in place. Bounds and alignment are checked like Reader does, but
+// block checksums are not: verifying them would fault in the whole file
+// before the first query.
+class MappedReader
+{
+
+public:
+    // `offset` is the start of the first block to read
+    MappedReader(std::shared_ptr<MappedFile> file, uint64_t offset)
+        : file_(std::move(file)), position_(offset)
+    {
+    }
+
+public:
+    uint64_t beginBlock(uint32_t kind);
+    // The whole payload must have been taken
+    void endBlock();
+
+    // `count` values of T at the current position in a region of their
+    // own, with room for `capacity` values in all
+    template <typename T>
+    std::pair<std::shared_ptr<MappedRegion>, T*> take(uint64_t count,
+                                                      uint64_t capacity)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        require(count, sizeof(T));
+        checkAlignment(alignof(T));
+        auto region = std::make_shared<MappedRegion>(
+            *file_, position_, count * sizeof(T),
+            (std::max(capacity, count) - count) * sizeof(T));
+        position_ += count * sizeof(T);
+        return { region, reinterpret_cast<T*>(region->data()) };
+    }
+
+    void align();
+
+    void require(uint64_t count, size_t size = 1) const;
+
+    uint64_t remaining() const
+    {
+        return blockEnd_ - position_;
+    }
+
+    const std::shared_ptr<MappedFile>& file() const
+    {
+        return file_;
+    }
+
+private:
+    void checkAlignment(size_t alignment) const;
+
+private:
+    std::shared_ptr<MappedFile> file_;
+    uint64_t position_;
+    uint64_t blockEnd_ = 0;
+};
+
+} // namespace binary
+
+} // namespace db
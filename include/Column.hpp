@@ -13,6 +13,13 @@
 
 namespace db
 {
+
+namespace binary
+{
+class Writer;
+class Reader;
+}
+
 namespace columns
 {
 
@@ -28,10 +35,16 @@ enum class ColumType : u_char
 
 class BaseColumn;
 
-void serializeCSV(std::ofstream& file, std::shared_ptr<BaseColumn> column);
+void serializeCSV(std::ostream& file, std::shared_ptr<BaseColumn> column);
 
 std::shared_ptr<BaseColumn> deserializeCSV(std::istringstream& file);
 
+// Column descriptor of the binary table schema block
+void serializeBinary(binary::Writer& out,
+                     const std::shared_ptr<BaseColumn>& column);
+
+std::shared_ptr<BaseColumn> deserializeBinary(binary::Reader& in);
+
 class BaseColumn
 {
 
@@ -73,6 +86,11 @@ public:
         return index_;
     }
 
+    void setIndex(bool index)
+    {
+        index_ = index;
+    }
+
     bool hasDefault() const
     {
         return defaultValue_.has_value();
@@ -92,7 +110,7 @@ public:
 
     virtual size_t getValueSize() = 0;
 
-    friend void columns::serializeCSV(std::ofstream& file,
+    friend void columns::serializeCSV(std::ostream& file,
                                       std::shared_ptr<BaseColumn> column);
 
     friend std::shared_ptr<BaseColumn>
@@ -128,6 +146,17 @@ protected:
     bool key_;
 };
 
+// Hash for column values, lets them key unordered containers
+struct ValueHash
+{
+    size_t operator()(const BaseColumn::value_type& value) const;
+};
+
+// Single value in the binary formats: u8 variant index, then the value
+void serializeValue(binary::Writer& out, const BaseColumn::value_type& value);
+
+BaseColumn::value_type deserializeValue(binary::Reader& in);
+
 class Integer : public BaseColumn
 {
 
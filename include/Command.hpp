@@ -2,6 +2,7 @@
 
 #include "Database.hpp"
 #include "Filter.hpp"
+#include "Join.hpp"
 
 #include "Table.hpp"
 #include <memory>
@@ -61,7 +62,7 @@ public:
 public:
     CommandRetType execute() override
     {
-        Database::getInstance().getTables()[tableName_]->insert(valuesMap_);
+        Database::getInstance().insert(tableName_, valuesMap_);
         return {};
     }
 
@@ -74,8 +75,11 @@ class Select final : public BaseCommand
 {
 
 public:
-    Select(std::string tableName, std::vector<std::string>& selectList, std::unique_ptr<filters::Filter> filter)
-        : tableName_(tableName), selectList_(selectList), filter_(std::move(filter))
+    Select(std::string tableName, std::vector<std::string>& selectList, std::unique_ptr<filters::Filter> filter,
+           std::vector<sort::SortKey> orderBy = {}, Limit limit = {},
+           aggregate::Grouping grouping = {})
+        : tableName_(tableName), selectList_(selectList), filter_(std::move(filter)),
+          orderBy_(std::move(orderBy)), limit_(limit), grouping_(std::move(grouping))
     {
     }
 
@@ -84,7 +88,10 @@ public:
 public:
     CommandRetType execute() override
     {
-        auto view = Database::getInstance().select(tableName_, selectList_, std::move(filter_));
+        auto& database = Database::getInstance();
+        // the view reads the table lazily, reloads wait until it is printed
+        auto lock = database.lockShared(tableName_);
+        auto view = database.select(tableName_, selectList_, std::move(filter_), orderBy_, limit_, grouping_);
         view->print();
         return view;
     }
@@ -93,6 +100,9 @@ private:
     std::string tableName_;
     std::vector<std::string> selectList_;
     std::unique_ptr<filters::Filter> filter_;
+    std::vector<sort::SortKey> orderBy_;
+    Limit limit_;
+    aggregate::Grouping grouping_;
 };
 
 class Update final : public BaseCommand
@@ -145,11 +155,67 @@ private:
     std::unique_ptr<filters::Filter> filter_;
 };
 
+class CreateIndex final : public BaseCommand
+{
+
+public:
+    CreateIndex(std::string tableName, std::string columnName)
+        : tableName_(std::move(tableName)), columnName_(std::move(columnName))
+    {
+    }
+
+    ~CreateIndex() = default;
+
+public:
+    CommandRetType execute() override
+    {
+        Database::getInstance().createIndex(tableName_, columnName_);
+        return {};
+    }
+
+private:
+    std::string tableName_;
+    std::string columnName_;
+};
+
+class DropIndex final : public BaseCommand
+{
+
+public:
+    DropIndex(std::string tableName, std::string columnName)
+        : tableName_(std::move(tableName)), columnName_(std::move(columnName))
+    {
+    }
+
+    ~DropIndex() = default;
+
+public:
+    CommandRetType execute() override
+    {
+        Database::getInstance().dropIndex(tableName_, columnName_);
+        return {};
+    }
+
+private:
+    std::string tableName_;
+    std::string columnName_;
+};
+
 class Join final : public BaseCommand
 {
 
 public:
-    Join()
+    Join(std::string tableName, std::vector<join::JoinSpec> joins,
+         std::vector<std::string>& selectList,
+         std::unique_ptr<filters::Filter> filter,
+         std::vector<sort::SortKey> orderBy = {},
+         Limit limit = {})
+        : tableName_(std::move(tableName)),
+          joins_(std::move(joins)),
+          selectList_(selectList),
+          filter_(std::move(filter)),
+          orderBy_(std::move(orderBy)),
+          limit_(limit)
     {
     }
 
@@ -158,6 +224,50 @@ public:
 public:
     CommandRetType execute() override
     {
+        auto view = Database::getInstance().join(tableName_, joins_, selectList_, std::move(filter_), orderBy_, limit_);
+        view->print();
+        return view;
+    }
+
+private:
+    std::string tableName_;
+    std::vector<join::JoinSpec> joins_;
+    std::vector<std::string> selectList_;
+    std::unique_ptr<filters::Filter> filter_;
+    std::vector<sort::SortKey> orderBy_;
+    Limit limit_;
+};
+
+// `begin`, `commit` and `rollback`, see Database::begin
+class Begin final : public BaseCommand
+{
+
+public:
+    CommandRetType execute() override
+    {
+        Database::getInstance().begin();
+        return {};
+    }
+};
+
+class Commit final : public BaseCommand
+{
+
+public:
+    CommandRetType execute() override
+    {
+        Database::getInstance().commit();
+        return {};
+    }
+};
+
+class Rollback final : public BaseCommand
+{
+
+public:
+    CommandRetType execute() override
+    {
+        Database::getInstance().rollback();
         return {};
     }
 };
@@ -170,6 +280,11 @@ enum class CommandId : char
     Delete,
     Update,
     Join,
+    CreateIndex,
+    DropIndex,
+    Begin,
+    Commit,
+    Rollback,
 };
 
 } // namespace commands
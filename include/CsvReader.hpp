@@ -0,0 +1,79 @@
+#pragma once
+
+#include "Simd.hpp"
+#include "Storage.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace db
+{
+
+namespace csv
+{
+
+// Bulk reader for the #DATA section of serializeCSV() files. Data is read
+// in large blocks, split into chunks of whole rows and every chunk is
+// parsed on its own, so chunks can be parsed in parallel and appended in
+// order afterwards.
+//
+// A row ends at a newline outside quotes. Quoted fields have their quotes
+// doubled like csv::Writer writes them.
+
+// Splits CSV text into fields. The text is classified 64 bytes at a time
+// by simd::classifyCsv(), the commas and newlines outside quotes are then
+// walked through their bit mask: plain fields are handed out in place
+// without looking at their bytes one by one.
+class Tokenizer
+{
+
+public:
+    explicit Tokenizer(std::string_view data);
+
+public:
+    // Next field with its quotes removed, false once the data is used up.
+    // `rowEnd` is set when a newline or the end of the data ends the field.
+    // The view points into the data unless the field held doubled quotes,
+    // then it is only valid until the next call. Throws TableException on
+    // an unterminated quoted field.
+    bool next(std::string_view& field, bool& rowEnd);
+
+private:
+    // classifies the block at next_
+    void advance();
+    std::string_view unquote(size_t begin, size_t end);
+
+private:
+    std::string_view data_;
+    simd::Level level_;
+    // start of the next block to classify
+    size_t next_ = 0;
+    // start of the classified block and its delimiters not handed out yet
+    size_t block_ = 0;
+    uint64_t delimiters_ = 0;
+    // the classified blocks end inside quotes
+    bool inQuotes_ = false;
+    size_t fieldStart_ = 0;
+    // the last field ended with a comma, another one follows
+    bool rowOpen_ = false;
+    std::string scratch_{};
+};
+
+// Cuts `data` into chunks of roughly `chunkSize` bytes ending on row
+// boundaries and returns the number of bytes they cover. The incomplete
+// row at the end is left out unless `final` is set, then it is the last
+// row of the last chunk.
+size_t splitRows(std::string_view data, bool final, size_t chunkSize,
+                 std::vector<std::string_view>& chunks);
+
+// Appends the rows of `chunk` to the columns of `out` and returns their
+// count. Every row must hold one field per column, fields are converted to
+// the column types. Throws TableException on malformed rows.
+size_t parseRows(std::string_view chunk, storage::ColumnStore& out);
+
+} // namespace csv
+
+} // namespace db
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string_view>
+
+namespace db
+{
+
+namespace csv
+{
+
+struct WriterOptions
+{
+    // Output is written in chunks of this size, rounded up to kDirectAlignment
+    size_t bufferSize = 4 << 20;
+
+    // Bypass the page cache with O_DIRECT where the file system supports
+    // it, the writer falls back to buffered writes where it does not
+    bool direct = false;
+};
+
+// CSV export into one large buffer that goes to the file with pwrite()
+// whenever it fills up. Fields are escaped straight into the buffer the way
+// escapeCSVField() does: values holding a comma or a quote are quoted and
+// their quotes doubled.
+class Writer
+{
+
+public:
+    // Alignment of O_DIRECT buffers, offsets and lengths
+    static constexpr size_t kDirectAlignment = 4096;
+
+public:
+    explicit Writer(const std::filesystem::path& path,
+                    WriterOptions options = {});
+
+    Writer(const Writer&) = delete;
+
+    Writer& operator=(const Writer&) = delete;
+
+    // Closes the file, errors are only reported by close()
+    ~Writer();
+
+public:
+    // Next field of the current row, separated by a comma from the last one
+    void field(std::string_view value);
+    // keeps string literals away from the bool overload
+    void field(const char* value)
+    {
+        field(std::string_view(value));
+    }
+    void field(int32_t value);
+    void field(bool value);
+
+    // Text copied as is, for lines that are not rows
+    void raw(std::string_view text);
+
+    void endRow();
+
+    // Writes what is buffered and closes the file, throws DatabaseException
+    void close();
+
+private:
+    void separate();
+    // makes room for `size` more bytes in the buffer
+    char* reserve(size_t size);
+    void flush(size_t size);
+    void writeAt(const char* data, size_t size, uint64_t offset);
+
+private:
+    struct FreeDeleter
+    {
+        void operator()(char* buffer) const;
+    };
+
+    std::filesystem::path path_;
+    int fd_ = -1;
+    bool direct_ = false;
+    std::unique_ptr<char, FreeDeleter> buffer_;
+    size_t capacity_ = 0;
+    size_t used_ = 0;
+    uint64_t offset_ = 0;
+    bool rowStarted_ = false;
+};
+
+} // namespace csv
+
+} // namespace db
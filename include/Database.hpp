@@ -1,14 +1,61 @@
 #pragma once
 
+#include "Join.hpp"
 #include "Table.hpp"
+#include "Wal.hpp"
+#include "WorkerPool.hpp"
 
+#include <atomic>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
 #include <unordered_map>
 
 namespace db
 {
 
+// Lock on one table for the statement running on the calling thread, shared
+// or exclusive. Locks nest per thread: a thread already holding the lock of a
+// table does not take it again, so a command can keep the table of a query
+// locked while it reads the view. A shared lock cannot be upgraded, asking
+// for an exclusive one throws DatabaseException.
+class TableLock
+{
+
+public:
+    TableLock(std::shared_ptr<Table> table, bool exclusive);
+
+    TableLock(TableLock&& other) noexcept;
+
+    TableLock(const TableLock&) = delete;
+
+    TableLock& operator=(const TableLock&) = delete;
+
+    ~TableLock();
+
+public:
+    Table* operator->() const
+    {
+        return table_.get();
+    }
+
+    Table& operator*() const
+    {
+        return *table_;
+    }
+
+    // True when the calling thread holds a lock on `table`
+    static bool isHeld(const Table& table);
+
+private:
+    std::shared_ptr<Table> table_;
+    bool exclusive_ = false;
+    // false when the thread held the lock already or it was moved out
+    bool owner_ = false;
+};
+
 class Database
 {
 
@@ -32,30 +79,135 @@ public:
 
 public:
 
+    // Copy of the catalog as it is now
     TablesContainer getTables() const {
-        return tables_;
+        return *tables_.load();
+    }
+
+    // Catalog lookup without locks, throws DatabaseException for unknown
+    // tables
+    std::shared_ptr<Table> findTable(const std::string& name) const;
+
+    // Statements lock the tables they touch themselves: shared for queries
+    // and row changes, which the table runs side by side on snapshots, and
+    // exclusive for schema changes. Views and cursors read their table
+    // lazily though: a caller reading them while another thread may reload
+    // the table or change its schema holds lockShared() meanwhile.
+    TableLock lockShared(const std::string& name) const;
+
+    TableLock lockExclusive(const std::string& name) const;
+
+    // Threads scanning a table in parallel, 1 keeps scans on the caller
+    void setParallelism(size_t threads);
+
+    size_t getParallelism() const {
+        return workers_ ? workers_->size() + 1 : 1;
     }
 
+    // Memory budget and spill directory of ORDER BY sorts
+    void setSortOptions(sort::SortOptions options);
+
 public:
     void createTable(std::string& name,
                      std::vector<Table::ColumnType> columns);
 
     void insert(std::string& tableName, Table::InsertType insertMap);
 
-    std::unique_ptr<Table::View> select(std::string& tableName, std::vector<std::string>& selectList, std::unique_ptr<filters::Filter> filter);
+    std::unique_ptr<Table::View> select(std::string& tableName, std::vector<std::string>& selectList, std::unique_ptr<filters::Filter> filter,
+                                        const std::vector<sort::SortKey>& orderBy = {}, const Limit& limit = {},
+                                        const aggregate::Grouping& grouping = {});
+
+    // Lazy alternative to select, rows are filtered as the cursor advances
+    std::unique_ptr<Table::Cursor> openCursor(std::string& tableName, std::vector<std::string>& selectList, std::unique_ptr<filters::Filter> filter);
 
     void update(std::string& tableName, std::unique_ptr<filters::Filter> filter, Table::InsertType newValues);
 
     void del(std::string& tableName, std::unique_ptr<filters::Filter> filter);
 
+    std::unique_ptr<Table::View> join(std::string& tableName, std::vector<join::JoinSpec>& joins, std::vector<std::string>& selectList, std::unique_ptr<filters::Filter> filter,
+                                      const std::vector<sort::SortKey>& orderBy = {}, const Limit& limit = {});
+
+    void createIndex(std::string& tableName, std::string& columnName);
+
+    void dropIndex(std::string& tableName, std::string& columnName);
+
+    // Safe to call from many threads at once: queries read snapshots while
+    // inserts, updates and deletes go on, statements changing the schema
+    // of a table hold it alone
     void execute(std::string request);
 
+public:
+    // Transactions, one per thread (`begin`, `commit` and `rollback`
+    // statements). Inserts, updates and deletes of the calling thread are
+    // buffered from begin() on; its queries keep reading committed rows.
+    // commit() applies the buffered statements in order, in one
+    // Table::Batch per table. The log gets all of them in one append and
+    // one sync, and only then do the tables commit, all at once: no
+    // snapshot sees some of them and not the others. If any statement
+    // fails, or the tables do not share one log, nothing is applied and
+    // the transaction ends. Schema changes are never part of a
+    // transaction. rollback() drops the buffered statements.
+    void begin();
+
+    void commit();
+
+    void rollback();
+
+    bool inTransaction() const;
+
     void loadTableFromFile(std::string name, std::filesystem::path dataFilePath);
 
+    // Serves the table from a mapping of its binary file, see Table::map
+    void mapTableFromFile(std::string name, std::filesystem::path dataFilePath);
+
     void storeTableInFile(std::string name, std::filesystem::path dataFilePath);
 
+public:
+    // Durable mode. Replaces the tables in memory by the ones recovered
+    // from `directory`: the last checkpoint with its log replayed on top.
+    // From then on created tables and every insert, update and delete are
+    // logged there. Tables loaded from other files are not logged until
+    // the next checkpoint includes them.
+    void open(std::filesystem::path directory, wal::Options options = {});
+
+    // Snapshots every table and switches to an empty log, every table is
+    // locked exclusively meanwhile. A crash at any point recovers either
+    // the old or the new checkpoint, never a mix.
+    void checkpoint();
+
+    // Stops logging, the directory stays recoverable by open()
+    void close();
+
+private:
+    std::filesystem::path checkpointPath(uint64_t epoch) const;
+    std::filesystem::path logPath(uint64_t epoch) const;
+    void attachLog(std::shared_ptr<wal::Log> log);
+    void configure(Table& table) const;
+    // copy-on-write update of the catalog, catalogMutex_ must be held
+    void updateCatalog(const std::function<void(TablesContainer&)>& change);
+
 private:
-    TablesContainer tables_;
+    // Immutable snapshots, replaced as a whole on every catalog change so
+    // lookups never wait for a lock
+    std::atomic<std::shared_ptr<const TablesContainer>> tables_{
+        std::make_shared<const TablesContainer>()
+    };
+    // Serializes catalog changes and the settings and log they hand to
+    // new tables
+    std::mutex catalogMutex_;
+    std::shared_ptr<WorkerPool> workers_;
+    sort::SortOptions sortOptions_{};
+
+    // durable mode, see open()
+    std::filesystem::path directory_{};
+    wal::Options logOptions_{};
+    uint64_t epoch_ = 0;
+    std::shared_ptr<wal::Log> log_;
+
+    // held exclusively while a transaction commits its tables, see
+    // Table::setCommitGate
+    std::shared_ptr<std::shared_mutex> commitGate_ =
+        std::make_shared<std::shared_mutex>();
 };
 
 } // namespace db
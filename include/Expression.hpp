@@ -2,15 +2,25 @@
 
 #include "Lexer.hpp"
 #include "Column.hpp"
+#include "Storage.hpp"
 
+#include <functional>
 #include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
 
 namespace db
 {
 
+class Table;
+
 namespace expression
 {
 
+// Row an expression is evaluated on. Without a table every identifier is a
+// bare word standing for its own name.
 class Context
 {
 
@@ -19,7 +29,7 @@ public:
 
     Context() = default;
 
-    Context(const std::string& tableName): tableName_(tableName) {}
+    Context(const Table& table, size_t row): table_(&table), row_(row) {}
 
 public:
     using Value = columns::BaseColumn::value_type;
@@ -30,18 +40,61 @@ public:
 
 private:
 
-    std::string tableName_;
+    const Table* table_ = nullptr;
+    size_t row_ = 0;
 
 };
 
+// New name for a column name, see Expression::renameColumns
+using Rename = std::function<std::string(const std::string& name)>;
+
+// Besides the generic variant based evaluate(), a bound expression has a
+// fixed result type and typed accessors reading the columns directly, so
+// the per row path never builds a Context::Value.
 class Expression
 {
 public:
     virtual ~Expression() = default;
 
     virtual Context::Value evaluate(const Context& context) const = 0;
+
+    // Resolves column references against `table` and checks the operand
+    // types, throws on mismatches
+    virtual void bind(const Table& table) = 0;
+
+    // Integer (also for Id columns), Bool, String or Bytes, valid once bound
+    virtual columns::ColumType type() const = 0;
+
+    // True when no row value is read. Before binding identifiers count as
+    // columns, afterwards bare words are constants too.
+    virtual bool isConstant() const = 0;
+
+    virtual int evaluateInt(size_t row) const;
+    virtual bool evaluateBool(size_t row) const;
+    // String and Bytes values
+    virtual std::string_view evaluateBytes(size_t row) const;
+
+    // evaluateInt for every row of `rows`
+    virtual void evaluateInts(const std::vector<size_t>& rows,
+                              std::vector<int>& out) const;
+
+    // Replaces every name that may be a column with rename(name), before
+    // binding. Joins turn `table.column` into the plain column name.
+    virtual void renameColumns(const Rename& rename);
 };
 
+// Replaces a constant expression by its value, parsers call it on every node
+// they build so constant subtrees collapse bottom up
+std::unique_ptr<Expression> fold(std::unique_ptr<Expression> expression);
+
+// Three-way comparison of two bound expressions of the same type on `row`
+int compare(const Expression& left, const Expression& right, size_t row);
+
+// Bare words are strings only when compared with a string column, any
+// other name that is not a column throws "Unknown column". For bound
+// operands of a comparison.
+void checkComparison(const Expression& left, const Expression& right);
+
 class BinaryExpression : public Expression
 {
 public:
@@ -52,11 +105,35 @@ public:
     }
 
     Context::Value evaluate(const Context& context) const override;
+    void bind(const Table& table) override;
+    columns::ColumType type() const override;
+    bool isConstant() const override;
+    int evaluateInt(size_t row) const override;
+    bool evaluateBool(size_t row) const override;
+    void evaluateInts(const std::vector<size_t>& rows,
+                      std::vector<int>& out) const override;
+    void renameColumns(const Rename& rename) override;
+
+    const lexer::Token& op() const
+    {
+        return op_;
+    }
+
+    const Expression* left() const
+    {
+        return left_.get();
+    }
+
+    const Expression* right() const
+    {
+        return right_.get();
+    }
 
 private:
     lexer::Token op_;
     std::unique_ptr<Expression> left_;
     std::unique_ptr<Expression> right_;
+    columns::ColumType type_ = columns::ColumType::None;
 };
 
 class UnaryExpression : public Expression
@@ -68,24 +145,56 @@ public:
     }
 
     Context::Value evaluate(const Context& context) const override;
+    void bind(const Table& table) override;
+    columns::ColumType type() const override;
+    bool isConstant() const override;
+    int evaluateInt(size_t row) const override;
+    bool evaluateBool(size_t row) const override;
+    void renameColumns(const Rename& rename) override;
 
 private:
     lexer::Token op_;
     std::unique_ptr<Expression> operand_;
 };
 
-class LiteralExpression : public Expression
+// Value computed once, by the lexer or by folding
+class ConstantExpression : public Expression
 {
 public:
-    LiteralExpression(const lexer::Token& token)
-        : token_(token)
+    ConstantExpression(Context::Value value)
+        : value_(std::move(value))
     {
     }
 
     Context::Value evaluate(const Context& context) const override;
+    void bind(const Table& table) override;
+    columns::ColumType type() const override;
+    bool isConstant() const override;
+    int evaluateInt(size_t row) const override;
+    bool evaluateBool(size_t row) const override;
+    std::string_view evaluateBytes(size_t row) const override;
+    void evaluateInts(const std::vector<size_t>& rows,
+                      std::vector<int>& out) const override;
+
+    const Context::Value& value() const
+    {
+        return value_;
+    }
 
 private:
-    lexer::Token token_;
+    Context::Value value_;
+};
+
+class LiteralExpression : public ConstantExpression
+{
+public:
+    LiteralExpression(const lexer::Token& token)
+        : ConstantExpression(parse(token))
+    {
+    }
+
+private:
+    static Context::Value parse(const lexer::Token& token);
 };
 
 class IdentifierExpression : public Expression
@@ -97,9 +206,39 @@ public:
     }
 
     Context::Value evaluate(const Context& context) const override;
+    void bind(const Table& table) override;
+    columns::ColumType type() const override;
+    bool isConstant() const override;
+    int evaluateInt(size_t row) const override;
+    bool evaluateBool(size_t row) const override;
+    std::string_view evaluateBytes(size_t row) const override;
+    void evaluateInts(const std::vector<size_t>& rows,
+                      std::vector<int>& out) const override;
+    void renameColumns(const Rename& rename) override;
+
+    const std::string& name() const
+    {
+        return name_;
+    }
+
+    // Ordinal of the column, unset before binding and for bare words
+    std::optional<size_t> column() const
+    {
+        return column_;
+    }
+
+    // Bound to no column, the name is a string then
+    bool isBareWord() const
+    {
+        return bound_ && !column_;
+    }
 
 private:
     std::string name_;
+    bool bound_ = false;
+    std::optional<size_t> column_;
+    const storage::ColumnData* data_ = nullptr;
+    columns::ColumType type_ = columns::ColumType::String;
 };
 
 class StringLengthExpression : public Expression
@@ -111,9 +250,19 @@ public:
     }
 
     Context::Value evaluate(const Context& context) const override;
+    void bind(const Table& table) override;
+    columns::ColumType type() const override;
+    bool isConstant() const override;
+    int evaluateInt(size_t row) const override;
+    void evaluateInts(const std::vector<size_t>& rows,
+                      std::vector<int>& out) const override;
+    void renameColumns(const Rename& rename) override;
 
 private:
     std::string name_;
+    bool bound_ = false;
+    // unset for a bare word, whose own length is the value
+    const storage::VarlenData* data_ = nullptr;
 };
 
 } // namespace expression
@@ -1,19 +1,44 @@
 #pragma once
 
 #include "Column.hpp"
+#include "Expression.hpp"
+#include "Storage.hpp"
 #include "Table.hpp"
 
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
 namespace db
 {
 
 namespace filters
 {
 
+// Row ids of one block of rows that are still candidates, ascending
+using Selection = std::vector<size_t>;
+
+// Rows handed to filterBatch() at once
+constexpr size_t kBatchSize = 1024;
+
 class Filter
 {
 public:
     virtual ~Filter() = default;
-    virtual bool matches(const Table::Record& record, Table& table) const = 0;
+
+    // Resolves every column reference against `table` once per statement,
+    // throws for unknown columns. Must run before matches/filterBatch.
+    virtual void bind(const Table& table) = 0;
+
+    // Replaces every column name with rename(name), must run before bind()
+    virtual void renameColumns(const expression::Rename& rename) = 0;
+
+    virtual bool matches(size_t row, Table& table) const = 0;
+
+    // Drops from `selection` every row that does not match
+    virtual void filterBatch(Selection& selection, Table& table) const;
 };
 
 
@@ -31,12 +56,69 @@ public:
     ComparisonFilter(const std::string& fieldName, Operator op, const columns::BaseColumn::value_type& value)
         : fieldName_(fieldName), op_(op), value_(value) {}
 
-    bool matches(const Table::Record& record, Table& table) const override;
+    void bind(const Table& table) override;
+    void renameColumns(const expression::Rename& rename) override;
+    bool matches(size_t row, Table& table) const override;
+    void filterBatch(Selection& selection, Table& table) const override;
+
+    const std::string& fieldName() const { return fieldName_; }
+    Operator op() const { return op_; }
+    const columns::BaseColumn::value_type& value() const { return value_; }
+
+    // Ordinal of the bound column
+    size_t column() const;
+
+    // False when the value has another type than the bound column
+    bool sameType() const { return sameType_; }
 
 private:
     std::string fieldName_;
     Operator op_;
     columns::BaseColumn::value_type value_;
+
+    // set by bind()
+    std::optional<size_t> column_;
+    bool sameType_ = false;
+};
+
+// Comparison of two expressions over the row, e.g. `a + 1 < b` or
+// `|login| > 5`. A plain column compared with a constant, which bare words
+// only turn out to be once bound, is lowered to a ComparisonFilter.
+class ExpressionFilter : public Filter {
+public:
+    ExpressionFilter(ComparisonFilter::Operator op,
+                     std::unique_ptr<expression::Expression> left,
+                     std::unique_ptr<expression::Expression> right)
+        : op_(op), left_(std::move(left)), right_(std::move(right)) {}
+
+    // A boolean expression used as the whole condition
+    explicit ExpressionFilter(std::unique_ptr<expression::Expression> condition);
+
+    void bind(const Table& table) override;
+    void renameColumns(const expression::Rename& rename) override;
+    bool matches(size_t row, Table& table) const override;
+    void filterBatch(Selection& selection, Table& table) const override;
+
+    // filterBatch for filters that were not lowered, reads the bound
+    // columns directly
+    void filterRows(Selection& selection) const;
+
+    // The equivalent column comparison, set by bind() when there is one
+    const ComparisonFilter* lowered() const {
+        return lowered_ ? &*lowered_ : nullptr;
+    }
+
+private:
+    ComparisonFilter::Operator op_;
+    std::unique_ptr<expression::Expression> left_;
+    std::unique_ptr<expression::Expression> right_;
+    bool condition_ = false;
+
+    // set by bind()
+    std::optional<ComparisonFilter> lowered_;
+    columns::ColumType type_ = columns::ColumType::None;
+    // result for operands of different types
+    std::optional<bool> constant_;
 };
 
 class LogicalFilter : public Filter {
@@ -49,7 +131,19 @@ public:
     LogicalFilter(LogicalOperator op, std::unique_ptr<Filter> left, std::unique_ptr<Filter> right)
         : op_(op), left_(std::move(left)), right_(std::move(right)) {}
 
-    bool matches(const Table::Record& record, Table& table) const override;
+    void bind(const Table& table) override;
+    void renameColumns(const expression::Rename& rename) override;
+    bool matches(size_t row, Table& table) const override;
+    void filterBatch(Selection& selection, Table& table) const override;
+
+    LogicalOperator op() const { return op_; }
+    const Filter& left() const { return *left_; }
+    const Filter& right() const { return *right_; }
+
+    // Hands over both operands, leaves the filter empty
+    std::pair<std::unique_ptr<Filter>, std::unique_ptr<Filter>> releaseOperands() {
+        return {std::move(left_), std::move(right_)};
+    }
 
 private:
     LogicalOperator op_;
@@ -62,12 +156,94 @@ public:
     NotFilter(std::unique_ptr<Filter> operand)
         : operand_(std::move(operand)) {}
 
-    bool matches(const Table::Record& record, Table& table) const override;
+    void bind(const Table& table) override;
+    void renameColumns(const expression::Rename& rename) override;
+    bool matches(size_t row, Table& table) const override;
+    void filterBatch(Selection& selection, Table& table) const override;
+
+    const Filter& operand() const { return *operand_; }
 
 private:
     std::unique_ptr<Filter> operand_;
 };
 
+// A bound filter tree lowered to flat, register based bytecode that runs a
+// whole batch per instruction. Registers hold the rows still in play,
+// register 0 is the caller's selection. AND feeds the survivors of the left
+// side to the right side, OR only hands the right side the rows the left
+// side rejected. Dense batches run with one bitmap per register, so the
+// comparisons use the SIMD kernels and DIFF/MERGE are word operations,
+// other selections keep row-id lists.
+//
+//   a < 5 || !(b = "x")  =>  0 CMP_I32 r1 <- r0  a < 5
+//                            1 DIFF    r2 <- r0 - r1
+//                            2 CMP_STR r3 <- r2  b = "x"
+//                            3 DIFF    r2 <- r2 - r3
+//                            4 MERGE   r0 <- r1 + r2
+// Scratch space of one thread of execution running a Program
+struct ProgramRegisters
+{
+    std::vector<Selection> selections;
+    std::vector<uint64_t> masks;
+    Selection scratch;
+};
+
+class Program
+{
+public:
+    enum class Opcode : uint8_t
+    {
+        CMP_I32,
+        CMP_BOOL,
+        CMP_STR,
+        // generic ExpressionFilter
+        CMP_EXPR,
+        // constant folded comparisons, e.g. against a value of another type
+        CLEAR,
+        COPY,
+        DIFF,
+        MERGE,
+    };
+
+    struct Instruction
+    {
+        Opcode op;
+        ComparisonFilter::Operator cmp = ComparisonFilter::EQUAL;
+        uint16_t dst = 0;
+        uint16_t src = 0;
+        uint16_t src2 = 0;
+        // integer / bool constant or index into the string pool
+        int32_t immediate = 0;
+        const storage::ColumnData* column = nullptr;
+        const ExpressionFilter* expression = nullptr;
+    };
+
+    using Registers = ProgramRegisters;
+
+    // `filter` must be bound to `table`
+    static Program compile(const Filter& filter, const Table& table);
+
+    // Drops from `selection` every row that does not match
+    void filterBatch(Selection& selection, Registers& registers) const;
+
+    const std::vector<Instruction>& code() const { return code_; }
+
+    size_t registerCount() const { return registers_; }
+
+private:
+    void runSelections(Selection& selection, Registers& registers) const;
+    void runMasks(Selection& selection, Registers& registers) const;
+
+    uint16_t emit(const Filter& filter, const Table& table, uint16_t src,
+                  bool inPlace);
+    uint16_t emitComparison(const ComparisonFilter& filter,
+                            const Table& table, uint16_t src, uint16_t dst);
+    uint16_t allocate();
+
+    std::vector<Instruction> code_{};
+    std::vector<std::string> strings_{};
+    uint16_t registers_ = 1;
+};
 
 } // namespace filters
 
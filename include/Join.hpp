@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Filter.hpp"
+#include "Table.hpp"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace db
+{
+
+namespace join
+{
+
+// `join tableName on leftColumn = rightColumn`, column names may be
+// qualified with their table name
+struct JoinSpec
+{
+    std::string tableName;
+    std::string leftColumn;
+    std::string rightColumn;
+};
+
+// Renames every column of a single table view to `table.column`
+void qualify(Table::View& view);
+
+// Position of `name` in the view, unqualified names must be unambiguous
+size_t resolve(const Table::View& view, const std::string& name);
+
+// Splits the AND-ed conditions of a join's WHERE clause by the table they
+// read, `tables` in query order. Qualified and unambiguous bare column names
+// become plain names of that table, conditions reading no column go to the
+// first table, conditions reading several tables throw.
+std::map<std::string, std::unique_ptr<filters::Filter>> splitFilter(
+    std::unique_ptr<filters::Filter> filter,
+    const std::vector<std::pair<std::string, const Table*>>& tables);
+
+// Orders the ON columns as (key in `left`, key in `right`)
+std::pair<size_t, size_t> resolveKeys(const Table::View& left,
+                                      const Table::View& right,
+                                      const JoinSpec& spec);
+
+// Inner equi-join: the smaller input is hashed, the larger one probes it.
+// Output rows hold the left columns followed by the right ones.
+std::unique_ptr<Table::View> hashJoin(const Table::View& left, size_t leftKey,
+                                      const Table::View& right,
+                                      size_t rightKey);
+
+// Orders the rows of a joined view by `keys`, ties keep their order
+void orderBy(Table::View& view, const std::vector<sort::SortKey>& keys);
+
+// Restricts the view to `selectList`, an empty list keeps every column
+void project(Table::View& view, const std::vector<std::string>& selectList);
+
+} // namespace join
+
+} // namespace db
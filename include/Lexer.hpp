@@ -69,6 +69,17 @@ enum TokenType
     TOK_NOT = 52,           // !
     TOK_BITWISE_OR = 53,    // |
     TOK_EOF = 54,
+
+    TOK_DROP = 55,
+    TOK_ORDER = 56,
+    TOK_ASC = 57,
+    TOK_DESC = 58,
+    TOK_LIMIT = 59,
+    TOK_OFFSET = 60,
+    TOK_GROUP = 61,
+    TOK_BEGIN = 62,
+    TOK_COMMIT = 63,
+    TOK_ROLLBACK = 64,
 };
 
 struct Token
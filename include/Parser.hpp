@@ -43,12 +43,16 @@ private:
                                                    std::string stringVal);
     std::unique_ptr<commands::CreateTable> parseCreateTable();
     std::unique_ptr<commands::Insert> parseInsert();
-    std::unique_ptr<commands::Select> parseSelect();
+    std::unique_ptr<commands::BaseCommand> parseSelect();
     std::unique_ptr<commands::Update> parseUpdate();
     std::unique_ptr<commands::Delete> parseDelete();
     std::unique_ptr<commands::Join> parseJoin();
+    std::unique_ptr<commands::CreateIndex> parseCreateIndex();
+    std::unique_ptr<commands::DropIndex> parseDropIndex();
+    std::pair<std::string, std::string> parseIndexTarget();
 
     JoinClause parseJoinClause();
+    join::JoinSpec makeJoinSpec(const JoinClause& clause);
 
     std::unique_ptr<expression::Expression> parseExpression();
     std::unique_ptr<expression::Expression> parseCondition();
@@ -61,6 +65,14 @@ private:
     std::unique_ptr<expression::Expression> parseUnaryExpression();
     std::unique_ptr<expression::Expression> parsePrimaryExpression();
 
+    // `column`, `table.column` or `function(column)`, aggregates are
+    // appended to `aggregates` and named like their result column
+    std::string parseSelectItem(std::vector<aggregate::Aggregate>& aggregates);
+
+    std::vector<sort::SortKey> parseOrderBy();
+
+    Limit parseLimit();
+
     std::unique_ptr<filters::Filter> parseWhere();
     std::unique_ptr<filters::Filter> parseOrFilter();
     std::unique_ptr<filters::Filter> parseAndFilter();
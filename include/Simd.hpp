@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace db
+{
+
+namespace simd
+{
+
+// Comparison kernels writing one bit per value into `mask`: bit i of
+// mask[i / 64] is set when values[i] <op> value. `mask` must hold
+// (count + 63) / 64 words, unused high bits of the last word are cleared.
+
+enum class CompareOp : unsigned char
+{
+    Equal,
+    NotEqual,
+    Less,
+    LessEqual,
+    Greater,
+    GreaterEqual,
+};
+
+enum class Level : unsigned char
+{
+    Scalar,
+    Sse42,
+    Avx2,
+};
+
+// Best level supported by the running CPU
+Level detectLevel();
+
+const char* levelName(Level level);
+
+void compareInt32(const int32_t* values, size_t count, CompareOp op,
+                  int32_t value, uint64_t* mask);
+
+void compareInt32(const int32_t* values, size_t count, CompareOp op,
+                  int32_t value, uint64_t* mask, Level level);
+
+// Same for bit-packed bools: `words` holds `count` values, 64 per word
+void compareBool(const uint64_t* words, size_t count, CompareOp op, bool value,
+                 uint64_t* mask);
+
+constexpr size_t maskWords(size_t count)
+{
+    return (count + 63) / 64;
+}
+
+// Structural characters of up to 64 bytes of CSV text: bit i of a mask is
+// set when data[i] is that character, bits past `size` are clear
+struct CsvMasks
+{
+    uint64_t quotes = 0;
+    uint64_t commas = 0;
+    uint64_t newlines = 0;
+};
+
+CsvMasks classifyCsv(const char* data, size_t size);
+
+CsvMasks classifyCsv(const char* data, size_t size, Level level);
+
+// Bit i is set when an odd number of bits at or below i are set. Applied to
+// the quote bits it marks the bytes inside quotes, the opening quote
+// included and the closing one not.
+constexpr uint64_t prefixXor(uint64_t bits)
+{
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+} // namespace simd
+
+} // namespace db
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "Storage.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace db
+{
+
+namespace sort
+{
+
+// `order by column [asc|desc]`
+struct SortKey
+{
+    std::string column;
+    bool descending = false;
+};
+
+// SortKey resolved to a column of the store
+struct BoundKey
+{
+    size_t column;
+    bool descending = false;
+};
+
+struct SortOptions
+{
+    // Bytes of (key, row id) pairs sorted in memory, larger inputs are
+    // sorted in runs of this size that are spilled and merged
+    size_t memoryBudget = size_t{ 64 } << 20;
+
+    // Where runs are spilled, the system temporary directory when empty
+    std::filesystem::path spillDirectory{};
+};
+
+// Orders `rows` of `store` by `keys`, ties keep their order in `rows`.
+// With a limit only the first `limit` rows are produced, through a bounded
+// heap when they fit into the memory budget.
+std::vector<size_t> sortRows(const storage::ColumnStore& store,
+                             const std::vector<BoundKey>& keys,
+                             std::vector<size_t> rows,
+                             std::optional<size_t> limit = std::nullopt,
+                             const SortOptions& options = {});
+
+} // namespace sort
+
+} // namespace db
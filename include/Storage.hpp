@@ -0,0 +1,562 @@
+#pragma once
+
+#include "BinaryFormat.hpp"
+#include "Column.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace db
+{
+
+namespace storage
+{
+
+// Column-oriented table storage: one contiguous typed buffer per column,
+// rows are addressed by their position (row id) in every buffer.
+
+// Contiguous buffer that either owns its values or borrows them from a
+// copy-on-write file mapping. Borrowed values are written in place, so the
+// kernel copies only the pages holding modified rows. Appends go to the
+// room the mapped region has after them; growing past it moves the values
+// into owned memory first.
+//
+// Appends within capacity() leave the values where they are. The pointer
+// and size are atomic so readers of the values already there may run
+// alongside such appends.
+template <typename T>
+class Buffer
+{
+
+public:
+    Buffer() = default;
+
+    Buffer(std::shared_ptr<binary::MappedRegion> region, T* data,
+           size_t size, size_t capacity)
+        : region_(std::move(region)), data_(data), size_(size),
+          mappedCapacity_(capacity)
+    {
+    }
+
+    Buffer(const Buffer&) = delete;
+
+    Buffer& operator=(Buffer&& other)
+    {
+        owned_ = std::move(other.owned_);
+        region_ = std::move(other.region_);
+        mappedCapacity_ = other.mappedCapacity_;
+        data_.store(other.data_.load(std::memory_order_relaxed),
+                    std::memory_order_relaxed);
+        size_.store(other.size_.load(std::memory_order_relaxed),
+                    std::memory_order_relaxed);
+        if (!mapped())
+        {
+            adopt();
+        }
+        return *this;
+    }
+
+public:
+    bool mapped() const
+    {
+        return region_ != nullptr;
+    }
+
+    T* data()
+    {
+        return data_.load(std::memory_order_relaxed);
+    }
+
+    const T* data() const
+    {
+        return data_.load(std::memory_order_relaxed);
+    }
+
+    size_t size() const
+    {
+        return size_.load(std::memory_order_relaxed);
+    }
+
+    size_t capacity() const
+    {
+        return mapped() ? mappedCapacity_ : owned_.capacity();
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    T& operator[](size_t idx)
+    {
+        return data()[idx];
+    }
+
+    const T& operator[](size_t idx) const
+    {
+        return data()[idx];
+    }
+
+    T* begin()
+    {
+        return data();
+    }
+
+    T* end()
+    {
+        return data() + size();
+    }
+
+    const T* begin() const
+    {
+        return data();
+    }
+
+    const T* end() const
+    {
+        return data() + size();
+    }
+
+    void reserve(size_t capacity)
+    {
+        if (capacity <= this->capacity())
+        {
+            return;
+        }
+        own();
+        owned_.reserve(capacity);
+        adopt();
+    }
+
+    // Borrowed values stay borrowed within the room of the region
+    void resize(size_t size)
+    {
+        if (mapped() && size <= mappedCapacity_)
+        {
+            // the room may hold values dropped before
+            std::fill(end(), data() + std::max(size, this->size()), T{});
+            size_.store(size, std::memory_order_relaxed);
+            return;
+        }
+        own();
+        owned_.resize(size);
+        adopt();
+    }
+
+    void push_back(T value)
+    {
+        if (mapped() && size() < mappedCapacity_)
+        {
+            data()[size()] = value;
+            size_.store(size() + 1, std::memory_order_relaxed);
+            return;
+        }
+        own();
+        owned_.push_back(value);
+        adopt();
+    }
+
+    void append(const T* first, size_t count)
+    {
+        if (mapped() && count <= mappedCapacity_ - size())
+        {
+            std::copy(first, first + count, end());
+            size_.store(size() + count, std::memory_order_relaxed);
+            return;
+        }
+        own();
+        owned_.insert(owned_.end(), first, first + count);
+        adopt();
+    }
+
+    void clear()
+    {
+        region_.reset();
+        owned_.clear();
+        adopt();
+    }
+
+    Buffer& operator=(std::vector<T>&& values)
+    {
+        region_.reset();
+        owned_ = std::move(values);
+        adopt();
+        return *this;
+    }
+
+private:
+    void own()
+    {
+        if (mapped())
+        {
+            owned_.assign(begin(), end());
+            region_.reset();
+        }
+    }
+
+    void adopt()
+    {
+        data_.store(owned_.data(), std::memory_order_relaxed);
+        size_.store(owned_.size(), std::memory_order_relaxed);
+    }
+
+private:
+    std::vector<T> owned_{};
+    std::shared_ptr<binary::MappedRegion> region_{};
+    std::atomic<T*> data_ = nullptr;
+    std::atomic<size_t> size_ = 0;
+    // values the region has room for
+    size_t mappedCapacity_ = 0;
+};
+
+class ColumnData
+{
+
+public:
+    using value_type = columns::BaseColumn::value_type;
+
+public:
+    explicit ColumnData(columns::ColumType type)
+        : type_(type)
+    {
+    }
+
+    virtual ~ColumnData() = default;
+
+public:
+    columns::ColumType getColumnType() const
+    {
+        return type_;
+    }
+
+    virtual size_t size() const = 0;
+
+    virtual void reserve(size_t capacity) = 0;
+
+    virtual void clear() = 0;
+
+    virtual void push_back(const value_type& value) = 0;
+
+    // True when push_back(value) leaves the stored values where they are
+    virtual bool fits(const value_type& value) const = 0;
+
+    virtual value_type get(size_t row) const = 0;
+
+    virtual void set(size_t row, const value_type& value) = 0;
+
+    // Three-way comparison of the stored value with `value` following the
+    // std::variant ordering rules, but without materializing a variant.
+    virtual int compare(size_t row, const value_type& value) const = 0;
+
+    // Drops every row whose `keep` flag is false, preserving row order.
+    virtual void compact(const std::vector<bool>& keep) = 0;
+
+    // Column block payload of the binary table format, the first `rows` rows
+    virtual void writeBinary(binary::Writer& out, size_t rows) const = 0;
+
+    // Replaces the contents with `rows` rows read by readBinary's
+    // counterpart, leaving room for `capacity` rows in all
+    virtual void readBinary(binary::Reader& in, size_t rows,
+                            size_t capacity) = 0;
+
+    // Same as readBinary, but the values stay in the mapped file and the
+    // room follows them
+    virtual void mapBinary(binary::MappedReader& in, size_t rows,
+                           size_t capacity) = 0;
+
+    // Appends the first `rows` rows of `other`, a column of the same type
+    virtual void appendFrom(const ColumnData& other, size_t rows) = 0;
+
+protected:
+    columns::ColumType type_;
+};
+
+// Integer and Id columns
+class IntegerData final : public ColumnData
+{
+
+public:
+    using element_type = columns::Integer::value_type;
+
+public:
+    explicit IntegerData(columns::ColumType type = columns::ColumType::Integer)
+        : ColumnData(type)
+    {
+    }
+
+public:
+    std::span<const element_type> values() const
+    {
+        return { values_.data(), values_.size() };
+    }
+
+    element_type at(size_t row) const
+    {
+        return values_[row];
+    }
+
+    void append(element_type value)
+    {
+        values_.push_back(value);
+    }
+
+    size_t size() const override
+    {
+        return values_.size();
+    }
+
+    void reserve(size_t capacity) override;
+    void clear() override;
+    void push_back(const value_type& value) override;
+    bool fits(const value_type& value) const override;
+    value_type get(size_t row) const override;
+    void set(size_t row, const value_type& value) override;
+    int compare(size_t row, const value_type& value) const override;
+    void compact(const std::vector<bool>& keep) override;
+    void writeBinary(binary::Writer& out, size_t rows) const override;
+    void readBinary(binary::Reader& in, size_t rows,
+                    size_t capacity) override;
+    void mapBinary(binary::MappedReader& in, size_t rows,
+                   size_t capacity) override;
+    void appendFrom(const ColumnData& other, size_t rows) override;
+
+private:
+    Buffer<element_type> values_{};
+};
+
+// Bool columns, packed 64 values per word. Appends set their bit with an
+// atomic read-modify-write, the other bits of the last word may be read
+// meanwhile.
+class BoolData final : public ColumnData
+{
+
+public:
+    using word_type = uint64_t;
+
+    static constexpr size_t kWordBits = 64;
+
+public:
+    BoolData()
+        : ColumnData(columns::ColumType::Bool)
+    {
+    }
+
+public:
+    std::span<const word_type> words() const
+    {
+        return { words_.data(), words_.size() };
+    }
+
+    bool at(size_t row) const
+    {
+        auto word = std::atomic_ref(words_[row / kWordBits])
+                        .load(std::memory_order_relaxed);
+        return (word >> (row % kWordBits)) & 1;
+    }
+
+    void append(bool value)
+    {
+        size_t row = size();
+        if (row % kWordBits == 0)
+        {
+            words_.push_back(0);
+        }
+        // compact() may leave bits set past the last row
+        std::atomic_ref word(words_[row / kWordBits]);
+        word_type mask = word_type{ 1 } << (row % kWordBits);
+        if (value)
+        {
+            word.fetch_or(mask, std::memory_order_relaxed);
+        }
+        else
+        {
+            word.fetch_and(~mask, std::memory_order_relaxed);
+        }
+        size_.store(row + 1, std::memory_order_relaxed);
+    }
+
+    size_t size() const override
+    {
+        return size_.load(std::memory_order_relaxed);
+    }
+
+    void reserve(size_t capacity) override;
+    void clear() override;
+    void push_back(const value_type& value) override;
+    bool fits(const value_type& value) const override;
+    value_type get(size_t row) const override;
+    void set(size_t row, const value_type& value) override;
+    int compare(size_t row, const value_type& value) const override;
+    void compact(const std::vector<bool>& keep) override;
+    void writeBinary(binary::Writer& out, size_t rows) const override;
+    void readBinary(binary::Reader& in, size_t rows,
+                    size_t capacity) override;
+    void mapBinary(binary::MappedReader& in, size_t rows,
+                   size_t capacity) override;
+    void appendFrom(const ColumnData& other, size_t rows) override;
+
+private:
+    void assign(size_t row, bool value);
+
+private:
+    // mutable for atomic_ref, which wants a non-const word
+    mutable Buffer<word_type> words_{};
+    std::atomic<size_t> size_ = 0;
+};
+
+// String and Bytes columns: values live back to back in one blob, every row
+// keeps an offset and a length into it. Updates that do not fit in place are
+// appended to the blob, the stale bytes are reclaimed by compact().
+// reserve() makes room in the blob for values of the average length.
+class VarlenData final : public ColumnData
+{
+
+public:
+    explicit VarlenData(columns::ColumType type)
+        : ColumnData(type)
+    {
+    }
+
+public:
+    std::string_view at(size_t row) const
+    {
+        return { blob_.data() + offsets_[row], lengths_[row] };
+    }
+
+    void append(std::string_view bytes)
+    {
+        offsets_.push_back(blob_.size());
+        lengths_.push_back(static_cast<uint32_t>(bytes.size()));
+        blob_.append(bytes.data(), bytes.size());
+    }
+
+    size_t size() const override
+    {
+        return offsets_.size();
+    }
+
+    void reserve(size_t capacity) override;
+    void clear() override;
+    void push_back(const value_type& value) override;
+    bool fits(const value_type& value) const override;
+    value_type get(size_t row) const override;
+    void set(size_t row, const value_type& value) override;
+    int compare(size_t row, const value_type& value) const override;
+    void compact(const std::vector<bool>& keep) override;
+    // offsets, lengths and the values back to back, stale bytes are dropped
+    void writeBinary(binary::Writer& out, size_t rows) const override;
+    void readBinary(binary::Reader& in, size_t rows,
+                    size_t capacity) override;
+    void mapBinary(binary::MappedReader& in, size_t rows,
+                   size_t capacity) override;
+    void appendFrom(const ColumnData& other, size_t rows) override;
+
+private:
+    size_t alternative() const;
+    std::string_view bytesOf(const value_type& value) const;
+    void checkRanges() const;
+
+private:
+    Buffer<uint64_t> offsets_{};
+    Buffer<uint32_t> lengths_{};
+    Buffer<char> blob_{};
+};
+
+std::unique_ptr<ColumnData> makeColumnData(columns::ColumType type);
+
+class ColumnStore
+{
+
+public:
+    using value_type = columns::BaseColumn::value_type;
+    using RowValues = std::vector<value_type>;
+
+public:
+    ColumnStore() = default;
+
+    ColumnStore(const ColumnStore&) = delete;
+
+    ColumnStore(ColumnStore&&) = default;
+
+public:
+    size_t rowCount() const
+    {
+        return rows_;
+    }
+
+    size_t columnCount() const
+    {
+        return columns_.size();
+    }
+
+    ColumnData& column(size_t idx)
+    {
+        return *columns_[idx];
+    }
+
+    const ColumnData& column(size_t idx) const
+    {
+        return *columns_[idx];
+    }
+
+public:
+    void addColumn(columns::ColumType type);
+
+    void reserve(size_t rows);
+
+    // `values` must hold exactly one value per column, in column order
+    void append(const RowValues& values);
+
+    // True when append(values) leaves the stored rows where they are, so
+    // readers of those rows may run alongside
+    bool fits(const RowValues& values) const;
+
+    RowValues read(size_t row) const;
+
+    void erase(const std::vector<bool>& keep);
+
+    // Empty store with the same column types
+    ColumnStore emptyCopy() const;
+
+    // Accounts for `rows` rows appended column by column through column(),
+    // every column must have grown by exactly that many
+    void commitRows(size_t rows)
+    {
+        rows_ += rows;
+    }
+
+    // Appends the first `rows` rows of a store with the same column types
+    void append(const ColumnStore& other, size_t rows);
+
+    void append(const ColumnStore& other)
+    {
+        append(other, other.rowCount());
+    }
+
+    void clear();
+
+    void reset();
+
+    // One column block per column, in column order, holding the first
+    // `rows` rows
+    void writeBinary(binary::Writer& out, size_t rows) const;
+
+    // Replaces the rows of the existing columns, with room for `capacity`
+    // rows
+    void readBinary(binary::Reader& in, size_t rows, size_t capacity);
+    void mapBinary(binary::MappedReader& in, size_t rows, size_t capacity);
+
+private:
+    std::vector<std::unique_ptr<ColumnData>> columns_{};
+    size_t rows_ = 0;
+};
+
+} // namespace storage
+
+} // namespace db
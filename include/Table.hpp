@@ -1,14 +1,30 @@
 #pragma once
 
+#include "Aggregate.hpp"
 #include "Column.hpp"
+#include "CsvWriter.hpp"
+#include "Sort.hpp"
+#include "Storage.hpp"
+#include "Wal.hpp"
+#include "WorkerPool.hpp"
 // #include "Filter.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <filesystem>
-#include <list>
+#include <functional>
+#include <future>
+#include <limits>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
 #include <string>
+#include <tuple>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace db
@@ -17,14 +33,57 @@ namespace db
 namespace filters
 {
 class Filter;
+class Program;
+struct ProgramRegisters;
 }
 
+// `limit count offset offset`
+struct Limit
+{
+    std::optional<size_t> count{};
+    size_t offset = 0;
+
+    // Rows a scan has to produce before the offset is dropped
+    std::optional<size_t> needed() const
+    {
+        if (!count)
+        {
+            return std::nullopt;
+        }
+        return std::min(*count, std::numeric_limits<size_t>::max() - offset) +
+               offset;
+    }
+
+    template <typename T>
+    void apply(std::vector<T>& rows) const
+    {
+        rows.erase(rows.begin(),
+                   rows.begin() + std::min(offset, rows.size()));
+        if (count && *count < rows.size())
+        {
+            rows.resize(*count);
+        }
+    }
+};
+
 class Table final
 {
 
 public:
     using value_type = columns::BaseColumn::value_type;
 
+    // Rows handed to one worker at a time by parallel scans
+    static constexpr size_t kMorselSize = 16384;
+
+    // deserializeCSV() reads the data rows in blocks of this size and
+    // parses chunks of at least kCsvChunkSize bytes on the workers
+    static constexpr size_t kCsvBlockSize = 32 << 20;
+    static constexpr size_t kCsvChunkSize = 1 << 20;
+
+    // Ended versions are collected once there are at least this many and
+    // at least as many as current ones
+    static constexpr size_t kMinGarbage = 1024;
+
 public:
     struct Record
     {
@@ -50,25 +109,47 @@ public:
 public:
     using ColumnType = std::shared_ptr<columns::BaseColumn>;
 
-    using OrderedIndex =
-        std::multimap<columns::BaseColumn::value_type, std::shared_ptr<Record>>;
+    // column value -> row id
+    using OrderedIndex = std::multimap<columns::BaseColumn::value_type, size_t>;
+
+    using UniqueIndex = std::unordered_set<value_type, columns::ValueHash>;
 
     using InsertType = std::map<std::string, columns::BaseColumn::value_type>;
 
-    using QueryType = std::list<Record>;
+    using RowValues = storage::ColumnStore::RowValues;
 
     using Table_ptr = std::shared_ptr<Table>;
 
     using RecordMappingT = std::unordered_map<std::string, size_t>;
 
 public:
+    // The rows a query reads: every version committed up to `timestamp`
+    // that was still current then. Inserts and updates append a version
+    // and statements commit in timestamp order, so the committed versions
+    // are the first `rows`; updates and deletes stamp the versions they end
+    // with their commit timestamp. `live` counts the visible versions.
+    struct Snapshot
+    {
+        uint64_t timestamp = 0;
+        size_t rows = 0;
+        size_t live = 0;
+    };
+
+    // Result of a query. Plain selects keep only the ids of the matching rows
+    // and read the values from the table on access. The view keeps the
+    // snapshot of its query open, so later writes do not show and the rows
+    // stay where they are. Reloading or destroying the table makes it
+    // stale, it throws then. Joined results own materialized records
+    // instead.
     struct View
     {
 
         std::string tableName_;
         std::vector<ColumnType> columnPtrs = {};
         RecordMappingT recordMapping;
-        std::list<std::shared_ptr<Record>> recordPtrs = {};
+
+        std::vector<size_t> rowIds = {};
+        std::vector<std::shared_ptr<Record>> recordPtrs = {};
 
         View(std::string tableName, std::vector<ColumnType>& columnPtrs,
              RecordMappingT& recordMapping)
@@ -78,7 +159,146 @@ public:
         {
         }
 
+        size_t size() const
+        {
+            return table_ ? rowIds.size() : recordPtrs.size();
+        }
+
+        // False once the rows referenced by the view may have changed
+        bool isValid() const;
+
+        // `column` is a position from recordMapping
+        value_type value(size_t row, size_t column) const;
+
+        value_type value(size_t row, const std::string& name) const;
+
+        Record record(size_t row) const;
+
         void print();
+
+    private:
+        friend class Table;
+
+        void checkValid() const;
+
+        const Table* table_ = nullptr;
+        std::shared_ptr<const Snapshot> snapshot_;
+        std::shared_ptr<const std::atomic<uint64_t>> tableVersion_;
+        uint64_t version_ = 0;
+    };
+
+public:
+    // Pull-based scan: the filter runs one batch of rows at a time as the
+    // consumer asks for more, so memory stays constant however many rows
+    // match and the scan stops as soon as the consumer does. The cursor
+    // reads the snapshot it was opened on like a View, a reload makes it
+    // throw.
+    class Cursor
+    {
+
+    public:
+        Cursor(Table& table, RecordMappingT recordMapping,
+               std::unique_ptr<filters::Filter> filter);
+
+        Cursor(const Cursor&) = delete;
+
+        ~Cursor();
+
+    public:
+        const RecordMappingT& getRecordMapping() const
+        {
+            return recordMapping_;
+        }
+
+        // Moves to the next matching row, false once the scan is done
+        bool next();
+
+        // Ids of the matching rows of the next batch (at most
+        // filters::kBatchSize of them), empty once the scan is done.
+        // The last row of the batch becomes the current row.
+        const std::vector<size_t>& nextBatch();
+
+        // Accessors for the current row
+        size_t rowId() const;
+
+        // `column` is a position from the record mapping
+        value_type value(size_t column) const;
+
+        value_type value(const std::string& name) const;
+
+        Record record() const;
+
+    private:
+        bool fetch();
+        void checkValid() const;
+
+    private:
+        Table& table_;
+        RecordMappingT recordMapping_;
+        std::unique_ptr<filters::Filter> filter_;
+        std::unique_ptr<filters::Program> program_;
+        std::unique_ptr<filters::ProgramRegisters> registers_;
+        std::optional<std::vector<size_t>> candidates_;
+        std::shared_ptr<const Snapshot> snapshot_;
+        uint64_t version_;
+        size_t total_;
+        size_t scanned_ = 0;
+        std::vector<size_t> batch_{};
+        size_t pos_ = 0;
+    };
+
+public:
+    // Changes applied as one unit. The batch keeps other writers of the
+    // table waiting until it is committed or destroyed. Its changes reach
+    // the log and show to queries together at commit(); destroying the
+    // batch before that undoes them. Once a change throws, the batch can
+    // only be destroyed.
+    class Batch
+    {
+
+    public:
+        explicit Batch(Table& table);
+
+        Batch(const Batch&) = delete;
+
+        Batch& operator=(const Batch&) = delete;
+
+        ~Batch();
+
+    public:
+        // Later changes see the earlier ones, queries do not until commit
+        void insert(InsertType insertMap);
+
+        void update(filters::Filter* filter, const InsertType& newValues);
+
+        void del(filters::Filter* filter);
+
+        // Reapplies a logged change, it is not logged again
+        void replay(const wal::Entry& entry);
+
+        // Hands over the log entries of the changes so far, commit() no
+        // longer appends them. Transactions over several tables log them
+        // all together.
+        std::vector<wal::Entry> releaseLog();
+
+        void commit();
+
+    private:
+        friend class Table;
+
+        Table& table_;
+        std::unique_lock<std::mutex> lock_;
+        // versions before the batch, the ones after them are its own
+        size_t rows_ = 0;
+        size_t live_ = 0;
+        // versions current before the batch that it ended
+        std::vector<size_t> ended_{};
+        // unique keys added (true) or erased (false), undone in reverse
+        std::vector<std::tuple<UniqueIndex*, value_type, bool>> keys_{};
+        std::unordered_map<std::string, columns::Integer::value_type>
+            sequences_{};
+        std::vector<wal::Entry> log_{};
+        bool committed_ = false;
     };
 
 public:
@@ -91,6 +311,8 @@ public:
 
     Table(Table&& other) = delete;
 
+    ~Table();
+
 public:
     std::vector<ColumnType> getColumns() const
     {
@@ -117,27 +339,226 @@ public:
         return recordMapping_;
     }
 
+    // Every row version, current or not; only the rows of an open snapshot
+    // are safe to read while others write
+    const storage::ColumnStore& getStorage() const
+    {
+        return current_.load(std::memory_order_acquire)->store;
+    }
+
+    // Position of the column in a record, throws for unknown names
+    size_t getColumnIndex(const std::string& name) const;
+
+    bool hasColumn(const std::string& name) const
+    {
+        return recordMapping_.contains(name);
+    }
+
+    // Schema lock. Database holds it shared for queries, inserts, updates
+    // and deletes, which the table runs side by side itself, and exclusive
+    // for statements changing the schema or replacing the rows. The table
+    // never takes it.
+    std::shared_mutex& mutex() const
+    {
+        return mutex_;
+    }
+
+    // Scans are split into morsels shared by the workers of the pool,
+    // without a pool everything runs on the calling thread
+    void setWorkerPool(std::shared_ptr<WorkerPool> workers)
+    {
+        workers_ = std::move(workers);
+    }
+
+    // Memory budget and spill location of ORDER BY sorts
+    void setSortOptions(sort::SortOptions options)
+    {
+        sortOptions_ = std::move(options);
+    }
+
+    // Inserts, updates and deletes are appended to `log` as they commit
+    void setLog(std::shared_ptr<wal::Log> log)
+    {
+        log_ = std::move(log);
+    }
+
+    const std::shared_ptr<wal::Log>& getLog() const
+    {
+        return log_;
+    }
+
+    // Snapshots are taken holding `gate` shared, so whoever holds it
+    // exclusively commits several tables at once
+    void setCommitGate(std::shared_ptr<std::shared_mutex> gate)
+    {
+        commitGate_ = std::move(gate);
+    }
+
+    // Current rows as of the last commit
+    size_t size() const
+    {
+        return committed().live;
+    }
+
+    // Row versions held, current or ended but not collected yet
+    size_t versions() const
+    {
+        return committed().rows;
+    }
+
+    // Snapshot of the last commit. Versions it can see are kept until it
+    // is destroyed, with every copy of it.
+    std::shared_ptr<const Snapshot> openSnapshot() const;
+
+    // Drops the ended versions and frees the memory of retired
+    // generations. Row ids change, so nothing happens while a snapshot is
+    // open and the result is false. Writers call it as garbage piles up.
+    bool collectGarbage();
+
 public:
+    // Inserts, updates and deletes run one at a time, each as a Batch of
+    // its own: a statement failing midway changes nothing. Queries run
+    // alongside without waiting for them. Queries walking an ordered index
+    // keep writers from committing to it meanwhile.
     void insert(InsertType insertMap);
 
-    std::unique_ptr<View> select(std::vector<std::string>& selectList, std::unique_ptr<filters::Filter> filter);
+    std::unique_ptr<View> select(std::vector<std::string>& selectList, std::unique_ptr<filters::Filter> filter,
+                                 const std::vector<sort::SortKey>& orderBy = {}, const Limit& limit = {});
+
+    // `select ... group by ...`: one materialized record per group holding
+    // the selected group columns and aggregates
+    std::unique_ptr<View> aggregate(const std::vector<std::string>& selectList,
+                                    const aggregate::Grouping& grouping,
+                                    std::unique_ptr<filters::Filter> filter);
+
+    std::unique_ptr<Cursor> openCursor(std::vector<std::string>& selectList,
+                                       std::unique_ptr<filters::Filter> filter);
 
     void update(std::unique_ptr<filters::Filter> filter, InsertType newValues);
 
     void del(std::unique_ptr<filters::Filter> filter);
 
+    // The index is built on a background thread, selects keep doing full
+    // scans until it is ready, writes wait for it.
+    void createIndex(const std::string& name);
+
+    void dropIndex(const std::string& name);
+
+    void waitForIndexes();
+
+    // Reapplies a logged insert, update or delete without logging it again
+    void replay(const wal::Entry& entry);
+
 private:
     // Helpers
-    void insertImpl(InsertType mappedRecord);
-    void validateInsertion(InsertType&);
-    void buildRecord(Record&, InsertType&);
-    void validateRecord(std::shared_ptr<Record>);
-    void createIndexes(std::shared_ptr<Record>);
+    void addColumn(ColumnType column);
+    // the changes of Batch, batch_ open
+    void insertRow(InsertType mappedRecord);
+    void updateRows(filters::Filter* filter, const InsertType& newValues);
+    void deleteRows(filters::Filter* filter);
+    void replayEntry(const wal::Entry& entry);
+    RowValues insertImpl(InsertType mappedRecord);
+    void validateInsertion(const InsertType&);
+    void buildRecord(RowValues&, InsertType&);
+    // unique column ordinal and its hash set, resolved once per statement
+    using UniqueBindings = std::vector<std::pair<size_t, UniqueIndex*>>;
+    UniqueBindings bindUniqueIndexes();
+    void validateRecord(const RowValues&, const UniqueBindings&);
+    void addUniqueKeys(const RowValues&, const UniqueBindings&);
+    void appendRecord(const RowValues& newRecord, const UniqueBindings& uniques);
+    void applyUpdate(const std::vector<size_t>& rows,
+                     const InsertType& newValues);
+    void applyDelete(const std::vector<size_t>& rows);
+    // unique key changes, recorded for the undo of the batch
+    void addUniqueKey(UniqueIndex& index, const value_type& value);
+    void eraseUniqueKey(UniqueIndex& index, const value_type& value);
+    void logRows(uint32_t kind, std::vector<size_t> rows,
+                 const InsertType& newValues);
+    // Rows of the log are positions among the current versions, replay
+    // numbers the versions differently once garbage was collected
+    std::vector<size_t> logPositions(const std::vector<size_t>& rows);
+    std::vector<size_t> rowsAt(const std::vector<size_t>& positions);
+    // current versions counted in a Fenwick tree, so positions take
+    // logarithmic time however many versions precede them
+    void countVersions();
+    void countVersion(size_t row, bool current);
+    // adds the versions committed by the batch to the ordered indexes
+    void indexNewRows();
+    void eraseFromIndexes(const std::vector<bool>& keep);
+    OrderedIndex buildIndex(size_t columnIdx) const;
+    UniqueIndex buildUniqueIndex(size_t columnIdx) const;
+    // readers only adopt finished builds, and only if no writer holds the
+    // indexes
+    void collectIndexBuilds(bool wait);
+    bool hasIndex(const std::string& name) const;
+    // the index only narrows the scan, rows past the snapshot are dropped
+    // and rows the open batch appended are added
+    std::optional<std::vector<size_t>> indexScan(const filters::Filter& filter,
+                                                 const Snapshot& snapshot);
+    // stops once `needed` rows matched, the first ones in table order
+    std::vector<size_t> matchingRows(filters::Filter* filter,
+                                     const Snapshot& snapshot,
+                                     std::optional<size_t> needed = std::nullopt);
+    std::vector<size_t> orderRows(std::vector<size_t> rows,
+                                  const std::vector<sort::SortKey>& orderBy,
+                                  std::optional<size_t> limit,
+                                  const Snapshot& snapshot);
+    // first `needed` matching rows in the order of the index on `key`
+    std::vector<size_t> indexOrderedRows(filters::Filter* filter,
+                                         const sort::SortKey& key,
+                                         size_t needed,
+                                         const Snapshot& snapshot);
+    void forEachMorsel(
+        size_t count,
+        const std::function<void(size_t morsel, size_t begin, size_t end)>&
+            task);
+    Record readRecord(size_t row) const;
+    RecordMappingT viewMapping(const std::vector<std::string>& selectList);
+    void invalidateViews();
+    void clearSchema();
+    binary::Header readSchema(binary::Reader& in);
+    void writeBinary(std::ostream& file);
+    void rebuildIndexes();
+    void restoreSequences();
+
+    // Versions, writeMutex_ held unless noted
+    Snapshot committed() const; // any thread
+    std::shared_lock<std::shared_mutex> lockCommitGate() const;
+    // the current versions, uncommitted ones included
+    Snapshot latest() const;
+    bool visible(const Snapshot& snapshot, size_t row) const; // any thread
+    size_t appendVersion(const RowValues& values);
+    void endVersion(size_t row);
+    void grow(const RowValues& next);
+    // versions a generation of `rows` rows has room for: as many again,
+    // which is also the garbage collected at the latest
+    static size_t headroom(size_t rows)
+    {
+        return std::max<size_t>(2 * rows, kMinGarbage);
+    }
+    void commit();
+    void rollback();
+    // versions of freshly loaded rows, the stores left headroom() for more
+    void resetVersions();
+    bool reclaim();
 
 public:
-    void serializeCSV(std::filesystem::path dataFilePath);
+    // Buffered export, the layout deserializeCSV() reads
+    void serializeCSV(std::filesystem::path dataFilePath,
+                      csv::WriterOptions options = {});
     void deserializeCSV(std::filesystem::path dataFilePath);
 
+    // Binary format of BinaryFormat.hpp: the schema block followed by one
+    // checksummed block per column
+    void serialize(std::filesystem::path dataFilePath);
+    void deserialize(std::filesystem::path dataFilePath);
+
+    // Maps a file written by serialize() instead of reading it: scans read
+    // the columns straight from the mapping and pages are faulted in as
+    // they are touched. The first write copies the rows into memory, the
+    // file itself is never written. Column checksums are not verified.
+    void map(std::filesystem::path dataFilePath);
+
 private:
     std::string tableName_;
 
@@ -153,8 +574,70 @@ private:
     std::unordered_map<std::string, ColumnType> columnMap_;
     RecordMappingT recordMapping_;
     std::unordered_map<std::string, OrderedIndex> orderedIndexes_;
+    std::unordered_map<std::string, UniqueIndex> uniqueIndexes_;
 
-    QueryType records_{};
+    // Ended versions keep their rows until collected
+    static constexpr uint64_t kLive = std::numeric_limits<uint64_t>::max();
+
+    // The row versions. Writers append in place while the buffers have
+    // room, readers go on reading meanwhile. Otherwise the versions move
+    // to a new generation with twice the room and the old one is retired
+    // until no snapshot can be reading it.
+    struct Generation
+    {
+        storage::ColumnStore store;
+        // commit timestamp ending each version, kLive while it is current
+        std::unique_ptr<std::atomic<uint64_t>[]> ended{};
+        size_t capacity = 0;
+    };
+    std::unique_ptr<Generation> generation_ = std::make_unique<Generation>();
+    std::atomic<Generation*> current_ = generation_.get();
+    std::vector<std::unique_ptr<Generation>> retired_{};
+
+    // Last commit and the snapshots open on it. Shared with the snapshots,
+    // which may outlive the table like views do.
+    struct Clock
+    {
+        std::mutex mutex;
+        Snapshot committed;
+        size_t open = 0;
+    };
+    std::shared_ptr<Clock> clock_ = std::make_shared<Clock>();
+    // the next commit gets timestamp_ + 1
+    uint64_t timestamp_ = 0;
+    size_t live_ = 0;
+    // Fenwick tree over the current flags of the versions, 1-based. Only
+    // built once a logged statement needs positions, versions appended
+    // since are added by the next lookup; emptied when rows move.
+    std::vector<size_t> currentCounts_{};
+
+    std::shared_ptr<WorkerPool> workers_;
+
+    sort::SortOptions sortOptions_{};
+
+    std::shared_ptr<wal::Log> log_;
+    std::shared_ptr<std::shared_mutex> commitGate_;
+
+    // Bumped whenever existing rows change, checked by row-id views
+    std::shared_ptr<std::atomic<uint64_t>> version_ =
+        std::make_shared<std::atomic<uint64_t>>(0);
+
+    // Indexes being built in background, destroyed (and joined) first
+    std::unordered_map<std::string, std::future<OrderedIndex>> pendingIndexes_;
+    std::unordered_map<std::string, std::future<UniqueIndex>>
+        pendingUniqueIndexes_;
+    std::atomic<bool> indexesPending_ = false;
+
+    mutable std::shared_mutex mutex_;
+    // One writer at a time
+    std::mutex writeMutex_;
+    // The open batch, writeMutex_ held
+    Batch* batch_ = nullptr;
+    // Ordered indexes and their pending builds: writers change them
+    // exclusively, queries read them shared
+    mutable std::shared_mutex indexMutex_;
+    // versions covered by the ordered indexes, indexMutex_ held
+    size_t indexedRows_ = 0;
 };
 
 class TableException : public std::exception
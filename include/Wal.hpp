@@ -0,0 +1,153 @@
+#pragma once
+
+#include "Column.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace db
+{
+
+namespace wal
+{
+
+// Write-ahead log of the statements changing tables. Entries are physical
+// redo records: the full row an insert appended, the row ids an update or
+// delete touched. Replaying them in order on top of the snapshot the log
+// was started after reproduces the tables exactly, without re-evaluating
+// filters or autoincrement sequences.
+//
+// Every entry is one block of the binary table format (BinaryFormat.hpp),
+// so a torn write at the end of the log fails its checksum and replay
+// stops right before it. Entries appended together are preceded by a
+// kTransaction block counting them and replay all or none.
+
+enum EntryKind : uint32_t
+{
+    kCreateTable = 0x200,
+    kInsert = 0x201,
+    kUpdate = 0x202,
+    kDelete = 0x203,
+    kTransaction = 0x204,
+    kCreateIndex = 0x205,
+    kDropIndex = 0x206,
+};
+
+struct Entry
+{
+    EntryKind kind;
+    std::string table;
+
+    // kCreateTable
+    std::vector<std::shared_ptr<columns::BaseColumn>> columns{};
+    // kInsert, one value per column in column order
+    std::vector<columns::BaseColumn::value_type> values{};
+    // kUpdate, column ordinal and the new value
+    std::vector<std::pair<uint32_t, columns::BaseColumn::value_type>>
+        assignments{};
+    // kUpdate and kDelete, ascending row ids before the statement ran
+    std::vector<size_t> rows{};
+    // kTransaction, entries following it, never handed to replay callbacks
+    uint64_t count = 0;
+    // kCreateIndex and kDropIndex
+    std::string column{};
+};
+
+enum class SyncMode
+{
+    // Entries are written by the flusher thread but never fsynced,
+    // durability is up to the OS
+    Off,
+    // Writers return at once, the flusher fsyncs batches in background:
+    // a crash loses at most the batches in flight
+    Normal,
+    // Writers return once their entry is on disk. Writers arriving while
+    // an fsync runs are committed together by the next one.
+    Full,
+};
+
+struct Options
+{
+    SyncMode sync = SyncMode::Full;
+};
+
+// Appends entries to a log file. Writers only encode their entry and queue
+// it, a single flusher thread writes and fsyncs whole batches (group
+// commit). Safe to share between threads.
+class Log
+{
+
+public:
+    // Appends to the file at `path`, creating it if needed
+    explicit Log(std::filesystem::path path, Options options = {});
+
+    Log(const Log&) = delete;
+
+    Log& operator=(const Log&) = delete;
+
+    // Writes and syncs what is still queued
+    ~Log();
+
+public:
+    const std::filesystem::path& path() const
+    {
+        return path_;
+    }
+
+    // Throws DatabaseException once writing the log failed
+    void append(const Entry& entry);
+
+    // Appends `entries` as one unit, replay skips all of them if the log
+    // ends before the last one. Waits for a single sync in Full mode.
+    void append(const std::vector<Entry>& entries);
+
+    // Returns once everything appended so far is on disk, in any sync mode
+    void sync();
+
+private:
+    void enqueue(const std::string& bytes);
+    void flushLoop();
+    // waits until everything queued before the call is written
+    void waitWritten(std::unique_lock<std::mutex>& lock);
+
+private:
+    std::filesystem::path path_;
+    Options options_;
+    int fd_ = -1;
+
+    std::mutex mutex_;
+    std::condition_variable queued_;
+    std::condition_variable written_;
+
+    // guarded by mutex_
+    std::string pending_{};
+    uint64_t appended_ = 0;
+    uint64_t flushed_ = 0;
+    std::string error_{};
+    bool stop_ = false;
+
+    std::thread flusher_;
+};
+
+// Calls `apply` for every intact entry of the log at `path` in order and
+// returns the length of that prefix. Replay stops at the end of the file or
+// at the first torn or corrupt entry; the caller truncates the file to the
+// returned length before appending again.
+uint64_t replay(const std::filesystem::path& path,
+                const std::function<void(const Entry&)>& apply);
+
+// fsync of a file or of a directory after renames in it
+void syncPath(const std::filesystem::path& path);
+
+} // namespace wal
+
+} // namespace db
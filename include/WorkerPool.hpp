@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace db
+{
+
+// Fixed set of threads running data-parallel loops. The calling thread
+// takes part in every loop, so a pool of N threads runs N + 1 tasks at once.
+class WorkerPool final
+{
+
+public:
+    explicit WorkerPool(size_t threads);
+
+    WorkerPool(const WorkerPool&) = delete;
+
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    ~WorkerPool();
+
+public:
+    size_t size() const
+    {
+        return threads_.size();
+    }
+
+    // Calls task(i) for every i in [0, count) and returns once all calls
+    // finished. The first exception thrown by a task is rethrown here.
+    void parallelFor(size_t count, const std::function<void(size_t)>& task);
+
+private:
+    void workerLoop();
+    void runTasks(std::unique_lock<std::mutex>& lock,
+                  const std::function<void(size_t)>& task);
+
+private:
+    std::vector<std::thread> threads_;
+
+    std::mutex loopMutex_;
+    std::mutex mutex_;
+
+    // current loop, guarded by mutex_
+    const std::function<void(size_t)>* task_ = nullptr;
+    size_t count_ = 0;
+    size_t next_ = 0;
+    std::exception_ptr error_;
+
+    // workers sleep on generation_, the caller sleeps on running_
+    std::atomic<size_t> generation_ = 0;
+    std::atomic<size_t> running_ = 0;
+    std::atomic<bool> stop_ = false;
+};
+
+} // namespace db
@@ -0,0 +1,407 @@
+#include "Aggregate.hpp"
+#include "DataBaseException.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <numeric>
+
+namespace db
+{
+
+namespace aggregate
+{
+
+std::optional<Function> functionByName(std::string_view name)
+{
+    std::string lower;
+    for (auto c : name)
+    {
+        lower += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    if (lower == "count")
+        return Function::COUNT;
+    if (lower == "sum")
+        return Function::SUM;
+    if (lower == "min")
+        return Function::MIN;
+    if (lower == "max")
+        return Function::MAX;
+    if (lower == "avg")
+        return Function::AVG;
+    return std::nullopt;
+}
+
+std::string Aggregate::name() const
+{
+    std::string prefix;
+    switch (function)
+    {
+    case Function::COUNT:
+        prefix = "count";
+        break;
+    case Function::SUM:
+        prefix = "sum";
+        break;
+    case Function::MIN:
+        prefix = "min";
+        break;
+    case Function::MAX:
+        prefix = "max";
+        break;
+    case Function::AVG:
+        prefix = "avg";
+        break;
+    }
+    return prefix + "(" + (column.empty() ? "*" : column) + ")";
+}
+
+namespace
+{
+
+bool isInteger(columns::ColumType type)
+{
+    return type == columns::ColumType::Integer || type == columns::ColumType::Id;
+}
+
+bool isVarlen(columns::ColumType type)
+{
+    return type == columns::ColumType::String ||
+           type == columns::ColumType::Bytes;
+}
+
+int64_t integerAt(const storage::ColumnData& data, size_t row)
+{
+    if (data.getColumnType() == columns::ColumType::Bool)
+    {
+        return static_cast<const storage::BoolData&>(data).at(row) ? 1 : 0;
+    }
+    return static_cast<const storage::IntegerData&>(data).at(row);
+}
+
+storage::ColumnData::value_type emptyValue(columns::ColumType type)
+{
+    switch (type)
+    {
+    case columns::ColumType::Bool:
+        return false;
+    case columns::ColumType::String:
+        return std::string{};
+    case columns::ColumType::Bytes:
+        return std::vector<uint8_t>{};
+    default:
+        return 0;
+    }
+}
+
+} // namespace
+
+HashAggregation::HashAggregation(const storage::ColumnStore& store,
+                                 std::vector<size_t> groupColumns,
+                                 std::vector<BoundAggregate> aggregates)
+    : store_(store),
+      groupColumns_(std::move(groupColumns)),
+      aggregates_(std::move(aggregates)),
+      slots_(16)
+{
+    for (auto&& aggregate : aggregates_)
+    {
+        bool textual = false;
+        if (aggregate.column)
+        {
+            auto type = store_.column(*aggregate.column).getColumnType();
+            bool summed = aggregate.function == Function::SUM ||
+                          aggregate.function == Function::AVG;
+            if (summed && !isInteger(type))
+            {
+                throw DatabaseException(
+                    "SUM and AVG need an int32 column");
+            }
+            textual = isVarlen(type) && aggregate.function != Function::COUNT;
+        }
+        textual_.push_back(textual);
+    }
+}
+
+void HashAggregation::encodeKey(size_t row)
+{
+    key_.clear();
+    for (auto column : groupColumns_)
+    {
+        auto&& data = store_.column(column);
+        auto type = data.getColumnType();
+        if (isVarlen(type))
+        {
+            // length prefix keeps ("ab", "c") apart from ("a", "bc")
+            auto value = static_cast<const storage::VarlenData&>(data).at(row);
+            auto length = static_cast<uint32_t>(value.size());
+            key_.append(reinterpret_cast<const char*>(&length), sizeof(length));
+            key_.append(value);
+        }
+        else
+        {
+            auto value = static_cast<int32_t>(integerAt(data, row));
+            key_.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+    }
+}
+
+size_t HashAggregation::findOrInsert(uint64_t hash, size_t firstRow)
+{
+    const size_t mask = slots_.size() - 1;
+    for (size_t slot = hash & mask;; slot = (slot + 1) & mask)
+    {
+        auto&& entry = slots_[slot];
+        if (entry.group == kEmpty)
+        {
+            size_t group = firstRows_.size();
+            entry = { hash, static_cast<uint32_t>(group) };
+            keys_.push_back(key_);
+            hashes_.push_back(hash);
+            firstRows_.push_back(firstRow);
+            states_.resize(states_.size() + aggregates_.size());
+            texts_.resize(texts_.size() + aggregates_.size());
+            // keep the load factor at or below one half
+            if (2 * firstRows_.size() > slots_.size())
+            {
+                grow();
+            }
+            return group;
+        }
+        if (entry.hash == hash && keys_[entry.group] == key_)
+        {
+            return entry.group;
+        }
+    }
+}
+
+void HashAggregation::grow()
+{
+    std::vector<Slot> slots(slots_.size() * 2);
+    const size_t mask = slots.size() - 1;
+    for (size_t group = 0; group < hashes_.size(); ++group)
+    {
+        size_t slot = hashes_[group] & mask;
+        while (slots[slot].group != kEmpty)
+        {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = { hashes_[group], static_cast<uint32_t>(group) };
+    }
+    slots_ = std::move(slots);
+}
+
+void HashAggregation::update(size_t group, size_t aggregate, size_t row)
+{
+    auto&& state = states_[group * aggregates_.size() + aggregate];
+    auto&& spec = aggregates_[aggregate];
+    if (spec.function == Function::COUNT)
+    {
+        ++state.count;
+        return;
+    }
+
+    auto&& data = store_.column(*spec.column);
+    if (textual_[aggregate])
+    {
+        auto value = static_cast<const storage::VarlenData&>(data).at(row);
+        auto&& text = texts_[group * aggregates_.size() + aggregate];
+        bool better = spec.function == Function::MIN ? value < text
+                                                     : value > text;
+        if (state.count == 0 || better)
+        {
+            text.assign(value);
+        }
+        ++state.count;
+        return;
+    }
+
+    int64_t value = integerAt(data, row);
+    state.sum += value;
+    state.low = state.count == 0 ? value : std::min(state.low, value);
+    state.high = state.count == 0 ? value : std::max(state.high, value);
+    ++state.count;
+}
+
+void HashAggregation::add(std::span<const size_t> rows)
+{
+    if (groupColumns_.empty())
+    {
+        if (size() == 0)
+        {
+            key_.clear();
+            findOrInsert(0, std::numeric_limits<size_t>::max());
+        }
+        if (!rows.empty())
+        {
+            firstRows_[0] = std::min(firstRows_[0], rows.front());
+        }
+        for (size_t a = 0; a < aggregates_.size(); ++a)
+        {
+            if (aggregates_[a].function == Function::COUNT)
+            {
+                states_[a].count += static_cast<int64_t>(rows.size());
+                continue;
+            }
+            for (auto row : rows)
+            {
+                update(0, a, row);
+            }
+        }
+        return;
+    }
+
+    std::hash<std::string_view> hasher;
+    for (auto row : rows)
+    {
+        encodeKey(row);
+        size_t group = findOrInsert(hasher(key_), row);
+        for (size_t a = 0; a < aggregates_.size(); ++a)
+        {
+            update(group, a, row);
+        }
+    }
+}
+
+void HashAggregation::combine(size_t group, size_t aggregate,
+                              const HashAggregation& other, size_t otherGroup)
+{
+    const size_t width = aggregates_.size();
+    auto&& state = states_[group * width + aggregate];
+    auto&& from = other.states_[otherGroup * width + aggregate];
+    if (from.count == 0)
+    {
+        return;
+    }
+    if (textual_[aggregate])
+    {
+        auto&& text = texts_[group * width + aggregate];
+        auto&& fromText = other.texts_[otherGroup * width + aggregate];
+        bool better = aggregates_[aggregate].function == Function::MIN
+                          ? fromText < text
+                          : fromText > text;
+        if (state.count == 0 || better)
+        {
+            text = fromText;
+        }
+    }
+    state.low = state.count == 0 ? from.low : std::min(state.low, from.low);
+    state.high = state.count == 0 ? from.high : std::max(state.high, from.high);
+    state.sum += from.sum;
+    state.count += from.count;
+}
+
+void HashAggregation::merge(const HashAggregation& other)
+{
+    for (size_t otherGroup = 0; otherGroup < other.size(); ++otherGroup)
+    {
+        key_ = other.keys_[otherGroup];
+        size_t group = findOrInsert(other.hashes_[otherGroup],
+                                    other.firstRows_[otherGroup]);
+        firstRows_[group] =
+            std::min(firstRows_[group], other.firstRows_[otherGroup]);
+        for (size_t a = 0; a < aggregates_.size(); ++a)
+        {
+            combine(group, a, other, otherGroup);
+        }
+    }
+}
+
+storage::ColumnData::value_type HashAggregation::finish(size_t group,
+                                                        size_t aggregate) const
+{
+    auto&& spec = aggregates_[aggregate];
+    auto&& state = states_[group * aggregates_.size() + aggregate];
+    auto type = spec.column ? store_.column(*spec.column).getColumnType()
+                            : columns::ColumType::Integer;
+
+    auto narrow = [](int64_t value) -> storage::ColumnData::value_type
+    {
+        if (value < std::numeric_limits<int32_t>::min() ||
+            value > std::numeric_limits<int32_t>::max())
+        {
+            throw DatabaseException("Aggregate result overflows int32");
+        }
+        return static_cast<int>(value);
+    };
+
+    switch (spec.function)
+    {
+    case Function::COUNT:
+        return narrow(state.count);
+    case Function::SUM:
+        return narrow(state.sum);
+    case Function::AVG:
+        return narrow(state.count == 0 ? 0 : state.sum / state.count);
+    case Function::MIN:
+    case Function::MAX:
+    {
+        if (state.count == 0)
+        {
+            return emptyValue(type);
+        }
+        if (textual_[aggregate])
+        {
+            auto&& text = texts_[group * aggregates_.size() + aggregate];
+            if (type == columns::ColumType::Bytes)
+            {
+                return std::vector<uint8_t>(text.begin(), text.end());
+            }
+            return text;
+        }
+        int64_t value = spec.function == Function::MIN ? state.low : state.high;
+        if (type == columns::ColumType::Bool)
+        {
+            return value != 0;
+        }
+        return static_cast<int>(value);
+    }
+    }
+    throw DatabaseException("Unknown aggregate function");
+}
+
+std::vector<std::vector<storage::ColumnData::value_type>>
+HashAggregation::results() const
+{
+    std::vector<size_t> order(size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](size_t left, size_t right)
+              { return firstRows_[left] < firstRows_[right]; });
+
+    std::vector<std::vector<storage::ColumnData::value_type>> rows;
+    rows.reserve(order.size());
+    for (auto group : order)
+    {
+        auto&& values = rows.emplace_back();
+        for (auto column : groupColumns_)
+        {
+            values.push_back(store_.column(column).get(firstRows_[group]));
+        }
+        for (size_t a = 0; a < aggregates_.size(); ++a)
+        {
+            values.push_back(finish(group, a));
+        }
+    }
+
+    if (rows.empty() && groupColumns_.empty())
+    {
+        // an ungrouped aggregate over no rows still yields one row
+        auto&& values = rows.emplace_back();
+        for (size_t a = 0; a < aggregates_.size(); ++a)
+        {
+            auto&& spec = aggregates_[a];
+            bool extreme = spec.function == Function::MIN ||
+                           spec.function == Function::MAX;
+            values.push_back(
+                extreme ? emptyValue(store_.column(*spec.column).getColumnType())
+                        : storage::ColumnData::value_type{ 0 });
+        }
+    }
+    return rows;
+}
+
+} // namespace aggregate
+
+} // namespace db
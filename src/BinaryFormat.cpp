@@ -0,0 +1,442 @@
+#include "BinaryFormat.hpp"
+#include "DataBaseException.hpp"
+#include "Simd.hpp"
+
+#include <array>
+#include <bit>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define SMALL_SQL_X86_64 1
+#endif
+
+static_assert(std::endian::native == std::endian::little,
+              "the binary table format is little endian");
+
+namespace db
+{
+
+namespace binary
+{
+
+namespace
+{
+
+// slicing-by-8 tables, tables[k][b] advances a byte b followed by k zeros
+constexpr auto kTables = []
+{
+    std::array<std::array<uint32_t, 256>, 8> tables{};
+    for (uint32_t b = 0; b < 256; ++b)
+    {
+        uint32_t crc = b;
+        for (int bit = 0; bit < 8; ++bit)
+        {
+            crc = crc & 1 ? (crc >> 1) ^ 0x82F63B78u : crc >> 1;
+        }
+        tables[0][b] = crc;
+    }
+    for (uint32_t b = 0; b < 256; ++b)
+    {
+        for (size_t k = 1; k < 8; ++k)
+        {
+            uint32_t prev = tables[k - 1][b];
+            tables[k][b] = (prev >> 8) ^ tables[0][prev & 0xFF];
+        }
+    }
+    return tables;
+}();
+
+uint32_t crcScalar(uint32_t crc, const unsigned char* data, size_t size)
+{
+    while (size >= 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, data, sizeof(word));
+        word ^= crc;
+        crc = kTables[7][word & 0xFF] ^ kTables[6][(word >> 8) & 0xFF] ^
+              kTables[5][(word >> 16) & 0xFF] ^
+              kTables[4][(word >> 24) & 0xFF] ^
+              kTables[3][(word >> 32) & 0xFF] ^
+              kTables[2][(word >> 40) & 0xFF] ^
+              kTables[1][(word >> 48) & 0xFF] ^ kTables[0][word >> 56];
+        data += 8;
+        size -= 8;
+    }
+    while (size-- > 0)
+    {
+        crc = (crc >> 8) ^ kTables[0][(crc ^ *data++) & 0xFF];
+    }
+    return crc;
+}
+
+#ifdef SMALL_SQL_X86_64
+
+__attribute__((target("sse4.2"))) uint32_t
+crcSse42(uint32_t crc, const unsigned char* data, size_t size)
+{
+    uint64_t wide = crc;
+    while (size >= 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, data, sizeof(word));
+        wide = _mm_crc32_u64(wide, word);
+        data += 8;
+        size -= 8;
+    }
+    crc = static_cast<uint32_t>(wide);
+    while (size-- > 0)
+    {
+        crc = _mm_crc32_u8(crc, *data++);
+    }
+    return crc;
+}
+
+#endif
+
+[[noreturn]] void corrupt(const std::string& what)
+{
+    throw DatabaseException("Corrupt table file: " + what);
+}
+
+} // namespace
+
+uint32_t crc32c(uint32_t crc, const void* data, size_t size)
+{
+    auto bytes = static_cast<const unsigned char*>(data);
+    crc = ~crc;
+#ifdef SMALL_SQL_X86_64
+    if (simd::detectLevel() != simd::Level::Scalar)
+    {
+        return ~crcSse42(crc, bytes, size);
+    }
+#endif
+    return ~crcScalar(crc, bytes, size);
+}
+
+void Writer::header(const Header& header)
+{
+    char buffer[kHeaderSize] = {};
+    std::memcpy(buffer, kMagic, sizeof(kMagic));
+    std::memcpy(buffer + 8, &header.version, 4);
+    std::memcpy(buffer + 12, &header.columnCount, 4);
+    std::memcpy(buffer + 16, &header.rowCount, 8);
+    uint32_t crc = crc32c(0, buffer, 24);
+    std::memcpy(buffer + 24, &crc, 4);
+    out_.write(buffer, sizeof(buffer));
+}
+
+void Writer::beginBlock(uint32_t kind)
+{
+    blockStart_ = out_.tellp();
+    blockLength_ = 0;
+    crc_ = 0;
+    char placeholder[kBlockHeaderSize] = {};
+    std::memcpy(placeholder, &kind, 4);
+    out_.write(placeholder, sizeof(placeholder));
+}
+
+void Writer::endBlock()
+{
+    align();
+    auto end = out_.tellp();
+    out_.seekp(blockStart_ + std::streamoff(4));
+    out_.write(reinterpret_cast<const char*>(&crc_), 4);
+    out_.write(reinterpret_cast<const char*>(&blockLength_), 8);
+    out_.seekp(end);
+    if (!out_)
+    {
+        throw DatabaseException("Failed to write table file");
+    }
+}
+
+void Writer::bytes(const void* data, size_t size)
+{
+    out_.write(static_cast<const char*>(data),
+               static_cast<std::streamsize>(size));
+    crc_ = crc32c(crc_, data, size);
+    blockLength_ += size;
+}
+
+void Writer::string(std::string_view value)
+{
+    pod(static_cast<uint32_t>(value.size()));
+    bytes(value.data(), value.size());
+}
+
+void Writer::align()
+{
+    static constexpr char zeros[8] = {};
+    bytes(zeros, padding(blockLength_));
+}
+
+Header Reader::header()
+{
+    char buffer[kHeaderSize];
+    if (!in_.read(buffer, sizeof(buffer)))
+    {
+        corrupt("truncated header");
+    }
+    if (std::memcmp(buffer, kMagic, sizeof(kMagic)) != 0)
+    {
+        corrupt("not a small-sql table file");
+    }
+    uint32_t crc;
+    std::memcpy(&crc, buffer + 24, 4);
+    if (crc != crc32c(0, buffer, 24))
+    {
+        corrupt("header checksum mismatch");
+    }
+
+    Header header;
+    std::memcpy(&header.version, buffer + 8, 4);
+    std::memcpy(&header.columnCount, buffer + 12, 4);
+    std::memcpy(&header.rowCount, buffer + 16, 8);
+    if (header.version != kVersion)
+    {
+        corrupt("unsupported version " + std::to_string(header.version));
+    }
+    return header;
+}
+
+uint64_t Reader::beginBlock(uint32_t kind)
+{
+    auto actualKind = nextBlock();
+    if (actualKind != kind)
+    {
+        corrupt("unexpected block kind " + std::to_string(actualKind));
+    }
+    return blockLength_;
+}
+
+uint32_t Reader::nextBlock()
+{
+    char buffer[kBlockHeaderSize];
+    if (!in_.read(buffer, sizeof(buffer)))
+    {
+        corrupt("truncated block header");
+    }
+    uint32_t kind;
+    std::memcpy(&kind, buffer, 4);
+    std::memcpy(&expectedCrc_, buffer + 4, 4);
+    std::memcpy(&blockLength_, buffer + 8, 8);
+    // the length is only covered by the checksum verified at the end,
+    // readers size their buffers by it before that
+    if (auto left = available(); left && blockLength_ > *left)
+    {
+        corrupt("block longer than the file");
+    }
+    consumed_ = 0;
+    crc_ = 0;
+    return kind;
+}
+
+std::optional<uint64_t> Reader::available()
+{
+    auto position = in_.tellg();
+    if (position == std::streampos(-1))
+    {
+        in_.clear();
+        return std::nullopt;
+    }
+    if (!end_)
+    {
+        // the stream does not grow while it is read, seek once
+        in_.seekg(0, std::ios::end);
+        end_ = in_.tellg();
+        in_.seekg(position);
+        if (!in_ || *end_ == std::streampos(-1))
+        {
+            in_.clear();
+            in_.seekg(position);
+            end_.reset();
+            return std::nullopt;
+        }
+    }
+    return static_cast<uint64_t>(*end_ - position);
+}
+
+void Reader::endBlock()
+{
+    align();
+    if (remaining() != 0)
+    {
+        corrupt("trailing bytes in block");
+    }
+    if (crc_ != expectedCrc_)
+    {
+        corrupt("block checksum mismatch");
+    }
+}
+
+void Reader::require(uint64_t count, size_t size) const
+{
+    if (count > remaining() / size)
+    {
+        corrupt("read past the end of a block");
+    }
+}
+
+void Reader::bytes(void* data, size_t size)
+{
+    require(size);
+    if (!in_.read(static_cast<char*>(data), static_cast<std::streamsize>(size)))
+    {
+        corrupt("truncated block");
+    }
+    crc_ = crc32c(crc_, data, size);
+    consumed_ += size;
+}
+
+std::string Reader::string()
+{
+    auto size = pod<uint32_t>();
+    require(size);
+    std::string value(size, '\0');
+    bytes(value.data(), size);
+    return value;
+}
+
+void Reader::align()
+{
+    char zeros[8];
+    bytes(zeros, padding(consumed_));
+}
+
+MappedFile::MappedFile(const std::filesystem::path& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        throw DatabaseException("Failed to open file for mapping: " +
+                                path.string());
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0)
+    {
+        ::close(fd);
+        throw DatabaseException("Failed to stat file: " + path.string());
+    }
+    size_ = static_cast<size_t>(info.st_size);
+    if (size_ != 0)
+    {
+        void* data = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            ::close(fd);
+            throw DatabaseException("Failed to map file: " + path.string());
+        }
+        data_ = static_cast<char*>(data);
+    }
+    // kept for the regions, which map parts of the file again
+    fd_ = fd;
+}
+
+MappedFile::~MappedFile()
+{
+    if (data_ != nullptr)
+    {
+        ::munmap(data_, size_);
+    }
+    ::close(fd_);
+}
+
+MappedRegion::MappedRegion(const MappedFile& file, uint64_t offset,
+                           size_t size, size_t room)
+{
+    // file mappings start at a page, the bytes before `offset` come along
+    static const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    uint64_t start = offset / page * page;
+    size_t lead = static_cast<size_t>(offset - start);
+    size_t mapped = (lead + size + page - 1) / page * page;
+    length_ = std::max<size_t>(
+        (lead + size + room + page - 1) / page * page, page);
+
+    // the room first, then the file pages over its start
+    base_ = ::mmap(nullptr, length_, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base_ == MAP_FAILED)
+    {
+        throw DatabaseException("Failed to reserve memory for a mapping");
+    }
+    if (size != 0 &&
+        ::mmap(base_, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+               file.descriptor(), static_cast<off_t>(start)) == MAP_FAILED)
+    {
+        ::munmap(base_, length_);
+        throw DatabaseException("Failed to map file region");
+    }
+    data_ = static_cast<char*>(base_) + lead;
+}
+
+MappedRegion::~MappedRegion()
+{
+    ::munmap(base_, length_);
+}
+
+uint64_t MappedReader::beginBlock(uint32_t kind)
+{
+    auto bytes = file_->bytes();
+    if (bytes.size() < position_ || bytes.size() - position_ < kBlockHeaderSize)
+    {
+        corrupt("truncated block header");
+    }
+    uint32_t actualKind;
+    uint64_t length;
+    std::memcpy(&actualKind, bytes.data() + position_, 4);
+    std::memcpy(&length, bytes.data() + position_ + 8, 8);
+    if (actualKind != kind)
+    {
+        corrupt("unexpected block kind " + std::to_string(actualKind));
+    }
+    position_ += kBlockHeaderSize;
+    if (length > bytes.size() - position_)
+    {
+        corrupt("truncated block");
+    }
+    blockEnd_ = position_ + length;
+    return length;
+}
+
+void MappedReader::endBlock()
+{
+    align();
+    if (remaining() != 0)
+    {
+        corrupt("trailing bytes in block");
+    }
+}
+
+void MappedReader::align()
+{
+    // blocks start 8-byte aligned, so the file offset tells the padding
+    auto size = padding(position_);
+    require(size);
+    position_ += size;
+}
+
+void MappedReader::require(uint64_t count, size_t size) const
+{
+    if (count > remaining() / size)
+    {
+        corrupt("read past the end of a block");
+    }
+}
+
+void MappedReader::checkAlignment(size_t alignment) const
+{
+    if (position_ % alignment != 0)
+    {
+        corrupt("misaligned block payload");
+    }
+}
+
+} // namespace binary
+
+} // namespace db
@@ -1,5 +1,6 @@
 
 #include "Column.hpp"
+#include "BinaryFormat.hpp"
 #include "DataBaseException.hpp"
 #include "Helpers.hpp"
 #include <cstddef>
@@ -7,8 +8,36 @@
 #include <iostream>
 #include <optional>
 #include <sstream>
+#include <string_view>
+#include <type_traits>
+#include <variant>
 
-void db::columns::serializeCSV(std::ofstream& file,
+size_t db::columns::ValueHash::operator()(
+    const BaseColumn::value_type& value) const
+{
+    size_t hash = 0;
+    if (auto boolValue = std::get_if<Bool::value_type>(&value))
+    {
+        hash = std::hash<bool>{}(*boolValue);
+    }
+    else if (auto intValue = std::get_if<Integer::value_type>(&value))
+    {
+        hash = std::hash<int>{}(*intValue);
+    }
+    else if (auto stringValue = std::get_if<String::value_type>(&value))
+    {
+        hash = std::hash<std::string_view>{}(*stringValue);
+    }
+    else if (auto bytesValue = std::get_if<Bytes::value_type>(&value))
+    {
+        hash = std::hash<std::string_view>{}(std::string_view(
+            reinterpret_cast<const char*>(bytesValue->data()),
+            bytesValue->size()));
+    }
+    return hash ^ value.index();
+}
+
+void db::columns::serializeCSV(std::ostream& file,
                                std::shared_ptr<BaseColumn> column)
 {
     ColumType colType = column->getColumnType();
@@ -118,6 +147,45 @@ void db::columns::serializeCSV(std::ofstream& file,
     file << ss.str() << std::endl;
 }
 
+namespace
+{
+
+using namespace db::columns;
+
+std::shared_ptr<BaseColumn>
+makeColumn(ColumType type, const std::string& name,
+           const std::optional<BaseColumn::value_type>& defaultValue,
+           bool index, bool unique, bool key, bool autoIncrement,
+           size_t maxLen)
+{
+    auto fallback = [&]<typename T>(T empty) -> T
+    { return defaultValue ? std::get<T>(*defaultValue) : empty; };
+
+    switch (type)
+    {
+    case ColumType::Integer:
+        return std::make_shared<Integer>(name, fallback(Integer::value_type{}),
+                                         index, unique, key, autoIncrement);
+    case ColumType::Id:
+        return std::make_shared<Id>();
+    case ColumType::Bool:
+        return std::make_shared<Bool>(name, fallback(Bool::value_type{}),
+                                      index, unique, key);
+    case ColumType::String:
+        return std::make_shared<String>(name, maxLen,
+                                        fallback(String::value_type{}), index,
+                                        unique, key);
+    case ColumType::Bytes:
+        return std::make_shared<Bytes>(name, maxLen,
+                                       fallback(Bytes::value_type{}), index,
+                                       unique, key);
+    default:
+        throw db::DatabaseException("Error: Unknown column type.");
+    }
+}
+
+} // namespace
+
 std::shared_ptr<db::columns::BaseColumn>
 db::columns::deserializeCSV(std::istringstream& file)
 {
@@ -233,61 +301,120 @@ db::columns::deserializeCSV(std::istringstream& file)
         }
     }
 
-    // Construct the appropriate column object
-    std::shared_ptr<BaseColumn> column;
-
-    if (colType == ColumType::Integer)
+    // Bytes defaults are stored as text
+    if (colType == ColumType::Bytes && defaultValue &&
+        std::holds_alternative<std::string>(*defaultValue))
     {
-        bool autoIncrement = additionalFieldStr == "1";
-        int defaultIntValue =
-            defaultValuePresent && defaultValue.has_value()
-                ? std::get<Integer::value_type>(defaultValue.value())
-                : 0;
-        column = std::make_shared<Integer>(name, defaultIntValue, index, unique,
-                                           key, autoIncrement);
+        auto&& text = std::get<std::string>(*defaultValue);
+        defaultValue = Bytes::value_type(text.begin(), text.end());
     }
-    else if (colType == ColumType::Id)
+
+    bool varlen = colType == ColumType::String || colType == ColumType::Bytes;
+    return makeColumn(colType, name,
+                      defaultValuePresent ? defaultValue : std::nullopt,
+                      index, unique, key, additionalFieldStr == "1",
+                      varlen ? std::stoull(additionalFieldStr) : 0);
+}
+
+namespace
+{
+
+enum ColumnFlags : uint8_t
+{
+    kUnique = 1,
+    kKey = 2,
+    kIndex = 4,
+    kAutoIncrement = 8,
+    kDefault = 16,
+};
+
+} // namespace
+
+void db::columns::serializeValue(binary::Writer& out,
+                                 const BaseColumn::value_type& value)
+{
+    out.pod(static_cast<uint8_t>(value.index()));
+    std::visit(
+        [&](auto&& alternative)
+        {
+            using T = std::decay_t<decltype(alternative)>;
+            if constexpr (std::is_same_v<T, bool>)
+            {
+                out.pod(static_cast<uint8_t>(alternative));
+            }
+            else if constexpr (std::is_same_v<T, int>)
+            {
+                out.pod(static_cast<int32_t>(alternative));
+            }
+            else
+            {
+                out.string(std::string_view(
+                    reinterpret_cast<const char*>(alternative.data()),
+                    alternative.size()));
+            }
+        },
+        value);
+}
+
+db::columns::BaseColumn::value_type
+db::columns::deserializeValue(binary::Reader& in)
+{
+    switch (in.pod<uint8_t>())
     {
-        column = std::make_shared<Id>();
-    }
-    else if (colType == ColumType::Bool)
+    case 0:
+        return in.pod<uint8_t>() != 0;
+    case 1:
+        return static_cast<int>(in.pod<int32_t>());
+    case 2:
+        return in.string();
+    case 3:
     {
-        bool defaultBoolValue =
-            defaultValuePresent && defaultValue.has_value()
-                ? std::get<Bool::value_type>(defaultValue.value())
-                : false;
-        column =
-            std::make_shared<Bool>(name, defaultBoolValue, index, unique, key);
+        auto text = in.string();
+        return Bytes::value_type(text.begin(), text.end());
     }
-    else if (colType == ColumType::String)
-    {
-        size_t maxLen = std::stoull(additionalFieldStr);
-        String::value_type defaultStringValue =
-            defaultValuePresent && defaultValue.has_value()
-                ? std::get<String::value_type>(defaultValue.value())
-                : std::string{};
-        column = std::make_shared<String>(name, maxLen, defaultStringValue,
-                                          index, unique, key);
+    default:
+        throw DatabaseException("Corrupt table file: bad value");
     }
-    else if (colType == ColumType::Bytes)
+}
+
+void db::columns::serializeBinary(binary::Writer& out,
+                                  const std::shared_ptr<BaseColumn>& column)
+{
+    auto type = column->getColumnType();
+    out.pod(static_cast<uint8_t>(type));
+    out.string(column->name());
+
+    uint8_t flags = (column->isUnique() ? kUnique : 0) |
+                    (column->isKey() ? kKey : 0) |
+                    (column->isIndex() ? kIndex : 0) |
+                    (column->isAutoIncrement() ? kAutoIncrement : 0) |
+                    (column->hasDefault() ? kDefault : 0);
+    out.pod(flags);
+    bool varlen = type == ColumType::String || type == ColumType::Bytes;
+    out.pod(static_cast<uint64_t>(varlen ? column->getValueSize() : 0));
+
+    if (!column->hasDefault())
     {
-        size_t maxLen = std::stoull(additionalFieldStr);
-        auto defaultBytesValue =
-            (defaultValuePresent && defaultValue.has_value())
-                ? std::get<std::string>(defaultValue.value())
-                : std::string{};
-        Bytes::value_type result{};
-        for(auto&& i: defaultBytesValue){
-            result.push_back(static_cast<Bytes::value_type::value_type>(i));
-        }
-        column = std::make_shared<Bytes>(name, maxLen, result, index,
-                                         unique, key);
+        return;
     }
-    else
+    serializeValue(out, column->getDefaultValue());
+}
+
+std::shared_ptr<db::columns::BaseColumn>
+db::columns::deserializeBinary(binary::Reader& in)
+{
+    auto type = static_cast<ColumType>(in.pod<uint8_t>());
+    auto name = in.string();
+    auto flags = in.pod<uint8_t>();
+    auto maxLen = in.pod<uint64_t>();
+
+    std::optional<BaseColumn::value_type> defaultValue;
+    if (flags & kDefault)
     {
-        throw DatabaseException("Error: Unknown column type.");
+        defaultValue = deserializeValue(in);
     }
 
-    return column;
-    return {};
+    return makeColumn(type, name, defaultValue, flags & kIndex,
+                      flags & kUnique, flags & kKey, flags & kAutoIncrement,
+                      maxLen);
 }
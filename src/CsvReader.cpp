@@ -0,0 +1,217 @@
+#include "CsvReader.hpp"
+#include "Table.hpp"
+
+#include <bit>
+#include <charconv>
+#include <cstring>
+#include <string>
+
+namespace db
+{
+
+namespace csv
+{
+
+namespace
+{
+
+void appendField(storage::ColumnData& column, std::string_view field)
+{
+    switch (column.getColumnType())
+    {
+    case columns::ColumType::Integer:
+    case columns::ColumType::Id:
+    {
+        storage::IntegerData::element_type value = 0;
+        auto [end, error] =
+            std::from_chars(field.data(), field.data() + field.size(), value);
+        if (error != std::errc{} || end != field.data() + field.size())
+        {
+            throw TableException("Invalid integer in CSV data: " +
+                                 std::string(field));
+        }
+        static_cast<storage::IntegerData&>(column).append(value);
+        break;
+    }
+    case columns::ColumType::Bool:
+        static_cast<storage::BoolData&>(column).append(field == "true");
+        break;
+    case columns::ColumType::String:
+    case columns::ColumType::Bytes:
+        static_cast<storage::VarlenData&>(column).append(field);
+        break;
+    default:
+        throw TableException("Unknown column type during deserialization.");
+    }
+}
+
+} // namespace
+
+Tokenizer::Tokenizer(std::string_view data)
+    : data_(data), level_(simd::detectLevel())
+{
+}
+
+void Tokenizer::advance()
+{
+    auto masks =
+        simd::classifyCsv(data_.data() + next_, data_.size() - next_, level_);
+    uint64_t quoted = simd::prefixXor(masks.quotes);
+    if (inQuotes_)
+    {
+        quoted = ~quoted;
+    }
+    inQuotes_ = quoted >> 63;
+    delimiters_ = (masks.commas | masks.newlines) & ~quoted;
+    block_ = next_;
+    next_ += 64;
+}
+
+bool Tokenizer::next(std::string_view& field, bool& rowEnd)
+{
+    while (delimiters_ == 0)
+    {
+        if (next_ >= data_.size())
+        {
+            // the last field runs to the end of the data
+            if (fieldStart_ >= data_.size() && !rowOpen_)
+            {
+                return false;
+            }
+            field = unquote(fieldStart_, data_.size());
+            rowEnd = true;
+            fieldStart_ = data_.size();
+            rowOpen_ = false;
+            return true;
+        }
+        advance();
+    }
+
+    size_t pos = block_ + std::countr_zero(delimiters_);
+    delimiters_ &= delimiters_ - 1;
+    field = unquote(fieldStart_, pos);
+    rowEnd = data_[pos] == '\n';
+    rowOpen_ = !rowEnd;
+    fieldStart_ = pos + 1;
+    return true;
+}
+
+std::string_view Tokenizer::unquote(size_t begin, size_t end)
+{
+    const char* data = data_.data();
+    if (begin == end || data[begin] != '"')
+    {
+        return { data + begin, end - begin };
+    }
+
+    // "" stands for one quote; text after the closing quote up to the
+    // delimiter is kept like parseCSVLine() always kept it
+    size_t pos = begin + 1;
+    auto quote =
+        static_cast<const char*>(std::memchr(data + pos, '"', end - pos));
+    if (quote && quote == data + end - 1)
+    {
+        return { data + pos, end - 1 - pos };
+    }
+    scratch_.clear();
+    while (true)
+    {
+        if (!quote)
+        {
+            throw TableException("Unterminated quoted field in CSV data.");
+        }
+        size_t at = static_cast<size_t>(quote - data);
+        scratch_.append(data + pos, at - pos);
+        pos = at + 1;
+        if (pos < end && data[pos] == '"')
+        {
+            scratch_ += '"';
+            quote = static_cast<const char*>(
+                std::memchr(data + pos + 1, '"', end - pos - 1));
+            ++pos;
+            continue;
+        }
+        break;
+    }
+    scratch_.append(data + pos, end - pos);
+    return scratch_;
+}
+
+size_t splitRows(std::string_view data, bool final, size_t chunkSize,
+                 std::vector<std::string_view>& chunks)
+{
+    auto level = simd::detectLevel();
+    size_t chunkStart = 0;
+    size_t rowEnd = 0;
+    bool inQuotes = false;
+
+    for (size_t block = 0; block < data.size(); block += 64)
+    {
+        auto masks = simd::classifyCsv(data.data() + block,
+                                       data.size() - block, level);
+        uint64_t quoted = simd::prefixXor(masks.quotes);
+        if (inQuotes)
+        {
+            quoted = ~quoted;
+        }
+        inQuotes = quoted >> 63;
+        for (uint64_t rows = masks.newlines & ~quoted; rows != 0;
+             rows &= rows - 1)
+        {
+            rowEnd = block + std::countr_zero(rows) + 1;
+            if (rowEnd - chunkStart >= chunkSize)
+            {
+                chunks.emplace_back(data.data() + chunkStart,
+                                    rowEnd - chunkStart);
+                chunkStart = rowEnd;
+            }
+        }
+    }
+
+    if (final)
+    {
+        rowEnd = data.size();
+    }
+    if (rowEnd > chunkStart)
+    {
+        chunks.emplace_back(data.data() + chunkStart, rowEnd - chunkStart);
+    }
+    return rowEnd;
+}
+
+size_t parseRows(std::string_view chunk, storage::ColumnStore& out)
+{
+    size_t columns = out.columnCount();
+    Tokenizer tokens(chunk);
+    std::string_view field;
+    bool rowEnd = false;
+    size_t column = 0;
+    size_t rows = 0;
+
+    while (tokens.next(field, rowEnd))
+    {
+        if (column >= columns)
+        {
+            throw TableException(
+                "Missmatch between number of columns and data fields.");
+        }
+        appendField(out.column(column++), field);
+        if (rowEnd)
+        {
+            if (column != columns)
+            {
+                throw TableException(
+                    "Missmatch between number of columns and data fields.");
+            }
+            column = 0;
+            ++rows;
+        }
+    }
+
+    out.commitRows(rows);
+    return rows;
+}
+
+} // namespace csv
+
+} // namespace db
@@ -0,0 +1,220 @@
+#include "CsvWriter.hpp"
+#include "DataBaseException.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace db
+{
+
+namespace csv
+{
+
+namespace
+{
+
+size_t alignUp(size_t size)
+{
+    return (size + Writer::kDirectAlignment - 1) / Writer::kDirectAlignment *
+           Writer::kDirectAlignment;
+}
+
+char* allocate(size_t size)
+{
+    auto buffer = static_cast<char*>(
+        std::aligned_alloc(Writer::kDirectAlignment, size));
+    if (buffer == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return buffer;
+}
+
+} // namespace
+
+void Writer::FreeDeleter::operator()(char* buffer) const
+{
+    std::free(buffer);
+}
+
+Writer::Writer(const std::filesystem::path& path, WriterOptions options)
+    : path_(path), capacity_(alignUp(std::max<size_t>(options.bufferSize, 1)))
+{
+    const int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+    if (options.direct)
+    {
+        fd_ = ::open(path_.c_str(), flags | O_DIRECT, 0644);
+        direct_ = fd_ >= 0;
+    }
+    if (fd_ < 0)
+    {
+        // no O_DIRECT on this file system, tmpfs for one
+        fd_ = ::open(path_.c_str(), flags, 0644);
+    }
+    if (fd_ < 0)
+    {
+        throw DatabaseException("Failed to open file for writing: " +
+                                path_.string());
+    }
+    buffer_.reset(allocate(capacity_));
+}
+
+Writer::~Writer()
+{
+    if (fd_ >= 0)
+    {
+        ::close(fd_);
+    }
+}
+
+void Writer::separate()
+{
+    if (rowStarted_)
+    {
+        *reserve(1) = ',';
+        ++used_;
+    }
+    rowStarted_ = true;
+}
+
+void Writer::field(std::string_view value)
+{
+    separate();
+    if (value.find_first_of(",\"") == std::string_view::npos)
+    {
+        raw(value);
+        return;
+    }
+    // worst case every byte is a quote
+    char* out = reserve(2 * value.size() + 2);
+    char* begin = out;
+    *out++ = '"';
+    for (char c : value)
+    {
+        if (c == '"')
+        {
+            *out++ = '"';
+        }
+        *out++ = c;
+    }
+    *out++ = '"';
+    used_ += static_cast<size_t>(out - begin);
+}
+
+void Writer::field(int32_t value)
+{
+    separate();
+    char* out = reserve(11);
+    used_ += static_cast<size_t>(std::to_chars(out, out + 11, value).ptr - out);
+}
+
+void Writer::field(bool value)
+{
+    separate();
+    raw(value ? "true" : "false");
+}
+
+void Writer::raw(std::string_view text)
+{
+    std::memcpy(reserve(text.size()), text.data(), text.size());
+    used_ += text.size();
+}
+
+void Writer::endRow()
+{
+    *reserve(1) = '\n';
+    ++used_;
+    rowStarted_ = false;
+}
+
+char* Writer::reserve(size_t size)
+{
+    if (capacity_ - used_ < size)
+    {
+        // O_DIRECT writes whole blocks only, the rest moves to the front
+        flush(direct_ ? used_ / kDirectAlignment * kDirectAlignment : used_);
+    }
+    if (capacity_ - used_ < size)
+    {
+        // a single value larger than the buffer
+        size_t capacity = alignUp(used_ + size);
+        std::unique_ptr<char, FreeDeleter> buffer(allocate(capacity));
+        std::memcpy(buffer.get(), buffer_.get(), used_);
+        buffer_ = std::move(buffer);
+        capacity_ = capacity;
+    }
+    return buffer_.get() + used_;
+}
+
+void Writer::flush(size_t size)
+{
+    writeAt(buffer_.get(), size, offset_);
+    offset_ += size;
+    used_ -= size;
+    std::memmove(buffer_.get(), buffer_.get() + size, used_);
+}
+
+void Writer::writeAt(const char* data, size_t size, uint64_t offset)
+{
+    while (size > 0)
+    {
+        auto written = ::pwrite(fd_, data, size, static_cast<off_t>(offset));
+        if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (written <= 0)
+        {
+            throw DatabaseException("Failed to write file " + path_.string() +
+                                    ": " + std::strerror(errno));
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+        offset += static_cast<uint64_t>(written);
+    }
+}
+
+void Writer::close()
+{
+    if (fd_ < 0)
+    {
+        return;
+    }
+    uint64_t end = offset_ + used_;
+    if (direct_ && used_ != 0)
+    {
+        // the tail goes out as a padded block and is cut off again
+        size_t padded = alignUp(used_);
+        std::memset(buffer_.get() + used_, 0, padded - used_);
+        writeAt(buffer_.get(), padded, offset_);
+        if (::ftruncate(fd_, static_cast<off_t>(end)) != 0)
+        {
+            throw DatabaseException("Failed to truncate file " +
+                                    path_.string());
+        }
+    }
+    else
+    {
+        writeAt(buffer_.get(), used_, offset_);
+    }
+    offset_ = end;
+    used_ = 0;
+
+    int fd = fd_;
+    fd_ = -1;
+    if (::close(fd) != 0)
+    {
+        throw DatabaseException("Failed to close file " + path_.string());
+    }
+}
+
+} // namespace csv
+
+} // namespace db
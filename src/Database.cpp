@@ -1,19 +1,170 @@
 #include "Database.hpp"
+#include "DataBaseException.hpp"
+#include "Filter.hpp"
+#include "Join.hpp"
 #include "Lexer.hpp"
 #include "Parser.hpp"
 #include "Table.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <map>
 #include <memory>
+#include <optional>
+#include <set>
+#include <utility>
 
 namespace db
 {
 
+namespace
+{
+
+// tables locked by the calling thread, and whether exclusively
+thread_local std::vector<std::pair<const Table*, bool>> heldLocks;
+
+auto findHeld(const Table& table)
+{
+    return std::ranges::find(heldLocks, &table,
+                             &std::pair<const Table*, bool>::first);
+}
+
+// insert, update or delete buffered by a transaction
+struct Change
+{
+    enum Kind
+    {
+        Insert,
+        Update,
+        Delete,
+    };
+
+    Kind kind;
+    Table::InsertType values{};
+    std::unique_ptr<filters::Filter> filter{};
+};
+
+// statements of the transaction open on the calling thread, by table
+using WriteSet = std::map<std::string, std::vector<Change>>;
+thread_local std::optional<WriteSet> transaction;
+
+void buffer(const Database& database, const std::string& tableName,
+            Change change)
+{
+    // unknown tables fail right away, everything else at commit
+    database.findTable(tableName);
+    (*transaction)[tableName].push_back(std::move(change));
+}
+
+} // namespace
+
+TableLock::TableLock(std::shared_ptr<Table> table, bool exclusive)
+    : table_(std::move(table)), exclusive_(exclusive)
+{
+    auto held = findHeld(*table_);
+    if (held != heldLocks.end())
+    {
+        if (exclusive && !held->second)
+        {
+            throw DatabaseException(
+                "Table is locked shared by this thread, it cannot be "
+                "locked exclusively");
+        }
+        return;
+    }
+    if (exclusive)
+    {
+        table_->mutex().lock();
+    }
+    else
+    {
+        table_->mutex().lock_shared();
+    }
+    heldLocks.emplace_back(table_.get(), exclusive);
+    owner_ = true;
+}
+
+TableLock::TableLock(TableLock&& other) noexcept
+    : table_(std::move(other.table_)),
+      exclusive_(other.exclusive_),
+      owner_(std::exchange(other.owner_, false))
+{
+}
+
+TableLock::~TableLock()
+{
+    if (!owner_)
+    {
+        return;
+    }
+    heldLocks.erase(findHeld(*table_));
+    if (exclusive_)
+    {
+        table_->mutex().unlock();
+    }
+    else
+    {
+        table_->mutex().unlock_shared();
+    }
+}
+
+bool TableLock::isHeld(const Table& table)
+{
+    return findHeld(table) != heldLocks.end();
+}
+
+std::shared_ptr<Table> Database::findTable(const std::string& name) const
+{
+    auto tables = tables_.load();
+    auto it = tables->find(name);
+    if (it == tables->end())
+    {
+        throw DatabaseException("Unknown table: " + name);
+    }
+    return it->second;
+}
+
+TableLock Database::lockShared(const std::string& name) const
+{
+    return TableLock(findTable(name), false);
+}
+
+TableLock Database::lockExclusive(const std::string& name) const
+{
+    return TableLock(findTable(name), true);
+}
+
+void Database::configure(Table& table) const
+{
+    table.setWorkerPool(workers_);
+    table.setSortOptions(sortOptions_);
+    table.setCommitGate(commitGate_);
+}
+
+void Database::updateCatalog(
+    const std::function<void(TablesContainer&)>& change)
+{
+    auto tables = std::make_shared<TablesContainer>(*tables_.load());
+    change(*tables);
+    tables_.store(std::move(tables));
+}
+
 void Database::createTable(std::string& name,
                            std::vector<Table::ColumnType> columns)
 {
 #ifdef DEBUG
     std::cout << "Creating table: " + name << std::endl;
 #endif
-    tables_[name] = std::make_unique<Table>(name, std::move(columns));
+    std::lock_guard lock(catalogMutex_);
+    if (log_)
+    {
+        log_->append({ wal::kCreateTable, name, columns });
+    }
+    auto table = std::make_shared<Table>(name, std::move(columns));
+    configure(*table);
+    table->setLog(log_);
+    updateCatalog([&](TablesContainer& tables) { tables[name] = table; });
 #ifdef DEBUG
     std::cout << "Successfully created table: " + name << std::endl;
 #endif
@@ -24,22 +175,156 @@ void Database::insert(std::string& tableName, Table::InsertType insertMap)
 #ifdef DEBUG
     std::cout << "Inserting data to table: " + tableName << std::endl;
 #endif
-    tables_[tableName]->insert(std::move(insertMap));
+    if (transaction)
+    {
+        buffer(*this, tableName, { Change::Insert, std::move(insertMap) });
+    }
+    else
+    {
+        lockShared(tableName)->insert(std::move(insertMap));
+    }
 #ifdef DEBUG
     std::cout << "Successfully inserted data to table: " + tableName << std::endl;
 #endif
 }
 
-std::unique_ptr<Table::View> Database::select(std::string& tableName, std::vector<std::string>& selectList, std::unique_ptr<filters::Filter> filter){
-    return tables_[tableName]->select(selectList, std::move(filter));
+std::unique_ptr<Table::View> Database::select(std::string& tableName, std::vector<std::string>& selectList, std::unique_ptr<filters::Filter> filter,
+                                              const std::vector<sort::SortKey>& orderBy, const Limit& limit,
+                                              const aggregate::Grouping& grouping){
+    auto table = lockShared(tableName);
+    if (grouping.empty())
+    {
+        return table->select(selectList, std::move(filter), orderBy, limit);
+    }
+    auto result = table->aggregate(selectList, grouping, std::move(filter));
+    if (!orderBy.empty())
+    {
+        join::orderBy(*result, orderBy);
+    }
+    limit.apply(result->recordPtrs);
+    return result;
+}
+
+std::unique_ptr<Table::Cursor> Database::openCursor(std::string& tableName, std::vector<std::string>& selectList, std::unique_ptr<filters::Filter> filter){
+    return lockShared(tableName)->openCursor(selectList, std::move(filter));
 }
 
 void Database::update(std::string& tableName, std::unique_ptr<filters::Filter> filter, Table::InsertType newValues){
-    tables_[tableName]->update(std::move(filter), std::move(newValues));
+    if (transaction)
+    {
+        buffer(*this, tableName,
+               { Change::Update, std::move(newValues), std::move(filter) });
+        return;
+    }
+    lockShared(tableName)->update(std::move(filter), std::move(newValues));
 }
 
 void Database::del(std::string& tableName, std::unique_ptr<filters::Filter> filter){
-    tables_[tableName]->del(std::move(filter));
+    if (transaction)
+    {
+        buffer(*this, tableName, { Change::Delete, {}, std::move(filter) });
+        return;
+    }
+    lockShared(tableName)->del(std::move(filter));
+}
+
+std::unique_ptr<Table::View> Database::join(std::string& tableName, std::vector<join::JoinSpec>& joins, std::vector<std::string>& selectList, std::unique_ptr<filters::Filter> filter,
+                                            const std::vector<sort::SortKey>& orderBy, const Limit& limit){
+    // every table stays locked until the result is materialized, locks are
+    // taken in name order so joins never wait on each other in a cycle
+    std::map<std::string, TableLock> tables;
+    std::set<std::string> names{ tableName };
+    for (auto&& spec : joins)
+    {
+        names.insert(spec.tableName);
+    }
+    for (auto&& name : names)
+    {
+        tables.emplace(name, lockShared(name));
+    }
+
+    // WHERE conditions are pushed down to the table they read
+    std::vector<std::pair<std::string, const Table*>> inputs{
+        { tableName, &*tables.at(tableName) }
+    };
+    for (auto&& spec : joins)
+    {
+        inputs.emplace_back(spec.tableName, &*tables.at(spec.tableName));
+    }
+    auto filters = join::splitFilter(std::move(filter), inputs);
+    auto tableFilter = [&](const std::string& name) {
+        auto it = filters.find(name);
+        return it == filters.end() ? nullptr : std::move(it->second);
+    };
+
+    std::vector<std::string> allColumns{};
+    auto result = tables.at(tableName)->select(allColumns, tableFilter(tableName));
+    join::qualify(*result);
+    for (auto&& spec : joins)
+    {
+        auto right = tables.at(spec.tableName)->select(allColumns, tableFilter(spec.tableName));
+        join::qualify(*right);
+        auto [leftKey, rightKey] = join::resolveKeys(*result, *right, spec);
+        result = join::hashJoin(*result, leftKey, *right, rightKey);
+    }
+    if (!orderBy.empty())
+    {
+        join::orderBy(*result, orderBy);
+    }
+    limit.apply(result->recordPtrs);
+    join::project(*result, selectList);
+    return result;
+}
+
+void Database::createIndex(std::string& tableName, std::string& columnName)
+{
+#ifdef DEBUG
+    std::cout << "Creating index on: " + tableName + "." + columnName
+              << std::endl;
+#endif
+    // the catalog lock keeps a checkpoint from switching logs in between
+    std::lock_guard lock(catalogMutex_);
+    lockExclusive(tableName)->createIndex(columnName);
+    if (log_)
+    {
+        log_->append({ .kind = wal::kCreateIndex, .table = tableName,
+                       .column = columnName });
+    }
+}
+
+void Database::dropIndex(std::string& tableName, std::string& columnName)
+{
+    std::lock_guard lock(catalogMutex_);
+    lockExclusive(tableName)->dropIndex(columnName);
+    if (log_)
+    {
+        log_->append({ .kind = wal::kDropIndex, .table = tableName,
+                       .column = columnName });
+    }
+}
+
+void Database::setParallelism(size_t threads)
+{
+    std::lock_guard lock(catalogMutex_);
+    // the calling thread scans too, so the pool holds one thread less
+    workers_ = threads > 1 ? std::make_shared<WorkerPool>(threads - 1)
+                           : nullptr;
+    auto tables = tables_.load();
+    for (auto&& [_, table] : *tables)
+    {
+        TableLock(table, true)->setWorkerPool(workers_);
+    }
+}
+
+void Database::setSortOptions(sort::SortOptions options)
+{
+    std::lock_guard lock(catalogMutex_);
+    sortOptions_ = std::move(options);
+    auto tables = tables_.load();
+    for (auto&& [_, table] : *tables)
+    {
+        TableLock(table, true)->setSortOptions(sortOptions_);
+    }
 }
 
 void Database::execute(std::string request)
@@ -50,25 +335,297 @@ void Database::execute(std::string request)
     command->execute();
 }
 
+void Database::begin()
+{
+    if (transaction)
+    {
+        throw DatabaseException("Begin: a transaction is already open");
+    }
+    transaction.emplace();
+}
+
+void Database::commit()
+{
+    if (!transaction)
+    {
+        throw DatabaseException("Commit: no transaction is open");
+    }
+    // the transaction ends here, applied or not
+    auto writeSet = std::move(*transaction);
+    transaction.reset();
+    if (writeSet.empty())
+    {
+        return;
+    }
+
+    // locked in name order like joins, the batches of the tables follow
+    // that order too
+    std::map<std::string, TableLock> tables;
+    for (auto&& [name, _] : writeSet)
+    {
+        tables.emplace(name, lockShared(name));
+    }
+    // the changes of all tables go in one log append
+    auto log = tables.begin()->second->getLog();
+    for (auto&& [name, table] : tables)
+    {
+        if (table->getLog() != log)
+        {
+            throw DatabaseException("Commit: " + name +
+                                    " is not logged with the other tables");
+        }
+    }
+    // destroyed before the locks, undoing whatever did not commit
+    std::map<std::string, Table::Batch> batches;
+    std::vector<wal::Entry> entries;
+    for (auto&& [name, changes] : writeSet)
+    {
+        auto&& table = *tables.at(name);
+        auto&& batch = batches.try_emplace(name, table).first->second;
+        for (auto&& change : changes)
+        {
+            switch (change.kind)
+            {
+            case Change::Insert:
+                batch.insert(std::move(change.values));
+                break;
+            case Change::Update:
+                batch.update(change.filter.get(), change.values);
+                break;
+            case Change::Delete:
+                batch.del(change.filter.get());
+                break;
+            }
+        }
+        auto logged = batch.releaseLog();
+        if (!logged.empty())
+        {
+            entries.insert(entries.end(), std::make_move_iterator(logged.begin()),
+                           std::make_move_iterator(logged.end()));
+        }
+    }
+    if (!entries.empty())
+    {
+        log->append(entries);
+    }
+    // snapshots taken meanwhile wait, then see every table committed
+    std::unique_lock gate(*commitGate_);
+    for (auto&& [_, batch] : batches)
+    {
+        batch.commit();
+    }
+}
+
+void Database::rollback()
+{
+    if (!transaction)
+    {
+        throw DatabaseException("Rollback: no transaction is open");
+    }
+    transaction.reset();
+}
+
+bool Database::inTransaction() const
+{
+    return transaction.has_value();
+}
+
 void Database::loadTableFromFile(std::string name,
                                  std::filesystem::path dataFilePath)
 {
-    tables_[name] = std::make_unique<Table>(name);
+    std::lock_guard lock(catalogMutex_);
+    auto table = std::make_shared<Table>(name);
+    configure(*table);
 #ifdef DEBUG
-    tables_[name]->deserializeCSV(dataFilePath);
+    table->deserializeCSV(dataFilePath);
 #else
-    tables_[name]->deserialize(dataFilePath);
+    table->deserialize(dataFilePath);
 #endif
+    updateCatalog([&](TablesContainer& tables) { tables[name] = table; });
+}
+
+void Database::mapTableFromFile(std::string name,
+                                std::filesystem::path dataFilePath)
+{
+    std::lock_guard lock(catalogMutex_);
+    auto table = std::make_shared<Table>(name);
+    configure(*table);
+    table->map(dataFilePath);
+    updateCatalog([&](TablesContainer& tables) { tables[name] = table; });
 }
 
 void Database::storeTableInFile(std::string name,
                                 std::filesystem::path dataFilePath)
 {
+    auto table = lockShared(name);
 #ifdef DEBUG
-    tables_[name]->serializeCSV(dataFilePath);
+    table->serializeCSV(dataFilePath);
 #else
-    tables_[name]->serialize(dataFilePath);
+    table->serialize(dataFilePath);
 #endif
 }
 
+namespace
+{
+
+// names the current checkpoint, replaced atomically by rename()
+constexpr const char* kManifest = "CHECKPOINT";
+
+} // namespace
+
+std::filesystem::path Database::checkpointPath(uint64_t epoch) const
+{
+    return directory_ / ("checkpoint-" + std::to_string(epoch));
+}
+
+std::filesystem::path Database::logPath(uint64_t epoch) const
+{
+    return directory_ / ("wal-" + std::to_string(epoch) + ".log");
+}
+
+void Database::attachLog(std::shared_ptr<wal::Log> log)
+{
+    log_ = std::move(log);
+    auto tables = tables_.load();
+    for (auto&& [_, table] : *tables)
+    {
+        TableLock(table, true)->setLog(log_);
+    }
+}
+
+void Database::open(std::filesystem::path directory, wal::Options options)
+{
+    std::lock_guard lock(catalogMutex_);
+    attachLog(nullptr);
+    std::filesystem::create_directories(directory);
+    directory_ = std::move(directory);
+    logOptions_ = options;
+
+    epoch_ = 0;
+    if (std::ifstream manifest{ directory_ / kManifest })
+    {
+        if (!(manifest >> epoch_))
+        {
+            throw DatabaseException("Corrupt checkpoint manifest in " +
+                                    directory_.string());
+        }
+    }
+
+    // recovered into a catalog of its own, published once complete
+    TablesContainer tables;
+    if (std::filesystem::is_directory(checkpointPath(epoch_)))
+    {
+        for (auto&& file :
+             std::filesystem::directory_iterator(checkpointPath(epoch_)))
+        {
+            auto name = file.path().stem().string();
+            auto table = std::make_shared<Table>(name);
+            configure(*table);
+            table->deserialize(file.path());
+            tables[name] = std::move(table);
+        }
+    }
+
+    auto path = logPath(epoch_);
+    auto valid = wal::replay(
+        path,
+        [&](const wal::Entry& entry)
+        {
+            if (entry.kind == wal::kCreateTable)
+            {
+                auto table = std::make_shared<Table>(entry.table,
+                                                     entry.columns);
+                configure(*table);
+                tables[entry.table] = std::move(table);
+                return;
+            }
+            auto table = tables.find(entry.table);
+            if (table == tables.end())
+            {
+                throw DatabaseException("Replay: unknown table " +
+                                        entry.table);
+            }
+            if (entry.kind == wal::kCreateIndex)
+            {
+                table->second->createIndex(entry.column);
+            }
+            else if (entry.kind == wal::kDropIndex)
+            {
+                table->second->dropIndex(entry.column);
+            }
+            else
+            {
+                table->second->replay(entry);
+            }
+        });
+    // drop a torn tail, entries appended after it would never be replayed
+    if (std::filesystem::exists(path) &&
+        std::filesystem::file_size(path) != valid)
+    {
+        std::filesystem::resize_file(path, valid);
+    }
+
+    tables_.store(
+        std::make_shared<const TablesContainer>(std::move(tables)));
+    attachLog(std::make_shared<wal::Log>(path, logOptions_));
+}
+
+void Database::checkpoint()
+{
+    std::lock_guard lock(catalogMutex_);
+    if (!log_)
+    {
+        throw DatabaseException("Checkpoint: no log is open");
+    }
+
+    // writers stay out until the new log is attached, tables are locked in
+    // name order like joins lock them
+    auto catalog = tables_.load();
+    std::map<std::string, TableLock> tables;
+    for (auto&& [name, table] : *catalog)
+    {
+        tables.emplace(name, TableLock(table, true));
+    }
+
+    uint64_t next = epoch_ + 1;
+    auto snapshot = checkpointPath(next);
+    std::filesystem::remove_all(snapshot);
+    std::filesystem::create_directory(snapshot);
+    for (auto&& [name, table] : tables)
+    {
+        auto path = snapshot / (name + ".tbl");
+        table->serialize(path);
+        wal::syncPath(path);
+    }
+    wal::syncPath(snapshot);
+
+    std::filesystem::remove(logPath(next));
+    auto log = std::make_shared<wal::Log>(logPath(next), logOptions_);
+
+    auto manifest = directory_ / (std::string(kManifest) + ".tmp");
+    {
+        std::ofstream file(manifest, std::ios::trunc);
+        file << next << '\n';
+        if (!file.flush())
+        {
+            throw DatabaseException("Failed to write " + manifest.string());
+        }
+    }
+    wal::syncPath(manifest);
+    std::filesystem::rename(manifest, directory_ / kManifest);
+    wal::syncPath(directory_);
+
+    attachLog(std::move(log));
+    std::filesystem::remove_all(checkpointPath(epoch_));
+    std::filesystem::remove(logPath(epoch_));
+    epoch_ = next;
+}
+
+void Database::close()
+{
+    std::lock_guard lock(catalogMutex_);
+    attachLog(nullptr);
+    directory_.clear();
+}
+
 } // namespace db
@@ -2,39 +2,345 @@
 
 #include "DataBaseException.hpp"
 #include "Lexer.hpp"
+#include "Table.hpp"
+
+#include <cstdint>
+#include <limits>
+#include <variant>
 
 namespace db {
 
 namespace expression {
 
+namespace {
+
+columns::ColumType valueType(columns::ColumType type) {
+  return type == columns::ColumType::Id ? columns::ColumType::Integer : type;
+}
+
+// Position of the type in Context::Value, values of different types order
+// by it like std::variant does
+int typeOrder(columns::ColumType type) {
+  switch (type) {
+    case columns::ColumType::Bool:
+      return 0;
+    case columns::ColumType::Integer:
+    case columns::ColumType::Id:
+      return 1;
+    case columns::ColumType::String:
+      return 2;
+    case columns::ColumType::Bytes:
+      return 3;
+    default:
+      throw DatabaseException("Expression: value of unknown type");
+  }
+}
+
+int threeWay(int cmp) { return cmp < 0 ? -1 : (cmp > 0 ? 1 : 0); }
+
+bool isArithmetic(lexer::TokenType type) {
+  return type == lexer::TOK_PLUS || type == lexer::TOK_MINUS ||
+         type == lexer::TOK_MULTIPLY || type == lexer::TOK_DIVIDE ||
+         type == lexer::TOK_MODULO;
+}
+
+bool isRelational(lexer::TokenType type) {
+  return type == lexer::TOK_EQUAL || type == lexer::TOK_NOT_EQUAL ||
+         type == lexer::TOK_LESS || type == lexer::TOK_LESS_EQUAL ||
+         type == lexer::TOK_GREATER || type == lexer::TOK_GREATER_EQUAL;
+}
+
+bool applyRelational(lexer::TokenType type, int cmp) {
+  switch (type) {
+    case lexer::TOK_EQUAL:
+      return cmp == 0;
+    case lexer::TOK_NOT_EQUAL:
+      return cmp != 0;
+    case lexer::TOK_LESS:
+      return cmp < 0;
+    case lexer::TOK_LESS_EQUAL:
+      return cmp <= 0;
+    case lexer::TOK_GREATER:
+      return cmp > 0;
+    case lexer::TOK_GREATER_EQUAL:
+      return cmp >= 0;
+    default:
+      throw DatabaseException("Unsupported operator in evaluation");
+  }
+}
+
+// int32 arithmetic is done in int64_t, results that do not fit throw
+int narrow(int64_t value) {
+  if (value < std::numeric_limits<int>::min() ||
+      value > std::numeric_limits<int>::max()) {
+    throw DatabaseException("Expression: integer overflow");
+  }
+  return static_cast<int>(value);
+}
+
+int applyArithmetic(lexer::TokenType type, int left, int right) {
+  switch (type) {
+    case lexer::TOK_PLUS:
+      return narrow(int64_t{left} + right);
+    case lexer::TOK_MINUS:
+      return narrow(int64_t{left} - right);
+    case lexer::TOK_MULTIPLY:
+      return narrow(int64_t{left} * right);
+    case lexer::TOK_DIVIDE:
+      if (right == 0) {
+        throw DatabaseException("Expression: division by zero");
+      }
+      return narrow(int64_t{left} / right);
+    case lexer::TOK_MODULO:
+      if (right == 0) {
+        throw DatabaseException("Expression: division by zero");
+      }
+      // traps in int like INT_MIN / -1 does
+      if (left == std::numeric_limits<int>::min() && right == -1) {
+        throw DatabaseException("Expression: integer overflow");
+      }
+      return left % right;
+    default:
+      throw DatabaseException("Unsupported operator in evaluation");
+  }
+}
+
+const IdentifierExpression* bareWord(const Expression& expression) {
+  auto identifier = dynamic_cast<const IdentifierExpression*>(&expression);
+  return identifier && identifier->isBareWord() ? identifier : nullptr;
+}
+
+// operands of anything but a comparison are never bare words
+void checkOperand(const Expression& operand) {
+  if (auto word = bareWord(operand)) {
+    throw DatabaseException("Unknown column: " + word->name());
+  }
+}
+
+template <typename Op>
+void combine(std::vector<int>& out, const std::vector<int>& right, Op op) {
+  for (size_t i = 0; i < out.size(); ++i) {
+    out[i] = op(out[i], right[i]);
+  }
+}
+
+}  // namespace
+
 Context::Value Context::getValue(const std::string& name) const
 {
+    if (table_ && table_->hasColumn(name))
+    {
+        return table_->getStorage()
+            .column(table_->getColumnIndex(name))
+            .get(row_);
+    }
     return name;
 }
 
 Context::Value Context::getStringLength(const std::string& name) const
 {
-    return static_cast<int>(name.size());
+    auto value = getValue(name);
+    if (auto bytes = std::get_if<columns::Bytes::value_type>(&value))
+    {
+        return static_cast<int>(bytes->size());
+    }
+    if (auto string = std::get_if<columns::String::value_type>(&value))
+    {
+        return static_cast<int>(string->size());
+    }
+    throw DatabaseException("Expression: |" + name +
+                            "| requires a string or bytes column");
+}
+
+int Expression::evaluateInt(size_t) const {
+  throw DatabaseException("Expression: value is not an integer");
+}
+
+bool Expression::evaluateBool(size_t) const {
+  throw DatabaseException("Expression: value is not a boolean");
+}
+
+std::string_view Expression::evaluateBytes(size_t) const {
+  throw DatabaseException("Expression: value is not a string");
+}
+
+void Expression::evaluateInts(const std::vector<size_t>& rows,
+                              std::vector<int>& out) const {
+  out.resize(rows.size());
+  for (size_t i = 0; i < rows.size(); ++i) {
+    out[i] = evaluateInt(rows[i]);
+  }
+}
+
+void Expression::renameColumns(const Rename& rename) { (void)rename; }
+
+std::unique_ptr<Expression> fold(std::unique_ptr<Expression> expression) {
+  if (!expression->isConstant() ||
+      dynamic_cast<const ConstantExpression*>(expression.get())) {
+    return expression;
+  }
+  try {
+    return std::make_unique<ConstantExpression>(expression->evaluate({}));
+  } catch (const std::bad_variant_access&) {
+    throw DatabaseException("Expression: operand types do not match");
+  }
+}
+
+int compare(const Expression& left, const Expression& right, size_t row) {
+  auto type = valueType(left.type());
+  if (type != valueType(right.type())) {
+    return typeOrder(type) < typeOrder(right.type()) ? -1 : 1;
+  }
+  switch (type) {
+    case columns::ColumType::Integer: {
+      int l = left.evaluateInt(row);
+      int r = right.evaluateInt(row);
+      return l < r ? -1 : (r < l ? 1 : 0);
+    }
+    case columns::ColumType::Bool:
+      return static_cast<int>(left.evaluateBool(row)) -
+             static_cast<int>(right.evaluateBool(row));
+    default:
+      return threeWay(left.evaluateBytes(row).compare(right.evaluateBytes(row)));
+  }
 }
 
+void checkComparison(const Expression& left, const Expression& right) {
+  auto check = [](const Expression& operand, const Expression& other) {
+    auto word = bareWord(operand);
+    if (word && (valueType(other.type()) != columns::ColumType::String ||
+                 other.isConstant())) {
+      throw DatabaseException("Unknown column: " + word->name());
+    }
+  };
+  check(left, right);
+  check(right, left);
+}
+
+// IdentifierExpression
+
 Context::Value IdentifierExpression::evaluate(const Context& context) const {
-  (void) context;
-  return name_;
+  return context.getValue(name_);
+}
+
+void IdentifierExpression::bind(const Table& table) {
+  bound_ = true;
+  // anything but a column is a bare word, `login = gosha` compares with
+  // the string "gosha"
+  if (!table.hasColumn(name_)) {
+    column_.reset();
+    data_ = nullptr;
+    type_ = columns::ColumType::String;
+    return;
+  }
+  column_ = table.getColumnIndex(name_);
+  data_ = &table.getStorage().column(*column_);
+  type_ = valueType(data_->getColumnType());
+}
+
+columns::ColumType IdentifierExpression::type() const { return type_; }
+
+bool IdentifierExpression::isConstant() const { return bound_ && !column_; }
+
+int IdentifierExpression::evaluateInt(size_t row) const {
+  if (type_ != columns::ColumType::Integer) {
+    return Expression::evaluateInt(row);
+  }
+  return static_cast<const storage::IntegerData*>(data_)->at(row);
+}
+
+bool IdentifierExpression::evaluateBool(size_t row) const {
+  if (type_ != columns::ColumType::Bool) {
+    return Expression::evaluateBool(row);
+  }
+  return static_cast<const storage::BoolData*>(data_)->at(row);
+}
+
+std::string_view IdentifierExpression::evaluateBytes(size_t row) const {
+  if (!data_) {
+    return name_;
+  }
+  if (type_ != columns::ColumType::String &&
+      type_ != columns::ColumType::Bytes) {
+    return Expression::evaluateBytes(row);
+  }
+  return static_cast<const storage::VarlenData*>(data_)->at(row);
+}
+
+void IdentifierExpression::evaluateInts(const std::vector<size_t>& rows,
+                                        std::vector<int>& out) const {
+  if (type_ != columns::ColumType::Integer) {
+    return Expression::evaluateInts(rows, out);
+  }
+  auto&& values = static_cast<const storage::IntegerData*>(data_)->values();
+  out.resize(rows.size());
+  for (size_t i = 0; i < rows.size(); ++i) {
+    out[i] = values[rows[i]];
+  }
+}
+
+void IdentifierExpression::renameColumns(const Rename& rename) {
+  name_ = rename(name_);
 }
 
-Context::Value LiteralExpression::evaluate(const Context& context) const {
+// ConstantExpression
+
+Context::Value ConstantExpression::evaluate(const Context& context) const {
   (void)context;
-  if (token_.type == lexer::TOK_INT_LITERAL) {
-    return std::stoi(token_.lexeme);
-  } else if (token_.type == lexer::TOK_STRING_LITERAL) {
-    return token_.lexeme;
-  } else if (token_.type == lexer::TOK_TRUE) {
+  return value_;
+}
+
+void ConstantExpression::bind(const Table& table) { (void)table; }
+
+columns::ColumType ConstantExpression::type() const {
+  return columns::BaseColumn::getValueColumnType(value_);
+}
+
+bool ConstantExpression::isConstant() const { return true; }
+
+int ConstantExpression::evaluateInt(size_t row) const {
+  if (auto value = std::get_if<columns::Integer::value_type>(&value_)) {
+    return *value;
+  }
+  return Expression::evaluateInt(row);
+}
+
+bool ConstantExpression::evaluateBool(size_t row) const {
+  if (auto value = std::get_if<columns::Bool::value_type>(&value_)) {
+    return *value;
+  }
+  return Expression::evaluateBool(row);
+}
+
+std::string_view ConstantExpression::evaluateBytes(size_t row) const {
+  if (auto value = std::get_if<columns::String::value_type>(&value_)) {
+    return *value;
+  }
+  if (auto value = std::get_if<columns::Bytes::value_type>(&value_)) {
+    return {reinterpret_cast<const char*>(value->data()), value->size()};
+  }
+  return Expression::evaluateBytes(row);
+}
+
+void ConstantExpression::evaluateInts(const std::vector<size_t>& rows,
+                                      std::vector<int>& out) const {
+  out.assign(rows.size(), evaluateInt(0));
+}
+
+// LiteralExpression
+
+Context::Value LiteralExpression::parse(const lexer::Token& token) {
+  if (token.type == lexer::TOK_INT_LITERAL) {
+    return std::stoi(token.lexeme);
+  } else if (token.type == lexer::TOK_STRING_LITERAL) {
+    return token.lexeme;
+  } else if (token.type == lexer::TOK_TRUE) {
     return true;
-  } else if (token_.type == lexer::TOK_FALSE) {
+  } else if (token.type == lexer::TOK_FALSE) {
     return false;
-  } else if (token_.type == lexer::TOK_HEX_LITERAL) {
+  } else if (token.type == lexer::TOK_HEX_LITERAL) {
     columns::Bytes::value_type bytes;
-    for (auto&& num : token_.lexeme) {
+    for (auto&& num : token.lexeme) {
       if (std::isdigit(num)) {
         bytes.push_back(std::atoi(&num));
       } else {
@@ -46,27 +352,30 @@ Context::Value LiteralExpression::evaluate(const Context& context) const {
   throw DatabaseException("Expression: Unknown token type");
 }
 
+// BinaryExpression
+
 Context::Value BinaryExpression::evaluate(const Context& context) const {
   Context::Value leftValue = left_->evaluate(context);
   Context::Value rightValue = right_->evaluate(context);
 
   switch (op_.type) {
-    case lexer::TOK_PLUS:  
-      return std::get<columns::Integer::value_type>(leftValue) +
-             std::get<columns::Integer::value_type>(rightValue);
+    case lexer::TOK_PLUS:
     case lexer::TOK_MINUS:
-      return std::get<columns::Integer::value_type>(leftValue) -
-             std::get<columns::Integer::value_type>(rightValue);
     case lexer::TOK_MULTIPLY:
-      return std::get<columns::Integer::value_type>(leftValue) *
-             std::get<columns::Integer::value_type>(rightValue);
     case lexer::TOK_DIVIDE:
-      return std::get<columns::Integer::value_type>(leftValue) /
-             std::get<columns::Integer::value_type>(rightValue);
+    case lexer::TOK_MODULO:
+      return applyArithmetic(op_.type,
+                             std::get<columns::Integer::value_type>(leftValue),
+                             std::get<columns::Integer::value_type>(rightValue));
     case lexer::TOK_EQUAL:
-      return leftValue == rightValue;
     case lexer::TOK_NOT_EQUAL:
-      return leftValue != rightValue;
+    case lexer::TOK_LESS:
+    case lexer::TOK_LESS_EQUAL:
+    case lexer::TOK_GREATER:
+    case lexer::TOK_GREATER_EQUAL:
+      return applyRelational(op_.type, leftValue < rightValue
+                                           ? -1
+                                           : (rightValue < leftValue ? 1 : 0));
     case lexer::TOK_AND:
       return std::get<columns::Bool::value_type>(leftValue) &&
              std::get<columns::Bool::value_type>(rightValue);
@@ -78,6 +387,103 @@ Context::Value BinaryExpression::evaluate(const Context& context) const {
   }
 }
 
+void BinaryExpression::bind(const Table& table) {
+  left_->bind(table);
+  right_->bind(table);
+  if (isRelational(op_.type)) {
+    checkComparison(*left_, *right_);
+  } else {
+    checkOperand(*left_);
+    checkOperand(*right_);
+  }
+
+  auto leftType = valueType(left_->type());
+  auto rightType = valueType(right_->type());
+  if (isArithmetic(op_.type)) {
+    if (leftType != columns::ColumType::Integer ||
+        rightType != columns::ColumType::Integer) {
+      throw DatabaseException("Expression: '" + op_.lexeme +
+                              "' requires integer operands");
+    }
+    type_ = columns::ColumType::Integer;
+  } else if (isRelational(op_.type)) {
+    type_ = columns::ColumType::Bool;
+  } else if (op_.type == lexer::TOK_AND || op_.type == lexer::TOK_OR) {
+    if (leftType != columns::ColumType::Bool ||
+        rightType != columns::ColumType::Bool) {
+      throw DatabaseException("Expression: '" + op_.lexeme +
+                              "' requires boolean operands");
+    }
+    type_ = columns::ColumType::Bool;
+  } else {
+    throw DatabaseException("Unsupported operator in evaluation");
+  }
+}
+
+columns::ColumType BinaryExpression::type() const { return type_; }
+
+bool BinaryExpression::isConstant() const {
+  return left_->isConstant() && right_->isConstant();
+}
+
+int BinaryExpression::evaluateInt(size_t row) const {
+  if (type_ != columns::ColumType::Integer) {
+    return Expression::evaluateInt(row);
+  }
+  return applyArithmetic(op_.type, left_->evaluateInt(row),
+                         right_->evaluateInt(row));
+}
+
+bool BinaryExpression::evaluateBool(size_t row) const {
+  switch (op_.type) {
+    case lexer::TOK_AND:
+      return left_->evaluateBool(row) && right_->evaluateBool(row);
+    case lexer::TOK_OR:
+      return left_->evaluateBool(row) || right_->evaluateBool(row);
+    default:
+      if (!isRelational(op_.type)) {
+        return Expression::evaluateBool(row);
+      }
+      return applyRelational(op_.type, compare(*left_, *right_, row));
+  }
+}
+
+void BinaryExpression::evaluateInts(const std::vector<size_t>& rows,
+                                    std::vector<int>& out) const {
+  if (type_ != columns::ColumType::Integer) {
+    return Expression::evaluateInts(rows, out);
+  }
+  std::vector<int> right;
+  left_->evaluateInts(rows, out);
+  right_->evaluateInts(rows, right);
+
+  switch (op_.type) {
+    case lexer::TOK_PLUS:
+      combine(out, right,
+              [](int l, int r) { return narrow(int64_t{l} + r); });
+      break;
+    case lexer::TOK_MINUS:
+      combine(out, right,
+              [](int l, int r) { return narrow(int64_t{l} - r); });
+      break;
+    case lexer::TOK_MULTIPLY:
+      combine(out, right,
+              [](int l, int r) { return narrow(int64_t{l} * r); });
+      break;
+    default:
+      combine(out, right,
+              [&](int l, int r) { return applyArithmetic(op_.type, l, r); });
+      break;
+  }
+}
+
+void BinaryExpression::renameColumns(const Rename& rename) {
+  left_->renameColumns(rename);
+  right_->renameColumns(rename);
+}
+
+// UnaryExpression
+
 Context::Value UnaryExpression::evaluate(const Context& context) const {
   Context::Value operandValue = operand_->evaluate(context);
 
@@ -92,7 +498,7 @@ Context::Value UnaryExpression::evaluate(const Context& context) const {
     case lexer::TOK_MINUS:
       if (auto intValue =
               std::get_if<columns::Integer::value_type>(&operandValue)) {
-        return -(*intValue);
+        return narrow(-int64_t{*intValue});
       } else {
         throw DatabaseException(
             "Unary '-' operator requires a numeric operand");
@@ -102,10 +508,91 @@ Context::Value UnaryExpression::evaluate(const Context& context) const {
   }
 }
 
+void UnaryExpression::bind(const Table& table) {
+  operand_->bind(table);
+  checkOperand(*operand_);
+  if (op_.type == lexer::TOK_NOT &&
+      operand_->type() != columns::ColumType::Bool) {
+    throw DatabaseException("Operator '!' requires a boolean operand");
+  }
+  if (op_.type == lexer::TOK_MINUS &&
+      valueType(operand_->type()) != columns::ColumType::Integer) {
+    throw DatabaseException("Unary '-' operator requires a numeric operand");
+  }
+}
+
+columns::ColumType UnaryExpression::type() const {
+  return op_.type == lexer::TOK_NOT ? columns::ColumType::Bool
+                                    : columns::ColumType::Integer;
+}
+
+bool UnaryExpression::isConstant() const { return operand_->isConstant(); }
+
+int UnaryExpression::evaluateInt(size_t row) const {
+  if (op_.type != lexer::TOK_MINUS) {
+    return Expression::evaluateInt(row);
+  }
+  return narrow(-int64_t{operand_->evaluateInt(row)});
+}
+
+bool UnaryExpression::evaluateBool(size_t row) const {
+  if (op_.type != lexer::TOK_NOT) {
+    return Expression::evaluateBool(row);
+  }
+  return !operand_->evaluateBool(row);
+}
+
+void UnaryExpression::renameColumns(const Rename& rename) {
+  operand_->renameColumns(rename);
+}
+
+// StringLengthExpression
+
 Context::Value StringLengthExpression::evaluate(const Context& context) const {
   return context.getStringLength(name_);
 }
 
+void StringLengthExpression::bind(const Table& table) {
+  bound_ = true;
+  data_ = nullptr;
+  if (!table.hasColumn(name_)) {
+    throw DatabaseException("Unknown column: " + name_);
+  }
+  auto&& data = table.getStorage().column(table.getColumnIndex(name_));
+  if (data.getColumnType() != columns::ColumType::String &&
+      data.getColumnType() != columns::ColumType::Bytes) {
+    throw DatabaseException("Expression: |" + name_ +
+                            "| requires a string or bytes column");
+  }
+  data_ = static_cast<const storage::VarlenData*>(&data);
+}
+
+columns::ColumType StringLengthExpression::type() const {
+  return columns::ColumType::Integer;
+}
+
+bool StringLengthExpression::isConstant() const { return bound_ && !data_; }
+
+int StringLengthExpression::evaluateInt(size_t row) const {
+  return static_cast<int>(data_ ? data_->at(row).size() : name_.size());
+}
+
+void StringLengthExpression::evaluateInts(const std::vector<size_t>& rows,
+                                          std::vector<int>& out) const {
+  if (!data_) {
+    out.assign(rows.size(), static_cast<int>(name_.size()));
+    return;
+  }
+  out.resize(rows.size());
+  for (size_t i = 0; i < rows.size(); ++i) {
+    out[i] = static_cast<int>(data_->at(rows[i]).size());
+  }
+}
+
+void StringLengthExpression::renameColumns(const Rename& rename) {
+  name_ = rename(name_);
+}
+
 }  // namespace expression
 
-}  // namespace db
\ No newline at end of file
+}  // namespace db
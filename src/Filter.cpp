@@ -1,5 +1,13 @@
 #include "Filter.hpp"
 #include "DataBaseException.hpp"
+#include "Simd.hpp"
+#include "Storage.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <functional>
+#include <iterator>
+#include <string_view>
 
 namespace db
 {
@@ -7,45 +15,844 @@ namespace db
 namespace filters
 {
 
-bool ComparisonFilter::matches(const Table::Record& record, Table& table) const
+namespace
+{
+
+// Keeps the rows satisfying `pred`, branch free
+template <typename Pred>
+void refine(Selection& selection, Pred pred)
+{
+    size_t out = 0;
+    for (size_t row : selection)
+    {
+        selection[out] = row;
+        out += pred(row) ? 1 : 0;
+    }
+    selection.resize(out);
+}
+
+template <typename Get, typename T>
+void compareKernel(Selection& selection, ComparisonFilter::Operator op,
+                   Get get, const T& value)
+{
+    switch (op)
+    {
+    case ComparisonFilter::EQUAL:
+        refine(selection, [&](size_t row) { return get(row) == value; });
+        break;
+    case ComparisonFilter::NOT_EQUAL:
+        refine(selection, [&](size_t row) { return get(row) != value; });
+        break;
+    case ComparisonFilter::LESS_THAN:
+        refine(selection, [&](size_t row) { return get(row) < value; });
+        break;
+    case ComparisonFilter::LESS_THAN_OR_EQUAL:
+        refine(selection, [&](size_t row) { return get(row) <= value; });
+        break;
+    case ComparisonFilter::GREATER_THAN:
+        refine(selection, [&](size_t row) { return get(row) > value; });
+        break;
+    case ComparisonFilter::GREATER_THAN_OR_EQUAL:
+        refine(selection, [&](size_t row) { return get(row) >= value; });
+        break;
+    default:
+        throw DatabaseException("Unknown comparison operator");
+    }
+}
+
+bool applyOperator(ComparisonFilter::Operator op, int cmp)
+{
+    switch (op)
+    {
+    case ComparisonFilter::EQUAL:
+        return cmp == 0;
+    case ComparisonFilter::NOT_EQUAL:
+        return cmp != 0;
+    case ComparisonFilter::LESS_THAN:
+        return cmp < 0;
+    case ComparisonFilter::LESS_THAN_OR_EQUAL:
+        return cmp <= 0;
+    case ComparisonFilter::GREATER_THAN:
+        return cmp > 0;
+    case ComparisonFilter::GREATER_THAN_OR_EQUAL:
+        return cmp >= 0;
+    default:
+        throw DatabaseException("Unknown comparison operator");
+    }
+}
+
+// `b op a` for `a op b`
+ComparisonFilter::Operator mirror(ComparisonFilter::Operator op)
+{
+    switch (op)
+    {
+    case ComparisonFilter::LESS_THAN:
+        return ComparisonFilter::GREATER_THAN;
+    case ComparisonFilter::LESS_THAN_OR_EQUAL:
+        return ComparisonFilter::GREATER_THAN_OR_EQUAL;
+    case ComparisonFilter::GREATER_THAN:
+        return ComparisonFilter::LESS_THAN;
+    case ComparisonFilter::GREATER_THAN_OR_EQUAL:
+        return ComparisonFilter::LESS_THAN_OR_EQUAL;
+    default:
+        return op;
+    }
+}
+
+simd::CompareOp toSimdOp(ComparisonFilter::Operator op)
+{
+    switch (op)
+    {
+    case ComparisonFilter::EQUAL:
+        return simd::CompareOp::Equal;
+    case ComparisonFilter::NOT_EQUAL:
+        return simd::CompareOp::NotEqual;
+    case ComparisonFilter::LESS_THAN:
+        return simd::CompareOp::Less;
+    case ComparisonFilter::LESS_THAN_OR_EQUAL:
+        return simd::CompareOp::LessEqual;
+    case ComparisonFilter::GREATER_THAN:
+        return simd::CompareOp::Greater;
+    case ComparisonFilter::GREATER_THAN_OR_EQUAL:
+        return simd::CompareOp::GreaterEqual;
+    default:
+        throw DatabaseException("Unknown comparison operator");
+    }
+}
+
+// A selection without holes, e.g. a fresh block of a full scan
+bool isDense(const Selection& selection)
+{
+    return !selection.empty() &&
+           selection.back() - selection.front() + 1 == selection.size();
+}
+
+// Runs a bitmask kernel over a dense selection and keeps the set bits.
+// `kernel(first, count, mask)` fills the mask for rows [first, first+count).
+template <typename Kernel>
+void refineDense(Selection& selection, Kernel kernel)
+{
+    const size_t first = selection.front();
+    const size_t count = selection.size();
+    uint64_t mask[simd::maskWords(kBatchSize)];
+
+    selection.clear();
+    for (size_t begin = 0; begin < count; begin += kBatchSize)
+    {
+        size_t n = std::min(kBatchSize, count - begin);
+        kernel(first + begin, n, mask);
+        for (size_t word = 0; word < simd::maskWords(n); ++word)
+        {
+            for (uint64_t bits = mask[word]; bits; bits &= bits - 1)
+            {
+                selection.push_back(first + begin + word * 64 +
+                                    std::countr_zero(bits));
+            }
+        }
+    }
+}
+
+void compareInts(Selection& selection, const storage::IntegerData& data,
+                 ComparisonFilter::Operator op,
+                 columns::Integer::value_type value)
+{
+    auto values = data.values().data();
+    if (isDense(selection))
+    {
+        refineDense(selection,
+                    [&](size_t first, size_t count, uint64_t* mask)
+                    {
+                        simd::compareInt32(values + first, count,
+                                           toSimdOp(op), value, mask);
+                    });
+        return;
+    }
+    compareKernel(
+        selection, op, [values](size_t row) { return values[row]; }, value);
+}
+
+void compareBools(Selection& selection, const storage::BoolData& data,
+                  ComparisonFilter::Operator op, bool value)
+{
+    if (isDense(selection) && selection.front() % 64 == 0)
+    {
+        refineDense(selection,
+                    [&](size_t first, size_t count, uint64_t* mask)
+                    {
+                        simd::compareBool(data.words().data() + first / 64,
+                                          count, toSimdOp(op), value, mask);
+                    });
+        return;
+    }
+    compareKernel(
+        selection, op, [&data](size_t row) { return data.at(row); }, value);
+}
+
+void compareVarlen(Selection& selection, const storage::VarlenData& data,
+                   ComparisonFilter::Operator op, std::string_view value)
+{
+    compareKernel(
+        selection, op, [&data](size_t row) { return data.at(row); }, value);
+}
+
+// String and Bytes values as raw bytes
+std::string_view bytesOf(const columns::BaseColumn::value_type& value)
+{
+    if (auto string = std::get_if<columns::String::value_type>(&value))
+    {
+        return *string;
+    }
+    auto&& bytes = std::get<columns::Bytes::value_type>(value);
+    return { reinterpret_cast<const char*>(bytes.data()), bytes.size() };
+}
+
+// Rows of `from` missing in `removed`, `out` may be `from` itself
+void difference(const Selection& from, const Selection& removed,
+                Selection& out)
+{
+    if (&out != &from)
+    {
+        out = from;
+    }
+    auto it = removed.begin();
+    refine(out,
+           [&](size_t row)
+           {
+               while (it != removed.end() && *it < row)
+               {
+                   ++it;
+               }
+               return it == removed.end() || *it != row;
+           });
+}
+
+} // namespace
+
+void Filter::filterBatch(Selection& selection, Table& table) const
+{
+    refine(selection, [&](size_t row) { return matches(row, table); });
+}
+
+void ComparisonFilter::bind(const Table& table)
+{
+    column_ = table.getColumnIndex(fieldName_);
+    auto columnType = table.getStorage().column(*column_).getColumnType();
+    if (columnType == columns::ColumType::Id)
+    {
+        columnType = columns::ColumType::Integer;
+    }
+    sameType_ = columnType == columns::BaseColumn::getValueColumnType(value_);
+}
+
+void ComparisonFilter::renameColumns(const expression::Rename& rename)
+{
+    fieldName_ = rename(fieldName_);
+}
+
+size_t ComparisonFilter::column() const
+{
+    if (!column_)
+    {
+        throw DatabaseException("Filter on " + fieldName_ +
+                                " is not bound to a table");
+    }
+    return *column_;
+}
+
+bool ComparisonFilter::matches(size_t row, Table& table) const
+{
+    int cmp = table.getStorage().column(column()).compare(row, value_);
+
+    return applyOperator(op_, cmp);
+}
+
+void ComparisonFilter::filterBatch(Selection& selection, Table& table) const
+{
+    auto&& data = table.getStorage().column(column());
+
+    if (selection.empty())
+    {
+        return;
+    }
+    // a type mismatch orders the same way for every row
+    if (!sameType_)
+    {
+        if (!applyOperator(op_, data.compare(selection.front(), value_)))
+        {
+            selection.clear();
+        }
+        return;
+    }
+
+    switch (data.getColumnType())
+    {
+    case columns::ColumType::Integer:
+    case columns::ColumType::Id:
+        compareInts(selection, static_cast<const storage::IntegerData&>(data),
+                    op_, std::get<columns::Integer::value_type>(value_));
+        break;
+    case columns::ColumType::Bool:
+        compareBools(selection, static_cast<const storage::BoolData&>(data),
+                     op_, std::get<columns::Bool::value_type>(value_));
+        break;
+    case columns::ColumType::String:
+    case columns::ColumType::Bytes:
+        compareVarlen(selection, static_cast<const storage::VarlenData&>(data),
+                      op_, bytesOf(value_));
+        break;
+    default:
+        Filter::filterBatch(selection, table);
+        break;
+    }
+}
+
+ExpressionFilter::ExpressionFilter(
+    std::unique_ptr<expression::Expression> condition)
+    : op_(ComparisonFilter::EQUAL), left_(std::move(condition)),
+      right_(std::make_unique<expression::ConstantExpression>(true)),
+      condition_(true)
+{
+}
+
+void ExpressionFilter::renameColumns(const expression::Rename& rename)
+{
+    left_->renameColumns(rename);
+    right_->renameColumns(rename);
+}
+
+void ExpressionFilter::bind(const Table& table)
+{
+    left_->bind(table);
+    right_->bind(table);
+    expression::checkComparison(*left_, *right_);
+    if (condition_ && left_->type() != columns::ColumType::Bool)
+    {
+        throw DatabaseException("WHERE condition is not boolean");
+    }
+    lowered_.reset();
+    constant_.reset();
+
+    auto column = [](const expression::Expression& e)
+    {
+        auto identifier =
+            dynamic_cast<const expression::IdentifierExpression*>(&e);
+        return identifier && identifier->column() ? identifier : nullptr;
+    };
+    if (auto identifier = column(*left_); identifier && right_->isConstant())
+    {
+        lowered_.emplace(identifier->name(), op_, right_->evaluate({}));
+    }
+    else if (auto identifier = column(*right_);
+             identifier && left_->isConstant())
+    {
+        lowered_.emplace(identifier->name(), mirror(op_),
+                         left_->evaluate({}));
+    }
+    if (lowered_)
+    {
+        lowered_->bind(table);
+        return;
+    }
+
+    type_ = left_->type() == columns::ColumType::Id ? columns::ColumType::Integer
+                                                    : left_->type();
+    auto rightType = right_->type() == columns::ColumType::Id
+                         ? columns::ColumType::Integer
+                         : right_->type();
+    if (type_ != rightType)
+    {
+        // the same for every row, expression::compare knows the order
+        constant_ = applyOperator(op_, expression::compare(*left_, *right_, 0));
+    }
+}
+
+bool ExpressionFilter::matches(size_t row, Table& table) const
+{
+    if (lowered_)
+    {
+        return lowered_->matches(row, table);
+    }
+    if (constant_)
+    {
+        return *constant_;
+    }
+    return applyOperator(op_, expression::compare(*left_, *right_, row));
+}
+
+void ExpressionFilter::filterBatch(Selection& selection, Table& table) const
+{
+    if (lowered_)
+    {
+        lowered_->filterBatch(selection, table);
+        return;
+    }
+    filterRows(selection);
+}
+
+void ExpressionFilter::filterRows(Selection& selection) const
 {
-    columns::BaseColumn::value_type recordValue =
-        record.rows[table.getRecordMapping()[fieldName_]].rowData;
+    if (constant_)
+    {
+        if (!*constant_)
+        {
+            selection.clear();
+        }
+        return;
+    }
+    if (selection.empty())
+    {
+        return;
+    }
+    if (type_ != columns::ColumType::Integer)
+    {
+        refine(selection,
+               [&](size_t row) {
+                   return applyOperator(
+                       op_, expression::compare(*left_, *right_, row));
+               });
+        return;
+    }
 
+    // both sides evaluated for the whole batch first
+    std::vector<int> left, right;
+    left_->evaluateInts(selection, left);
+    right_->evaluateInts(selection, right);
+    auto keep = [&](auto cmp)
+    {
+        size_t out = 0;
+        for (size_t i = 0; i < selection.size(); ++i)
+        {
+            selection[out] = selection[i];
+            out += cmp(left[i], right[i]) ? 1 : 0;
+        }
+        selection.resize(out);
+    };
     switch (op_)
     {
-    case EQUAL:
-        return recordValue == value_;
-    case NOT_EQUAL:
-        return recordValue != value_;
-    case LESS_THAN:
-        return recordValue < value_;
-    case LESS_THAN_OR_EQUAL:
-        return recordValue <= value_;
-    case GREATER_THAN:
-        return recordValue > value_;
-    case GREATER_THAN_OR_EQUAL:
-        return recordValue >= value_;
+    case ComparisonFilter::EQUAL:
+        keep(std::equal_to<>{});
+        break;
+    case ComparisonFilter::NOT_EQUAL:
+        keep(std::not_equal_to<>{});
+        break;
+    case ComparisonFilter::LESS_THAN:
+        keep(std::less<>{});
+        break;
+    case ComparisonFilter::LESS_THAN_OR_EQUAL:
+        keep(std::less_equal<>{});
+        break;
+    case ComparisonFilter::GREATER_THAN:
+        keep(std::greater<>{});
+        break;
+    case ComparisonFilter::GREATER_THAN_OR_EQUAL:
+        keep(std::greater_equal<>{});
+        break;
     default:
         throw DatabaseException("Unknown comparison operator");
     }
 }
 
-bool LogicalFilter::matches(const Table::Record& record, Table& table) const {
-    bool leftResult = left_->matches(record, table);
-    bool rightResult = right_->matches(record, table);
+void LogicalFilter::bind(const Table& table) {
+    left_->bind(table);
+    right_->bind(table);
+}
+
+void LogicalFilter::renameColumns(const expression::Rename& rename) {
+    left_->renameColumns(rename);
+    right_->renameColumns(rename);
+}
 
+bool LogicalFilter::matches(size_t row, Table& table) const {
     if (op_ == AND) {
-        return leftResult && rightResult;
+        return left_->matches(row, table) && right_->matches(row, table);
     } else if (op_ == OR) {
-        return leftResult || rightResult;
+        return left_->matches(row, table) || right_->matches(row, table);
     } else {
         throw DatabaseException("Unknown logical operator");
     }
 }
 
-bool NotFilter::matches(const Table::Record& record, Table& table) const {
-    return !operand_->matches(record, table);
+void LogicalFilter::filterBatch(Selection& selection, Table& table) const {
+    if (op_ == AND) {
+        // the right side only sees rows the left side accepted
+        left_->filterBatch(selection, table);
+        if (!selection.empty()) {
+            right_->filterBatch(selection, table);
+        }
+    } else if (op_ == OR) {
+        // the right side only sees rows the left side rejected
+        Selection accepted = selection;
+        left_->filterBatch(accepted, table);
+        Selection undecided;
+        difference(selection, accepted, undecided);
+        if (!undecided.empty()) {
+            right_->filterBatch(undecided, table);
+        }
+        selection.clear();
+        std::merge(accepted.begin(), accepted.end(), undecided.begin(),
+                   undecided.end(), std::back_inserter(selection));
+    } else {
+        throw DatabaseException("Unknown logical operator");
+    }
+}
+
+void NotFilter::bind(const Table& table) {
+    operand_->bind(table);
+}
+
+void NotFilter::renameColumns(const expression::Rename& rename) {
+    operand_->renameColumns(rename);
+}
+
+bool NotFilter::matches(size_t row, Table& table) const {
+    return !operand_->matches(row, table);
+}
+
+void NotFilter::filterBatch(Selection& selection, Table& table) const {
+    Selection matched = selection;
+    operand_->filterBatch(matched, table);
+    difference(selection, matched, selection);
+}
+
+Program Program::compile(const Filter& filter, const Table& table)
+{
+    Program program;
+    program.emit(filter, table, 0, true);
+    return program;
+}
+
+uint16_t Program::allocate()
+{
+    return registers_++;
+}
+
+// Emits `filter` over the rows of register `src` and returns the register
+// holding the matches. With `inPlace` the result may overwrite `src`,
+// otherwise `src` is left intact for a later DIFF or MERGE.
+uint16_t Program::emit(const Filter& filter, const Table& table, uint16_t src,
+                       bool inPlace)
+{
+    if (auto comparison = dynamic_cast<const ComparisonFilter*>(&filter))
+    {
+        return emitComparison(*comparison, table, src,
+                              inPlace ? src : allocate());
+    }
+    if (auto expression = dynamic_cast<const ExpressionFilter*>(&filter))
+    {
+        uint16_t dst = inPlace ? src : allocate();
+        if (auto lowered = expression->lowered())
+        {
+            return emitComparison(*lowered, table, src, dst);
+        }
+        code_.push_back({ .op = Opcode::CMP_EXPR,
+                          .dst = dst,
+                          .src = src,
+                          .expression = expression });
+        return dst;
+    }
+    if (auto negation = dynamic_cast<const NotFilter*>(&filter))
+    {
+        uint16_t matched = emit(negation->operand(), table, src, false);
+        uint16_t dst = inPlace ? src : allocate();
+        code_.push_back({ .op = Opcode::DIFF,
+                          .dst = dst,
+                          .src = src,
+                          .src2 = matched });
+        return dst;
+    }
+    auto logical = dynamic_cast<const LogicalFilter*>(&filter);
+    if (!logical)
+    {
+        throw DatabaseException("Filter cannot be compiled");
+    }
+    if (logical->op() == LogicalFilter::AND)
+    {
+        uint16_t accepted = emit(logical->left(), table, src, inPlace);
+        return emit(logical->right(), table, accepted, true);
+    }
+    uint16_t accepted = emit(logical->left(), table, src, false);
+    uint16_t undecided = allocate();
+    code_.push_back({ .op = Opcode::DIFF,
+                      .dst = undecided,
+                      .src = src,
+                      .src2 = accepted });
+    undecided = emit(logical->right(), table, undecided, true);
+    uint16_t dst = inPlace ? src : allocate();
+    code_.push_back({ .op = Opcode::MERGE,
+                      .dst = dst,
+                      .src = accepted,
+                      .src2 = undecided });
+    return dst;
+}
+
+uint16_t Program::emitComparison(const ComparisonFilter& filter,
+                                 const Table& table, uint16_t src,
+                                 uint16_t dst)
+{
+    auto&& data = table.getStorage().column(filter.column());
+    Instruction instruction{ .op = Opcode::COPY,
+                             .cmp = filter.op(),
+                             .dst = dst,
+                             .src = src,
+                             .column = &data };
+
+    if (!filter.sameType())
+    {
+        // a type mismatch orders the same way for every row, an empty table
+        // never runs the program
+        bool keep = data.size() != 0 &&
+                    applyOperator(filter.op(), data.compare(0, filter.value()));
+        instruction.op = keep ? Opcode::COPY : Opcode::CLEAR;
+        code_.push_back(instruction);
+        return dst;
+    }
+
+    switch (data.getColumnType())
+    {
+    case columns::ColumType::Integer:
+    case columns::ColumType::Id:
+        instruction.op = Opcode::CMP_I32;
+        instruction.immediate =
+            std::get<columns::Integer::value_type>(filter.value());
+        break;
+    case columns::ColumType::Bool:
+        instruction.op = Opcode::CMP_BOOL;
+        instruction.immediate =
+            std::get<columns::Bool::value_type>(filter.value());
+        break;
+    case columns::ColumType::String:
+    case columns::ColumType::Bytes:
+        instruction.op = Opcode::CMP_STR;
+        instruction.immediate = static_cast<int32_t>(strings_.size());
+        strings_.emplace_back(bytesOf(filter.value()));
+        break;
+    default:
+        throw DatabaseException("Filter on " + filter.fieldName() +
+                                ": unsupported column type");
+    }
+    code_.push_back(instruction);
+    return dst;
+}
+
+void Program::filterBatch(Selection& selection, Registers& registers) const
+{
+    if (selection.empty())
+    {
+        return;
+    }
+    // full scans hand over aligned blocks of consecutive rows
+    if (isDense(selection) && selection.front() % 64 == 0 &&
+        selection.size() <= kBatchSize)
+    {
+        runMasks(selection, registers);
+    }
+    else
+    {
+        runSelections(selection, registers);
+    }
+}
+
+void Program::runSelections(Selection& selection, Registers& registers) const
+{
+    registers.selections.resize(registers_);
+    auto reg = [&](uint16_t idx) -> Selection&
+    { return idx == 0 ? selection : registers.selections[idx]; };
+
+    for (auto&& instruction : code_)
+    {
+        Selection& dst = reg(instruction.dst);
+        const Selection& src = reg(instruction.src);
+        switch (instruction.op)
+        {
+        case Opcode::CMP_I32:
+        case Opcode::CMP_BOOL:
+        case Opcode::CMP_STR:
+            if (&dst != &src)
+            {
+                dst = src;
+            }
+            if (dst.empty())
+            {
+                break;
+            }
+            if (instruction.op == Opcode::CMP_I32)
+            {
+                compareInts(dst,
+                            static_cast<const storage::IntegerData&>(
+                                *instruction.column),
+                            instruction.cmp, instruction.immediate);
+            }
+            else if (instruction.op == Opcode::CMP_BOOL)
+            {
+                compareBools(
+                    dst,
+                    static_cast<const storage::BoolData&>(*instruction.column),
+                    instruction.cmp, instruction.immediate != 0);
+            }
+            else
+            {
+                compareVarlen(dst,
+                              static_cast<const storage::VarlenData&>(
+                                  *instruction.column),
+                              instruction.cmp, strings_[instruction.immediate]);
+            }
+            break;
+        case Opcode::CMP_EXPR:
+            if (&dst != &src)
+            {
+                dst = src;
+            }
+            instruction.expression->filterRows(dst);
+            break;
+        case Opcode::CLEAR:
+            dst.clear();
+            break;
+        case Opcode::COPY:
+            if (&dst != &src)
+            {
+                dst = src;
+            }
+            break;
+        case Opcode::DIFF:
+            difference(src, reg(instruction.src2), dst);
+            break;
+        case Opcode::MERGE:
+        {
+            const Selection& other = reg(instruction.src2);
+            dst.clear();
+            std::merge(src.begin(), src.end(), other.begin(), other.end(),
+                       std::back_inserter(dst));
+            break;
+        }
+        }
+    }
+}
+
+void Program::runMasks(Selection& selection, Registers& registers) const
+{
+    constexpr size_t kWords = simd::maskWords(kBatchSize);
+    const size_t first = selection.front();
+    const size_t count = selection.size();
+    const size_t words = simd::maskWords(count);
+
+    registers.masks.resize(registers_ * kWords);
+    auto reg = [&](uint16_t idx) { return registers.masks.data() + idx * kWords; };
+
+    uint64_t* all = reg(0);
+    std::fill(all, all + words, ~uint64_t{ 0 });
+    if (count % 64 != 0)
+    {
+        all[words - 1] = (uint64_t{ 1 } << (count % 64)) - 1;
+    }
+
+    uint64_t matched[kWords];
+    for (auto&& instruction : code_)
+    {
+        uint64_t* dst = reg(instruction.dst);
+        const uint64_t* src = reg(instruction.src);
+        switch (instruction.op)
+        {
+        case Opcode::CMP_I32:
+            simd::compareInt32(
+                static_cast<const storage::IntegerData*>(instruction.column)
+                        ->values()
+                        .data() +
+                    first,
+                count, toSimdOp(instruction.cmp), instruction.immediate,
+                matched);
+            for (size_t word = 0; word < words; ++word)
+            {
+                dst[word] = src[word] & matched[word];
+            }
+            break;
+        case Opcode::CMP_BOOL:
+            simd::compareBool(
+                static_cast<const storage::BoolData*>(instruction.column)
+                        ->words()
+                        .data() +
+                    first / 64,
+                count, toSimdOp(instruction.cmp), instruction.immediate != 0,
+                matched);
+            for (size_t word = 0; word < words; ++word)
+            {
+                dst[word] = src[word] & matched[word];
+            }
+            break;
+        case Opcode::CMP_STR:
+        {
+            // no kernel for strings: only the rows still in play are read
+            auto&& data =
+                static_cast<const storage::VarlenData&>(*instruction.column);
+            std::string_view value = strings_[instruction.immediate];
+            for (size_t word = 0; word < words; ++word)
+            {
+                uint64_t keep = 0;
+                for (uint64_t bits = src[word]; bits; bits &= bits - 1)
+                {
+                    size_t bit = std::countr_zero(bits);
+                    int cmp = data.at(first + word * 64 + bit).compare(value);
+                    keep |= uint64_t{ applyOperator(instruction.cmp, cmp) }
+                            << bit;
+                }
+                dst[word] = keep;
+            }
+            break;
+        }
+        case Opcode::CMP_EXPR:
+        {
+            // expressions work on row ids, only the rows in play are read
+            Selection& rows = registers.scratch;
+            rows.clear();
+            for (size_t word = 0; word < words; ++word)
+            {
+                for (uint64_t bits = src[word]; bits; bits &= bits - 1)
+                {
+                    rows.push_back(first + word * 64 + std::countr_zero(bits));
+                }
+            }
+            instruction.expression->filterRows(rows);
+            std::fill(dst, dst + words, 0);
+            for (size_t row : rows)
+            {
+                dst[(row - first) / 64] |= uint64_t{ 1 } << ((row - first) % 64);
+            }
+            break;
+        }
+        case Opcode::CLEAR:
+            std::fill(dst, dst + words, 0);
+            break;
+        case Opcode::COPY:
+            std::copy(src, src + words, dst);
+            break;
+        case Opcode::DIFF:
+        {
+            const uint64_t* other = reg(instruction.src2);
+            for (size_t word = 0; word < words; ++word)
+            {
+                dst[word] = src[word] & ~other[word];
+            }
+            break;
+        }
+        case Opcode::MERGE:
+        {
+            const uint64_t* other = reg(instruction.src2);
+            for (size_t word = 0; word < words; ++word)
+            {
+                dst[word] = src[word] | other[word];
+            }
+            break;
+        }
+        }
+    }
+
+    selection.clear();
+    for (size_t word = 0; word < words; ++word)
+    {
+        for (uint64_t bits = all[word]; bits; bits &= bits - 1)
+        {
+            selection.push_back(first + word * 64 + std::countr_zero(bits));
+        }
+    }
 }
 
 } // namespace filters
@@ -1,54 +1,63 @@
 #include "Helpers.hpp"
+#include "CsvReader.hpp"
+#include "Simd.hpp"
+
+#include <bit>
 
 namespace db {
 
 std::string escapeCSVField(const std::string& field)
 {
-    std::string escaped = field;
-    size_t pos = 0;
-    while ((pos = escaped.find('"', pos)) != std::string::npos)
+    auto level = simd::detectLevel();
+    bool special = false;
+    for (size_t block = 0; block < field.size() && !special; block += 64)
+    {
+        auto masks = simd::classifyCsv(field.data() + block,
+                                       field.size() - block, level);
+        special = (masks.quotes | masks.commas) != 0;
+    }
+    if (!special)
     {
-        escaped.insert(pos, 1, '"');
-        pos += 2;
+        return field;
     }
-    if (escaped.find(',') != std::string::npos ||
-        escaped.find('"') != std::string::npos)
+
+    // copy the runs between quotes, doubling every quote
+    std::string escaped;
+    escaped.reserve(field.size() + 16);
+    escaped += '"';
+    size_t copied = 0;
+    for (size_t block = 0; block < field.size(); block += 64)
     {
-        escaped = "\"" + escaped + "\"";
+        auto quotes = simd::classifyCsv(field.data() + block,
+                                        field.size() - block, level)
+                          .quotes;
+        for (; quotes != 0; quotes &= quotes - 1)
+        {
+            size_t pos = block + std::countr_zero(quotes);
+            escaped.append(field, copied, pos + 1 - copied);
+            escaped += '"';
+            copied = pos + 1;
+        }
     }
+    escaped.append(field, copied);
+    escaped += '"';
     return escaped;
 }
 
 std::vector<std::string> parseCSVLine(const std::string& line)
 {
     std::vector<std::string> fields;
-    std::string field;
-    bool inQuotes = false;
-
-    for (size_t i = 0; i < line.length(); ++i)
+    csv::Tokenizer tokens(line);
+    std::string_view field;
+    bool rowEnd = false;
+    while (tokens.next(field, rowEnd))
     {
-        char c = line[i];
-        if (c == '"')
-        {
-            inQuotes = !inQuotes;
-            // If the next character is also a quote, it's an escaped quote
-            if (inQuotes && i + 1 < line.length() && line[i + 1] == '"')
-            {
-                field += '"';
-                ++i;
-            }
-        }
-        else if (c == ',' && !inQuotes)
-        {
-            fields.push_back(field);
-            field.clear();
-        }
-        else
-        {
-            field += c;
-        }
+        fields.emplace_back(field);
+    }
+    if (fields.empty())
+    {
+        fields.emplace_back();
     }
-    fields.push_back(field);
     return fields;
 }
 
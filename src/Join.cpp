@@ -0,0 +1,272 @@
+#include "Join.hpp"
+#include "DataBaseException.hpp"
+
+#include <algorithm>
+#include <optional>
+#include <unordered_map>
+
+namespace db
+{
+
+namespace join
+{
+
+void qualify(Table::View& view)
+{
+    Table::RecordMappingT qualified;
+    for (auto&& [name, pos] : view.recordMapping)
+    {
+        qualified[view.tableName_ + "." + name] = pos;
+    }
+    view.recordMapping = std::move(qualified);
+}
+
+namespace
+{
+
+std::optional<size_t> findColumn(const Table::View& view,
+                                 const std::string& name)
+{
+    auto it = view.recordMapping.find(name);
+    if (it != view.recordMapping.end())
+    {
+        return it->second;
+    }
+    if (name.find('.') != std::string::npos)
+    {
+        return std::nullopt;
+    }
+    const std::string suffix = "." + name;
+    std::optional<size_t> found;
+    for (auto&& [column, pos] : view.recordMapping)
+    {
+        if (column.ends_with(suffix))
+        {
+            if (found)
+            {
+                throw DatabaseException("Join: Ambiguous column: " + name);
+            }
+            found = pos;
+        }
+    }
+    return found;
+}
+
+void splitConjuncts(std::unique_ptr<filters::Filter> filter,
+                    std::vector<std::unique_ptr<filters::Filter>>& conjuncts)
+{
+    auto logical = dynamic_cast<filters::LogicalFilter*>(filter.get());
+    if (logical && logical->op() == filters::LogicalFilter::AND)
+    {
+        auto [left, right] = logical->releaseOperands();
+        splitConjuncts(std::move(left), conjuncts);
+        splitConjuncts(std::move(right), conjuncts);
+        return;
+    }
+    conjuncts.push_back(std::move(filter));
+}
+
+// (table, column) named by `name`, unset for bare words
+std::optional<std::pair<std::string, std::string>> findTableColumn(
+    const std::vector<std::pair<std::string, const Table*>>& tables,
+    const std::string& name)
+{
+    if (auto dot = name.find('.'); dot != std::string::npos)
+    {
+        auto tableName = name.substr(0, dot);
+        auto column = name.substr(dot + 1);
+        for (auto&& [candidate, table] : tables)
+        {
+            if (candidate == tableName && table->hasColumn(column))
+            {
+                return std::pair{ tableName, column };
+            }
+        }
+        throw DatabaseException("Join: Unknown column: " + name);
+    }
+    std::optional<std::pair<std::string, std::string>> found;
+    for (auto&& [tableName, table] : tables)
+    {
+        if (table->hasColumn(name))
+        {
+            if (found)
+            {
+                throw DatabaseException("Join: Ambiguous column: " + name);
+            }
+            found.emplace(tableName, name);
+        }
+    }
+    return found;
+}
+
+} // namespace
+
+std::map<std::string, std::unique_ptr<filters::Filter>> splitFilter(
+    std::unique_ptr<filters::Filter> filter,
+    const std::vector<std::pair<std::string, const Table*>>& tables)
+{
+    std::map<std::string, std::unique_ptr<filters::Filter>> filters;
+    if (!filter)
+    {
+        return filters;
+    }
+    std::vector<std::unique_ptr<filters::Filter>> conjuncts;
+    splitConjuncts(std::move(filter), conjuncts);
+    for (auto&& conjunct : conjuncts)
+    {
+        std::optional<std::string> owner;
+        conjunct->renameColumns([&](const std::string& name) {
+            auto found = findTableColumn(tables, name);
+            if (!found)
+            {
+                return name;
+            }
+            if (owner && *owner != found->first)
+            {
+                throw DatabaseException(
+                    "Join: WHERE conditions may only read one table: " + name);
+            }
+            owner = found->first;
+            return found->second;
+        });
+        auto& tableFilter = filters[owner.value_or(tables.front().first)];
+        tableFilter = tableFilter
+            ? std::make_unique<filters::LogicalFilter>(
+                  filters::LogicalFilter::AND, std::move(tableFilter),
+                  std::move(conjunct))
+            : std::move(conjunct);
+    }
+    return filters;
+}
+
+size_t resolve(const Table::View& view, const std::string& name)
+{
+    if (auto pos = findColumn(view, name))
+    {
+        return *pos;
+    }
+    throw DatabaseException("Join: Unknown column: " + name);
+}
+
+std::pair<size_t, size_t> resolveKeys(const Table::View& left,
+                                      const Table::View& right,
+                                      const JoinSpec& spec)
+{
+    auto leftKey = findColumn(left, spec.leftColumn);
+    auto rightKey = findColumn(right, spec.rightColumn);
+    if (leftKey && rightKey)
+    {
+        return { *leftKey, *rightKey };
+    }
+    leftKey = findColumn(left, spec.rightColumn);
+    rightKey = findColumn(right, spec.leftColumn);
+    if (leftKey && rightKey)
+    {
+        return { *leftKey, *rightKey };
+    }
+    throw DatabaseException("Join: Cannot resolve condition " +
+                            spec.leftColumn + " = " + spec.rightColumn +
+                            " on table " + spec.tableName);
+}
+
+std::unique_ptr<Table::View> hashJoin(const Table::View& left, size_t leftKey,
+                                      const Table::View& right,
+                                      size_t rightKey)
+{
+    std::vector<Table::ColumnType> columns = left.columnPtrs;
+    columns.insert(columns.end(), right.columnPtrs.begin(),
+                   right.columnPtrs.end());
+
+    const size_t leftWidth = left.columnPtrs.size();
+    Table::RecordMappingT mapping = left.recordMapping;
+    for (auto&& [name, pos] : right.recordMapping)
+    {
+        mapping[name] = leftWidth + pos;
+    }
+
+    auto result = std::make_unique<Table::View>(
+        left.tableName_ + " join " + right.tableName_, columns, mapping);
+
+    const bool buildLeft = left.size() < right.size();
+    auto&& build = buildLeft ? left : right;
+    auto&& probe = buildLeft ? right : left;
+    const size_t buildKey = buildLeft ? leftKey : rightKey;
+    const size_t probeKey = buildLeft ? rightKey : leftKey;
+
+    // key -> positions of the build side rows
+    std::unordered_map<Table::value_type, std::vector<size_t>,
+                       columns::ValueHash>
+        hashTable;
+    hashTable.reserve(build.size());
+    for (size_t row = 0; row < build.size(); ++row)
+    {
+        hashTable[build.value(row, buildKey)].push_back(row);
+    }
+
+    for (size_t probeRow = 0; probeRow < probe.size(); ++probeRow)
+    {
+        auto it = hashTable.find(probe.value(probeRow, probeKey));
+        if (it == hashTable.end())
+        {
+            continue;
+        }
+        auto probeRecord = probe.record(probeRow);
+        for (auto&& buildRow : it->second)
+        {
+            auto buildRecord = build.record(buildRow);
+            auto&& leftRecord = buildLeft ? buildRecord : probeRecord;
+            auto&& rightRecord = buildLeft ? probeRecord : buildRecord;
+
+            auto joined = std::make_shared<Table::Record>(0);
+            joined->rows.reserve(columns.size());
+            joined->rows.insert(joined->rows.end(), leftRecord.rows.begin(),
+                                leftRecord.rows.end());
+            joined->rows.insert(joined->rows.end(), rightRecord.rows.begin(),
+                                rightRecord.rows.end());
+            result->recordPtrs.push_back(std::move(joined));
+        }
+    }
+
+    return result;
+}
+
+void orderBy(Table::View& view, const std::vector<sort::SortKey>& keys)
+{
+    std::vector<std::pair<size_t, bool>> positions;
+    for (auto&& key : keys)
+    {
+        positions.emplace_back(resolve(view, key.column), key.descending);
+    }
+    std::stable_sort(view.recordPtrs.begin(), view.recordPtrs.end(),
+                     [&](auto&& left, auto&& right)
+                     {
+                         for (auto&& [pos, descending] : positions)
+                         {
+                             auto&& l = left->rows[pos].rowData;
+                             auto&& r = right->rows[pos].rowData;
+                             if (l != r)
+                             {
+                                 return descending ? r < l : l < r;
+                             }
+                         }
+                         return false;
+                     });
+}
+
+void project(Table::View& view, const std::vector<std::string>& selectList)
+{
+    if (selectList.empty())
+    {
+        return;
+    }
+    Table::RecordMappingT projected;
+    for (auto&& name : selectList)
+    {
+        projected[name] = resolve(view, name);
+    }
+    view.recordMapping = std::move(projected);
+}
+
+} // namespace join
+
+} // namespace db
@@ -60,6 +60,8 @@ Token Lexer::identifierOrKeyword()
         return Token{ TOK_DELETE, lexeme, line, column };
     if (upperLexeme == "INDEX")
         return Token{ TOK_INDEX, lexeme, line, column };
+    if (upperLexeme == "DROP")
+        return Token{ TOK_DROP, lexeme, line, column };
     if (upperLexeme == "JOIN")
         return Token{ TOK_JOIN, lexeme, line, column };
     if (upperLexeme == "ON")
@@ -80,12 +82,30 @@ Token Lexer::identifierOrKeyword()
         return Token{ TOK_BY, lexeme, line, column };
     if (upperLexeme == "ORDERED")
         return Token{ TOK_ORDERED, lexeme, line, column };
-    // if (upperLexeme == "AUTOINCREMENT")
-    //     return Token{ TOK_ATT_AUTOINCREMENT, lexeme, line, column };
-    // if (upperLexeme == "KEY")
-    //     return Token{ TOK_ATT_KEY, lexeme, line, column };
-    // if (upperLexeme == "UNIQUE")
-    //     return Token{ TOK_ATT_UNIQUE, lexeme, line, column };
+    if (upperLexeme == "ORDER")
+        return Token{ TOK_ORDER, lexeme, line, column };
+    if (upperLexeme == "ASC")
+        return Token{ TOK_ASC, lexeme, line, column };
+    if (upperLexeme == "DESC")
+        return Token{ TOK_DESC, lexeme, line, column };
+    if (upperLexeme == "LIMIT")
+        return Token{ TOK_LIMIT, lexeme, line, column };
+    if (upperLexeme == "OFFSET")
+        return Token{ TOK_OFFSET, lexeme, line, column };
+    if (upperLexeme == "GROUP")
+        return Token{ TOK_GROUP, lexeme, line, column };
+    if (upperLexeme == "BEGIN")
+        return Token{ TOK_BEGIN, lexeme, line, column };
+    if (upperLexeme == "COMMIT")
+        return Token{ TOK_COMMIT, lexeme, line, column };
+    if (upperLexeme == "ROLLBACK")
+        return Token{ TOK_ROLLBACK, lexeme, line, column };
+    if (upperLexeme == "AUTOINCREMENT")
+        return Token{ TOK_ATT_AUTOINCREMENT, lexeme, line, column };
+    if (upperLexeme == "KEY")
+        return Token{ TOK_ATT_KEY, lexeme, line, column };
+    if (upperLexeme == "UNIQUE")
+        return Token{ TOK_ATT_UNIQUE, lexeme, line, column };
     if (upperLexeme == "INT32")
         return Token{ TOK_INT32, lexeme, line, column };
     if (upperLexeme == "STRING")
@@ -59,7 +59,14 @@ std::unique_ptr<commands::BaseCommand> Parser::parseCommand()
     switch (currentToken_.type)
     {
     case lexer::TOK_CREATE:
+        advance();
+        if (currentToken_.type == lexer::TOK_INDEX)
+        {
+            return parseCreateIndex();
+        }
         return parseCreateTable();
+    case lexer::TOK_DROP:
+        return parseDropIndex();
     case lexer::TOK_INSERT:
         return parseInsert();
     case lexer::TOK_SELECT:
@@ -68,6 +75,12 @@ std::unique_ptr<commands::BaseCommand> Parser::parseCommand()
         return parseUpdate();
     case lexer::TOK_DELETE:
         return parseDelete();
+    case lexer::TOK_BEGIN:
+        return std::make_unique<commands::Begin>();
+    case lexer::TOK_COMMIT:
+        return std::make_unique<commands::Commit>();
+    case lexer::TOK_ROLLBACK:
+        return std::make_unique<commands::Rollback>();
     default:
         throw DatabaseException("Unknown command: " + currentToken_.lexeme);
     }
@@ -75,7 +88,6 @@ std::unique_ptr<commands::BaseCommand> Parser::parseCommand()
 
 std::unique_ptr<commands::CreateTable> Parser::parseCreateTable()
 {
-    expect(lexer::TOK_CREATE);
     expect(lexer::TOK_TABLE);
 
     expect(lexer::TOK_IDENTIFIER);
@@ -96,13 +108,59 @@ std::unique_ptr<commands::CreateTable> Parser::parseCreateTable()
     return std::make_unique<commands::CreateTable>(tableName, columns);
 }
 
+std::pair<std::string, std::string> Parser::parseIndexTarget()
+{
+    expect(lexer::TOK_ON);
+
+    expect(lexer::TOK_IDENTIFIER);
+    std::string tableName = previousToken_.lexeme;
+
+    expect(lexer::TOK_LPAREN); // (
+    expect(lexer::TOK_IDENTIFIER);
+    std::string columnName = previousToken_.lexeme;
+    expect(lexer::TOK_RPAREN); // )
+
+    return { tableName, columnName };
+}
+
+std::unique_ptr<commands::CreateIndex> Parser::parseCreateIndex()
+{
+    expect(lexer::TOK_INDEX);
+
+    auto [tableName, columnName] = parseIndexTarget();
+
+#ifdef DEBUG
+    std::cout << "// Parsing create index on " + tableName + "(" + columnName +
+                     ") command is ended!"
+              << std::endl;
+#endif
+
+    return std::make_unique<commands::CreateIndex>(tableName, columnName);
+}
+
+std::unique_ptr<commands::DropIndex> Parser::parseDropIndex()
+{
+    expect(lexer::TOK_DROP);
+    expect(lexer::TOK_INDEX);
+
+    auto [tableName, columnName] = parseIndexTarget();
+
+#ifdef DEBUG
+    std::cout << "// Parsing drop index on " + tableName + "(" + columnName +
+                     ") command is ended!"
+              << std::endl;
+#endif
+
+    return std::make_unique<commands::DropIndex>(tableName, columnName);
+}
+
 columns::BaseColumn::value_type
 Parser::getActualValue(lexer::TokenType dataType, std::string stringVal)
 {
     columns::BaseColumn::value_type actualValue;
     if (dataType == lexer::TOK_INT_LITERAL || dataType == lexer::TOK_INT32)
     {
-        actualValue = std::stoi(stringVal);
+        actualValue = stringVal.empty() ? 0 : std::stoi(stringVal);
     }
     else if (dataType == lexer::TOK_STRING_LITERAL ||
              dataType == lexer::TOK_STRING)
@@ -140,18 +198,26 @@ void Parser::parseColumnDefinitions(std::vector<Table::ColumnType>& columns)
         std::unordered_map<lexer::TokenType, bool> attributes = {
             { lexer::TOK_ATT_AUTOINCREMENT, false },
             { lexer::TOK_ATT_UNIQUE, false },
-            { lexer::TOK_ATT_KEY, false }
+            { lexer::TOK_ATT_KEY, false },
+            { lexer::TOK_INDEX, false }
         };
         if (match(lexer::TOK_LBRACE))
         {
-            while (!match(lexer::TOK_RBRACE))
+            do
             {
-                advance();
+                if (!attributes.contains(currentToken_.type))
+                {
+                    throw DatabaseException("Unknown column attribute: " +
+                                            currentToken_.lexeme);
+                }
                 attributes[currentToken_.type] = true;
                 advance();
-                match(lexer::TOK_COMMA);
-            }
+            } while (match(lexer::TOK_COMMA));
+            expect(lexer::TOK_RBRACE);
         }
+        // keys are always looked up through an index
+        bool index =
+            attributes[lexer::TOK_INDEX] || attributes[lexer::TOK_ATT_KEY];
 
         expect(lexer::TOK_IDENTIFIER);
         std::string columnName = previousToken_.lexeme;
@@ -184,9 +250,9 @@ void Parser::parseColumnDefinitions(std::vector<Table::ColumnType>& columns)
                 columnName,
                 std::get<columns::Integer::value_type>(getActualValue(
                     lexer::TOK_INT32, std::move(defaultValueString))),
-                false, attributes[lexer::TOK_ATT_UNIQUE],
+                index, attributes[lexer::TOK_ATT_UNIQUE],
                 attributes[lexer::TOK_ATT_KEY],
-                attributes[lexer::TOK_ATT_UNIQUE]);
+                attributes[lexer::TOK_ATT_AUTOINCREMENT]);
         }
         else if (dataType == lexer::TOK_STRING)
         {
@@ -194,7 +260,7 @@ void Parser::parseColumnDefinitions(std::vector<Table::ColumnType>& columns)
                 columnName, maxLen,
                 std::get<columns::String::value_type>(getActualValue(
                     lexer::TOK_STRING, std::move(defaultValueString))),
-                false, attributes[lexer::TOK_ATT_UNIQUE],
+                index, attributes[lexer::TOK_ATT_UNIQUE],
                 attributes[lexer::TOK_ATT_KEY]);
         }
         else if (dataType == lexer::TOK_BYTES)
@@ -203,7 +269,7 @@ void Parser::parseColumnDefinitions(std::vector<Table::ColumnType>& columns)
                 columnName, maxLen,
                 std::get<columns::Bytes::value_type>(getActualValue(
                     lexer::TOK_BYTES, std::move(defaultValueString))),
-                false, attributes[lexer::TOK_ATT_UNIQUE],
+                index, attributes[lexer::TOK_ATT_UNIQUE],
                 attributes[lexer::TOK_ATT_KEY]);
         }
         else if (dataType == lexer::TOK_BOOL)
@@ -212,7 +278,7 @@ void Parser::parseColumnDefinitions(std::vector<Table::ColumnType>& columns)
                 columnName,
                 std::get<columns::Bool::value_type>(getActualValue(
                     lexer::TOK_BOOL, std::move(defaultValueString))),
-                false, attributes[lexer::TOK_ATT_UNIQUE],
+                index, attributes[lexer::TOK_ATT_UNIQUE],
                 attributes[lexer::TOK_ATT_KEY]);
         }
         columns.push_back(std::move(column));
@@ -268,12 +334,13 @@ void Parser::parseAssignments(Table::InsertType& valuesMap)
     } while (match(lexer::TOK_COMMA));
 }
 
-std::unique_ptr<commands::Select> Parser::parseSelect()
+std::unique_ptr<commands::BaseCommand> Parser::parseSelect()
 {
     expect(lexer::TOK_SELECT);
 
     // Parse select list
     std::vector<std::string> selectList;
+    aggregate::Grouping grouping;
     if (match(lexer::TOK_MULTIPLY))
     {
         // PASS
@@ -282,18 +349,7 @@ std::unique_ptr<commands::Select> Parser::parseSelect()
     {
         do
         {
-            expect(lexer::TOK_IDENTIFIER);
-            std::string column = previousToken_.lexeme;
-
-            // Handle qualified names
-            if (match(lexer::TOK_DOT))
-            {
-                expect(lexer::TOK_IDENTIFIER);
-                column = previousToken_.lexeme; // as we dont have joins
-            }
-
-            selectList.push_back(column);
-
+            selectList.push_back(parseSelectItem(grouping.aggregates));
         } while (match(lexer::TOK_COMMA));
     }
 
@@ -316,9 +372,99 @@ std::unique_ptr<commands::Select> Parser::parseSelect()
         whereCondition = parseWhere();
     }
 
+    if (match(lexer::TOK_GROUP))
+    {
+        expect(lexer::TOK_BY);
+        do
+        {
+            expect(lexer::TOK_IDENTIFIER);
+            std::string column = previousToken_.lexeme;
+            if (match(lexer::TOK_DOT))
+            {
+                expect(lexer::TOK_IDENTIFIER);
+                column += "." + previousToken_.lexeme;
+            }
+            grouping.columns.push_back(std::move(column));
+        } while (match(lexer::TOK_COMMA));
+    }
+
+    std::vector<sort::SortKey> orderBy;
+    if (match(lexer::TOK_ORDER))
+    {
+        orderBy = parseOrderBy();
+    }
+
+    Limit limit;
+    if (match(lexer::TOK_LIMIT))
+    {
+        limit = parseLimit();
+    }
+
+    if (!joins.empty())
+    {
+        if (!grouping.empty())
+        {
+            throw DatabaseException(
+                "GROUP BY and aggregates are not supported with JOIN");
+        }
+
+        std::vector<join::JoinSpec> joinSpecs;
+        for (auto&& clause : joins)
+        {
+            joinSpecs.push_back(makeJoinSpec(clause));
+        }
+
+#ifdef DEBUG
+        std::cout << "// Parsing join select to table " + tableName +
+                         " command is ended!"
+                  << std::endl;
+#endif
+
+        return std::make_unique<commands::Join>(
+            tableName, std::move(joinSpecs), selectList,
+            std::move(whereCondition), std::move(orderBy), limit);
+    }
+
+    // Without joins a qualifier can only name the selected table
+    auto unqualify = [](std::string& name)
+    {
+        auto dot = name.find('.');
+        if (dot == std::string::npos)
+        {
+            return;
+        }
+        // `sum(table.column)` keeps its function
+        auto open = name.find('(');
+        if (open != std::string::npos && open < dot)
+        {
+            name.erase(open + 1, dot - open);
+        }
+        else
+        {
+            name.erase(0, dot + 1);
+        }
+    };
+    for (auto&& column : selectList)
+    {
+        unqualify(column);
+    }
+    for (auto&& key : orderBy)
+    {
+        unqualify(key.column);
+    }
+    for (auto&& column : grouping.columns)
+    {
+        unqualify(column);
+    }
+    for (auto&& spec : grouping.aggregates)
+    {
+        unqualify(spec.column);
+    }
+
     // Create and return the command object
     auto command = std::make_unique<commands::Select>(
-        tableName, selectList, std::move(whereCondition));
+        tableName, selectList, std::move(whereCondition), std::move(orderBy),
+        limit, std::move(grouping));
 
 #ifdef DEBUG
     std::cout << "// Parsing select to table " + tableName +
@@ -329,9 +475,101 @@ std::unique_ptr<commands::Select> Parser::parseSelect()
     return command;
 }
 
+std::string Parser::parseSelectItem(std::vector<aggregate::Aggregate>& aggregates)
+{
+    expect(lexer::TOK_IDENTIFIER);
+    std::string column = previousToken_.lexeme;
+
+    // Handle qualified names
+    auto parseQualifier = [&]
+    {
+        if (match(lexer::TOK_DOT))
+        {
+            expect(lexer::TOK_IDENTIFIER);
+            column += "." + previousToken_.lexeme;
+        }
+    };
+
+    if (!match(lexer::TOK_LPAREN))
+    {
+        parseQualifier();
+        return column;
+    }
+
+    auto function = aggregate::functionByName(column);
+    if (!function)
+    {
+        throw DatabaseException("Unknown function: " + column);
+    }
+    aggregate::Aggregate spec{ *function };
+    if (!match(lexer::TOK_MULTIPLY))
+    {
+        expect(lexer::TOK_IDENTIFIER);
+        column = previousToken_.lexeme;
+        parseQualifier();
+        spec.column = column;
+    }
+    else if (*function != aggregate::Function::COUNT)
+    {
+        throw DatabaseException("Only count accepts *");
+    }
+    expect(lexer::TOK_RPAREN); // )
+
+    aggregates.push_back(spec);
+    return spec.name();
+}
+
+std::vector<sort::SortKey> Parser::parseOrderBy()
+{
+    // TOK_ORDER is already consumed by parseSelect
+    expect(lexer::TOK_BY);
+
+    std::vector<sort::SortKey> keys;
+    do
+    {
+        // aggregates are ordered by their result column
+        std::vector<aggregate::Aggregate> aggregates;
+        sort::SortKey key{ parseSelectItem(aggregates) };
+        if (match(lexer::TOK_DESC))
+        {
+            key.descending = true;
+        }
+        else
+        {
+            match(lexer::TOK_ASC);
+        }
+        keys.push_back(std::move(key));
+    } while (match(lexer::TOK_COMMA));
+
+    return keys;
+}
+
+Limit Parser::parseLimit()
+{
+    // TOK_LIMIT is already consumed by parseSelect
+    auto count = [this]
+    {
+        expect(lexer::TOK_INT_LITERAL);
+        auto&& lexeme = previousToken_.lexeme;
+        if (lexeme.starts_with('-'))
+        {
+            throw DatabaseException("LIMIT and OFFSET must not be negative");
+        }
+        return static_cast<size_t>(std::stoull(lexeme));
+    };
+
+    Limit limit;
+    limit.count = count();
+    if (match(lexer::TOK_OFFSET))
+    {
+        limit.offset = count();
+    }
+    return limit;
+}
+
 Parser::JoinClause Parser::parseJoinClause()
 {
-    expect(lexer::TOK_JOIN);
+    // TOK_JOIN is already consumed by parseSelect
 
     expect(lexer::TOK_IDENTIFIER);
     std::string tableName = previousToken_.lexeme;
@@ -343,6 +581,28 @@ Parser::JoinClause Parser::parseJoinClause()
     return { tableName, std::move(onCondition) };
 }
 
+join::JoinSpec Parser::makeJoinSpec(const JoinClause& clause)
+{
+    auto condition =
+        dynamic_cast<const expression::BinaryExpression*>(
+            clause.onCondition.get());
+    if (condition == nullptr || condition->op().type != lexer::TOK_EQUAL)
+    {
+        throw DatabaseException("Join " + clause.tableName +
+                                ": Only equality conditions are supported");
+    }
+    auto left = dynamic_cast<const expression::IdentifierExpression*>(
+        condition->left());
+    auto right = dynamic_cast<const expression::IdentifierExpression*>(
+        condition->right());
+    if (left == nullptr || right == nullptr)
+    {
+        throw DatabaseException("Join " + clause.tableName +
+                                ": Condition must compare two columns");
+    }
+    return { clause.tableName, left->name(), right->name() };
+}
+
 std::unique_ptr<commands::Update> Parser::parseUpdate()
 {
     expect(lexer::TOK_UPDATE);
@@ -418,8 +678,8 @@ std::unique_ptr<expression::Expression> Parser::parseLogicalOrExpression()
     {
         lexer::Token op = previousToken_;
         auto right = parseLogicalAndExpression();
-        left = std::make_unique<expression::BinaryExpression>(
-            op, std::move(left), std::move(right));
+        left = expression::fold(std::make_unique<expression::BinaryExpression>(
+            op, std::move(left), std::move(right)));
     }
 
     return left;
@@ -433,8 +693,8 @@ std::unique_ptr<expression::Expression> Parser::parseLogicalAndExpression()
     {
         lexer::Token op = previousToken_;
         auto right = parseEqualityExpression();
-        left = std::make_unique<expression::BinaryExpression>(
-            op, std::move(left), std::move(right));
+        left = expression::fold(std::make_unique<expression::BinaryExpression>(
+            op, std::move(left), std::move(right)));
     }
 
     return left;
@@ -449,8 +709,8 @@ std::unique_ptr<expression::Expression> Parser::parseRelationalExpression()
     {
         lexer::Token op = previousToken_;
         auto right = parseAdditiveExpression();
-        left = std::make_unique<expression::BinaryExpression>(
-            op, std::move(left), std::move(right));
+        left = expression::fold(std::make_unique<expression::BinaryExpression>(
+            op, std::move(left), std::move(right)));
     }
 
     return left;
@@ -464,8 +724,8 @@ std::unique_ptr<expression::Expression> Parser::parseAdditiveExpression()
     {
         lexer::Token op = previousToken_;
         auto right = parseMultiplicativeExpression();
-        left = std::make_unique<expression::BinaryExpression>(
-            op, std::move(left), std::move(right));
+        left = expression::fold(std::make_unique<expression::BinaryExpression>(
+            op, std::move(left), std::move(right)));
     }
 
     return left;
@@ -480,8 +740,8 @@ std::unique_ptr<expression::Expression> Parser::parseMultiplicativeExpression()
     {
         lexer::Token op = previousToken_;
         auto right = parseUnaryExpression();
-        left = std::make_unique<expression::BinaryExpression>(
-            op, std::move(left), std::move(right));
+        left = expression::fold(std::make_unique<expression::BinaryExpression>(
+            op, std::move(left), std::move(right)));
     }
 
     return left;
@@ -495,8 +755,8 @@ std::unique_ptr<expression::Expression> Parser::parseEqualityExpression()
     {
         lexer::Token op = previousToken_;
         auto right = parseRelationalExpression();
-        left = std::make_unique<expression::BinaryExpression>(
-            op, std::move(left), std::move(right));
+        left = expression::fold(std::make_unique<expression::BinaryExpression>(
+            op, std::move(left), std::move(right)));
     }
 
     return left;
@@ -508,8 +768,8 @@ std::unique_ptr<expression::Expression> Parser::parseUnaryExpression()
     {
         lexer::Token op = previousToken_;
         auto operand = parseUnaryExpression();
-        return std::make_unique<expression::UnaryExpression>(
-            op, std::move(operand));
+        return expression::fold(std::make_unique<expression::UnaryExpression>(
+            op, std::move(operand)));
     }
     else
     {
@@ -616,8 +876,9 @@ std::unique_ptr<filters::Filter> Parser::parseNotFilter()
 
 std::unique_ptr<filters::Filter> Parser::parseComparisonFilter()
 {
-    expect(lexer::TOK_IDENTIFIER);
-    std::string fieldName = previousToken_.lexeme;
+    // operands stop before relational and logical operators, so the
+    // filter grammar keeps combining the comparisons
+    auto left = parseAdditiveExpression();
 
     filters::ComparisonFilter::Operator op;
 
@@ -645,15 +906,30 @@ std::unique_ptr<filters::Filter> Parser::parseComparisonFilter()
     {
         op = filters::ComparisonFilter::GREATER_THAN_OR_EQUAL;
     }
+    else if (dynamic_cast<expression::BinaryExpression*>(left.get()) ||
+             dynamic_cast<expression::UnaryExpression*>(left.get()))
+    {
+        // a parenthesized condition such as `!(a = b + 1)`
+        return std::make_unique<filters::ExpressionFilter>(std::move(left));
+    }
     else
     {
         throw DatabaseException("Invalid WHERE operator");
     }
 
-    auto value = parseCondition();
+    auto right = parseAdditiveExpression();
 
-    return std::make_unique<filters::ComparisonFilter>(fieldName, op,
-                                                       value->evaluate({}));
+    // `column op constant` keeps the index and SIMD paths, everything else
+    // is evaluated over the row values
+    auto column = dynamic_cast<expression::IdentifierExpression*>(left.get());
+    auto constant = dynamic_cast<expression::ConstantExpression*>(right.get());
+    if (column && constant)
+    {
+        return std::make_unique<filters::ComparisonFilter>(
+            column->name(), op, constant->value());
+    }
+    return std::make_unique<filters::ExpressionFilter>(op, std::move(left),
+                                                       std::move(right));
 }
 
 } // namespace parser
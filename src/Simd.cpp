@@ -0,0 +1,362 @@
+#include "Simd.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SMALL_SQL_X86 1
+#endif
+
+namespace db
+{
+
+namespace simd
+{
+
+namespace
+{
+
+template <CompareOp Op>
+inline bool test(int32_t lhs, int32_t rhs)
+{
+    if constexpr (Op == CompareOp::Equal)
+        return lhs == rhs;
+    else if constexpr (Op == CompareOp::NotEqual)
+        return lhs != rhs;
+    else if constexpr (Op == CompareOp::Less)
+        return lhs < rhs;
+    else if constexpr (Op == CompareOp::LessEqual)
+        return lhs <= rhs;
+    else if constexpr (Op == CompareOp::Greater)
+        return lhs > rhs;
+    else
+        return lhs >= rhs;
+}
+
+// Ops implemented as the negation of a native SIMD compare
+template <CompareOp Op>
+constexpr bool kNegated = Op == CompareOp::NotEqual ||
+                          Op == CompareOp::LessEqual ||
+                          Op == CompareOp::GreaterEqual;
+
+template <CompareOp Op>
+uint64_t scalarWord(const int32_t* values, size_t count, int32_t value)
+{
+    uint64_t word = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        word |= static_cast<uint64_t>(test<Op>(values[i], value)) << i;
+    }
+    return word;
+}
+
+template <CompareOp Op>
+void compareScalar(const int32_t* values, size_t count, int32_t value,
+                   uint64_t* mask)
+{
+    for (size_t base = 0; base < count; base += 64)
+    {
+        size_t n = count - base < 64 ? count - base : 64;
+        mask[base / 64] = scalarWord<Op>(values + base, n, value);
+    }
+}
+
+#ifdef SMALL_SQL_X86
+
+template <CompareOp Op>
+__attribute__((target("sse4.2"))) void
+compareSse42(const int32_t* values, size_t count, int32_t value,
+             uint64_t* mask)
+{
+    const __m128i needle = _mm_set1_epi32(value);
+    size_t full = count / 64 * 64;
+    for (size_t base = 0; base < full; base += 64)
+    {
+        uint64_t word = 0;
+        for (size_t lane = 0; lane < 64; lane += 4)
+        {
+            __m128i v = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(values + base + lane));
+            __m128i cmp;
+            if constexpr (Op == CompareOp::Equal || Op == CompareOp::NotEqual)
+                cmp = _mm_cmpeq_epi32(v, needle);
+            else if constexpr (Op == CompareOp::Greater ||
+                               Op == CompareOp::LessEqual)
+                cmp = _mm_cmpgt_epi32(v, needle);
+            else
+                cmp = _mm_cmplt_epi32(v, needle);
+            word |= static_cast<uint64_t>(
+                        _mm_movemask_ps(_mm_castsi128_ps(cmp)))
+                    << lane;
+        }
+        mask[base / 64] = kNegated<Op> ? ~word : word;
+    }
+    if (full < count)
+    {
+        mask[full / 64] = scalarWord<Op>(values + full, count - full, value);
+    }
+}
+
+template <CompareOp Op>
+__attribute__((target("avx2"))) void
+compareAvx2(const int32_t* values, size_t count, int32_t value, uint64_t* mask)
+{
+    const __m256i needle = _mm256_set1_epi32(value);
+    size_t full = count / 64 * 64;
+    for (size_t base = 0; base < full; base += 64)
+    {
+        uint64_t word = 0;
+        for (size_t lane = 0; lane < 64; lane += 8)
+        {
+            __m256i v = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(values + base + lane));
+            __m256i cmp;
+            if constexpr (Op == CompareOp::Equal || Op == CompareOp::NotEqual)
+                cmp = _mm256_cmpeq_epi32(v, needle);
+            else if constexpr (Op == CompareOp::Greater ||
+                               Op == CompareOp::LessEqual)
+                cmp = _mm256_cmpgt_epi32(v, needle);
+            else
+                cmp = _mm256_cmpgt_epi32(needle, v);
+            word |= static_cast<uint64_t>(
+                        _mm256_movemask_ps(_mm256_castsi256_ps(cmp)))
+                    << lane;
+        }
+        mask[base / 64] = kNegated<Op> ? ~word : word;
+    }
+    if (full < count)
+    {
+        mask[full / 64] = scalarWord<Op>(values + full, count - full, value);
+    }
+}
+
+__attribute__((target("sse4.2"))) uint64_t
+matchSse42(const __m128i* blocks, char c)
+{
+    const __m128i needle = _mm_set1_epi8(c);
+    uint64_t bits = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        bits |= static_cast<uint64_t>(static_cast<uint16_t>(
+                    _mm_movemask_epi8(_mm_cmpeq_epi8(blocks[i], needle))))
+                << (16 * i);
+    }
+    return bits;
+}
+
+__attribute__((target("sse4.2"))) CsvMasks classifyCsvSse42(const char* data)
+{
+    __m128i blocks[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        blocks[i] =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * i));
+    }
+    return { matchSse42(blocks, '"'), matchSse42(blocks, ','),
+             matchSse42(blocks, '\n') };
+}
+
+__attribute__((target("avx2"))) uint64_t matchAvx2(__m256i lo, __m256i hi,
+                                                   char c)
+{
+    const __m256i needle = _mm256_set1_epi8(c);
+    auto low = static_cast<uint32_t>(
+        _mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, needle)));
+    auto high = static_cast<uint32_t>(
+        _mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, needle)));
+    return low | static_cast<uint64_t>(high) << 32;
+}
+
+__attribute__((target("avx2"))) CsvMasks classifyCsvAvx2(const char* data)
+{
+    __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+    __m256i hi =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + 32));
+    return { matchAvx2(lo, hi, '"'), matchAvx2(lo, hi, ','),
+             matchAvx2(lo, hi, '\n') };
+}
+
+#endif
+
+template <CompareOp Op>
+void compareAt(const int32_t* values, size_t count, int32_t value,
+               uint64_t* mask, Level level)
+{
+#ifdef SMALL_SQL_X86
+    if (level == Level::Avx2)
+    {
+        return compareAvx2<Op>(values, count, value, mask);
+    }
+    if (level == Level::Sse42)
+    {
+        return compareSse42<Op>(values, count, value, mask);
+    }
+#else
+    (void)level;
+#endif
+    compareScalar<Op>(values, count, value, mask);
+}
+
+} // namespace
+
+Level detectLevel()
+{
+    static const Level level = []
+    {
+#ifdef SMALL_SQL_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+        {
+            return Level::Avx2;
+        }
+        if (__builtin_cpu_supports("sse4.2"))
+        {
+            return Level::Sse42;
+        }
+#endif
+        return Level::Scalar;
+    }();
+    return level;
+}
+
+const char* levelName(Level level)
+{
+    switch (level)
+    {
+    case Level::Avx2:
+        return "avx2";
+    case Level::Sse42:
+        return "sse4.2";
+    default:
+        return "scalar";
+    }
+}
+
+CsvMasks classifyCsv(const char* data, size_t size)
+{
+    return classifyCsv(data, size, detectLevel());
+}
+
+CsvMasks classifyCsv(const char* data, size_t size, Level level)
+{
+    if (level > detectLevel())
+    {
+        level = detectLevel();
+    }
+#ifdef SMALL_SQL_X86
+    // vector loads need the whole 64 bytes, a short tail is done by hand
+    if (size >= 64 && level == Level::Avx2)
+    {
+        return classifyCsvAvx2(data);
+    }
+    if (size >= 64 && level == Level::Sse42)
+    {
+        return classifyCsvSse42(data);
+    }
+#endif
+    CsvMasks masks;
+    size_t n = size < 64 ? size : 64;
+    for (size_t i = 0; i < n; ++i)
+    {
+        masks.quotes |= static_cast<uint64_t>(data[i] == '"') << i;
+        masks.commas |= static_cast<uint64_t>(data[i] == ',') << i;
+        masks.newlines |= static_cast<uint64_t>(data[i] == '\n') << i;
+    }
+    return masks;
+}
+
+void compareInt32(const int32_t* values, size_t count, CompareOp op,
+                  int32_t value, uint64_t* mask)
+{
+    compareInt32(values, count, op, value, mask, detectLevel());
+}
+
+void compareInt32(const int32_t* values, size_t count, CompareOp op,
+                  int32_t value, uint64_t* mask, Level level)
+{
+    // never run a kernel the CPU does not have
+    if (level > detectLevel())
+    {
+        level = detectLevel();
+    }
+    switch (op)
+    {
+    case CompareOp::Equal:
+        return compareAt<CompareOp::Equal>(values, count, value, mask, level);
+    case CompareOp::NotEqual:
+        return compareAt<CompareOp::NotEqual>(values, count, value, mask,
+                                              level);
+    case CompareOp::Less:
+        return compareAt<CompareOp::Less>(values, count, value, mask, level);
+    case CompareOp::LessEqual:
+        return compareAt<CompareOp::LessEqual>(values, count, value, mask,
+                                               level);
+    case CompareOp::Greater:
+        return compareAt<CompareOp::Greater>(values, count, value, mask,
+                                             level);
+    case CompareOp::GreaterEqual:
+        return compareAt<CompareOp::GreaterEqual>(values, count, value, mask,
+                                                  level);
+    }
+}
+
+void compareBool(const uint64_t* words, size_t count, CompareOp op, bool value,
+                 uint64_t* mask)
+{
+    // false < true, so every op is either the bits, their negation or a
+    // constant
+    enum
+    {
+        Bits,
+        Inverted,
+        None,
+        All
+    } kind;
+    switch (op)
+    {
+    case CompareOp::Equal:
+        kind = value ? Bits : Inverted;
+        break;
+    case CompareOp::NotEqual:
+        kind = value ? Inverted : Bits;
+        break;
+    case CompareOp::Less:
+        kind = value ? Inverted : None;
+        break;
+    case CompareOp::LessEqual:
+        kind = value ? All : Inverted;
+        break;
+    case CompareOp::Greater:
+        kind = value ? None : Bits;
+        break;
+    default:
+        kind = value ? Bits : All;
+        break;
+    }
+
+    size_t wordCount = maskWords(count);
+    for (size_t i = 0; i < wordCount; ++i)
+    {
+        switch (kind)
+        {
+        case Bits:
+            mask[i] = words[i];
+            break;
+        case Inverted:
+            mask[i] = ~words[i];
+            break;
+        case None:
+            mask[i] = 0;
+            break;
+        case All:
+            mask[i] = ~uint64_t{ 0 };
+            break;
+        }
+    }
+    if (count % 64)
+    {
+        mask[wordCount - 1] &= (uint64_t{ 1 } << (count % 64)) - 1;
+    }
+}
+
+} // namespace simd
+
+} // namespace db
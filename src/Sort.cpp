@@ -0,0 +1,370 @@
+#include "Sort.hpp"
+#include "DataBaseException.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <queue>
+#include <string_view>
+
+namespace db
+{
+
+namespace sort
+{
+
+namespace
+{
+
+// The first sort key squeezed into an integer that orders the same way,
+// plus the position of the row in the input. Comparing entries mostly
+// touches this array, the columns are only read for ties.
+struct Entry
+{
+    uint64_t key;
+    uint64_t pos;
+};
+
+uint64_t prefixOf(const storage::ColumnData& data, size_t row)
+{
+    switch (data.getColumnType())
+    {
+    case columns::ColumType::Integer:
+    case columns::ColumType::Id:
+    {
+        auto value = static_cast<const storage::IntegerData&>(data).at(row);
+        return static_cast<uint32_t>(value) ^ 0x80000000u;
+    }
+    case columns::ColumType::Bool:
+        return static_cast<const storage::BoolData&>(data).at(row) ? 1 : 0;
+    case columns::ColumType::String:
+    case columns::ColumType::Bytes:
+    {
+        // first 8 bytes, big endian, so unsigned order is byte order
+        auto value = static_cast<const storage::VarlenData&>(data).at(row);
+        uint64_t key = 0;
+        for (size_t i = 0; i < 8; ++i)
+        {
+            key <<= 8;
+            if (i < value.size())
+            {
+                key |= static_cast<unsigned char>(value[i]);
+            }
+        }
+        return key;
+    }
+    default:
+        throw DatabaseException("Sort: unsupported column type");
+    }
+}
+
+int compareValues(const storage::ColumnData& data, size_t left, size_t right)
+{
+    switch (data.getColumnType())
+    {
+    case columns::ColumType::Integer:
+    case columns::ColumType::Id:
+    {
+        auto&& ints = static_cast<const storage::IntegerData&>(data);
+        auto l = ints.at(left);
+        auto r = ints.at(right);
+        return l < r ? -1 : (r < l ? 1 : 0);
+    }
+    case columns::ColumType::Bool:
+    {
+        auto&& bools = static_cast<const storage::BoolData&>(data);
+        return static_cast<int>(bools.at(left)) -
+               static_cast<int>(bools.at(right));
+    }
+    default:
+    {
+        auto&& varlen = static_cast<const storage::VarlenData&>(data);
+        int cmp = varlen.at(left).compare(varlen.at(right));
+        return cmp < 0 ? -1 : (cmp > 0 ? 1 : 0);
+    }
+    }
+}
+
+class EntryLess
+{
+
+public:
+    EntryLess(const storage::ColumnStore& store,
+              const std::vector<BoundKey>& keys,
+              const std::vector<size_t>& rows)
+        : store_(store), keys_(keys), rows_(rows)
+    {
+        auto type = store.column(keys.front().column).getColumnType();
+        // integer and bool prefixes hold the whole value
+        firstExact_ = type != columns::ColumType::String &&
+                      type != columns::ColumType::Bytes;
+    }
+
+    bool operator()(const Entry& left, const Entry& right) const
+    {
+        if (left.key != right.key)
+        {
+            return left.key < right.key;
+        }
+        for (size_t i = firstExact_ ? 1 : 0; i < keys_.size(); ++i)
+        {
+            int cmp = compareValues(store_.column(keys_[i].column),
+                                    rows_[left.pos], rows_[right.pos]);
+            if (cmp != 0)
+            {
+                return keys_[i].descending ? cmp > 0 : cmp < 0;
+            }
+        }
+        return left.pos < right.pos;
+    }
+
+private:
+    const storage::ColumnStore& store_;
+    const std::vector<BoundKey>& keys_;
+    const std::vector<size_t>& rows_;
+    bool firstExact_;
+};
+
+// Sorted runs spilled to disk, removed again when the sort is done
+class SpillFiles
+{
+
+public:
+    explicit SpillFiles(std::filesystem::path directory)
+        : directory_(directory.empty() ? std::filesystem::temp_directory_path()
+                                       : std::move(directory))
+    {
+    }
+
+    SpillFiles(const SpillFiles&) = delete;
+
+    ~SpillFiles()
+    {
+        for (auto&& path : paths_)
+        {
+            std::error_code ignored;
+            std::filesystem::remove(path, ignored);
+        }
+    }
+
+public:
+    void write(const Entry* entries, size_t count)
+    {
+        static std::atomic<uint64_t> nextId{ 0 };
+        auto path = directory_ / ("small-sql-sort-" +
+                                  std::to_string(reinterpret_cast<uintptr_t>(
+                                      this)) +
+                                  "-" + std::to_string(nextId++) + ".run");
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            throw DatabaseException("Sort: cannot create spill file " +
+                                    path.string());
+        }
+        paths_.push_back(path);
+        file.write(reinterpret_cast<const char*>(entries),
+                   static_cast<std::streamsize>(count * sizeof(Entry)));
+        if (!file)
+        {
+            throw DatabaseException("Sort: cannot write spill file " +
+                                    path.string());
+        }
+    }
+
+    const std::vector<std::filesystem::path>& paths() const
+    {
+        return paths_;
+    }
+
+private:
+    std::filesystem::path directory_;
+    std::vector<std::filesystem::path> paths_{};
+};
+
+// Reads one run back a buffer at a time
+class RunReader
+{
+
+public:
+    RunReader(const std::filesystem::path& path, size_t bufferEntries)
+        : file_(path, std::ios::binary), buffer_(std::max<size_t>(1, bufferEntries))
+    {
+        if (!file_)
+        {
+            throw DatabaseException("Sort: cannot read spill file " +
+                                    path.string());
+        }
+        refill();
+    }
+
+public:
+    bool done() const
+    {
+        return pos_ == size_;
+    }
+
+    const Entry& current() const
+    {
+        return buffer_[pos_];
+    }
+
+    void advance()
+    {
+        if (++pos_ == size_)
+        {
+            refill();
+        }
+    }
+
+private:
+    void refill()
+    {
+        file_.read(reinterpret_cast<char*>(buffer_.data()),
+                   static_cast<std::streamsize>(buffer_.size() * sizeof(Entry)));
+        size_ = static_cast<size_t>(file_.gcount()) / sizeof(Entry);
+        pos_ = 0;
+    }
+
+private:
+    std::ifstream file_;
+    std::vector<Entry> buffer_;
+    size_t size_ = 0;
+    size_t pos_ = 0;
+};
+
+template <typename EntryAt>
+std::vector<size_t> externalSort(EntryAt entryAt, const EntryLess& less,
+                                 const std::vector<size_t>& rows,
+                                 size_t limit, const SortOptions& options)
+{
+    const size_t runEntries =
+        std::max<size_t>(1, options.memoryBudget / sizeof(Entry));
+
+    SpillFiles spill(options.spillDirectory);
+    {
+        std::vector<Entry> run;
+        run.reserve(runEntries);
+        for (size_t begin = 0; begin < rows.size(); begin += runEntries)
+        {
+            size_t end = std::min(rows.size(), begin + runEntries);
+            run.clear();
+            for (size_t pos = begin; pos < end; ++pos)
+            {
+                run.push_back(entryAt(pos));
+            }
+            std::sort(run.begin(), run.end(), less);
+            spill.write(run.data(), run.size());
+        }
+    }
+
+    // k-way merge, the budget is shared by the read buffers
+    std::vector<RunReader> readers;
+    readers.reserve(spill.paths().size());
+    for (auto&& path : spill.paths())
+    {
+        readers.emplace_back(path, runEntries / spill.paths().size());
+    }
+    auto greater = [&](size_t left, size_t right)
+    { return less(readers[right].current(), readers[left].current()); };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> heap(
+        greater);
+    for (size_t run = 0; run < readers.size(); ++run)
+    {
+        if (!readers[run].done())
+        {
+            heap.push(run);
+        }
+    }
+
+    std::vector<size_t> sorted;
+    sorted.reserve(std::min(limit, rows.size()));
+    while (!heap.empty() && sorted.size() < limit)
+    {
+        size_t run = heap.top();
+        heap.pop();
+        sorted.push_back(rows[readers[run].current().pos]);
+        readers[run].advance();
+        if (!readers[run].done())
+        {
+            heap.push(run);
+        }
+    }
+    return sorted;
+}
+
+} // namespace
+
+std::vector<size_t> sortRows(const storage::ColumnStore& store,
+                             const std::vector<BoundKey>& keys,
+                             std::vector<size_t> rows,
+                             std::optional<size_t> limit,
+                             const SortOptions& options)
+{
+    if (keys.empty() || rows.empty())
+    {
+        if (limit && *limit < rows.size())
+        {
+            rows.resize(*limit);
+        }
+        return rows;
+    }
+
+    auto&& first = store.column(keys.front().column);
+    auto entryAt = [&](size_t pos)
+    {
+        uint64_t key = prefixOf(first, rows[pos]);
+        return Entry{ keys.front().descending ? ~key : key, pos };
+    };
+    EntryLess less(store, keys, rows);
+    const size_t budget = options.memoryBudget / sizeof(Entry);
+    const size_t wanted = limit ? std::min(*limit, rows.size()) : rows.size();
+
+    std::vector<Entry> entries;
+    if (wanted < rows.size() && wanted <= budget)
+    {
+        // top-K: a max-heap holding the best `wanted` entries seen so far
+        entries.reserve(wanted + 1);
+        for (size_t pos = 0; pos < rows.size() && wanted != 0; ++pos)
+        {
+            Entry entry = entryAt(pos);
+            if (entries.size() < wanted)
+            {
+                entries.push_back(entry);
+                std::push_heap(entries.begin(), entries.end(), less);
+            }
+            else if (less(entry, entries.front()))
+            {
+                std::pop_heap(entries.begin(), entries.end(), less);
+                entries.back() = entry;
+                std::push_heap(entries.begin(), entries.end(), less);
+            }
+        }
+        std::sort_heap(entries.begin(), entries.end(), less);
+    }
+    else if (rows.size() > budget)
+    {
+        return externalSort(entryAt, less, rows, wanted, options);
+    }
+    else
+    {
+        entries.reserve(rows.size());
+        for (size_t pos = 0; pos < rows.size(); ++pos)
+        {
+            entries.push_back(entryAt(pos));
+        }
+        std::sort(entries.begin(), entries.end(), less);
+        entries.resize(wanted);
+    }
+
+    std::vector<size_t> sorted;
+    sorted.reserve(entries.size());
+    for (auto&& entry : entries)
+    {
+        sorted.push_back(rows[entry.pos]);
+    }
+    return sorted;
+}
+
+} // namespace sort
+
+} // namespace db
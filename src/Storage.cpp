@@ -0,0 +1,577 @@
+#include "Storage.hpp"
+#include "DataBaseException.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <variant>
+
+namespace db
+{
+
+namespace storage
+{
+
+namespace
+{
+
+constexpr size_t kIntegerIndex = 1;
+constexpr size_t kBoolIndex = 0;
+constexpr size_t kStringIndex = 2;
+constexpr size_t kBytesIndex = 3;
+
+int compareIndex(size_t own, size_t other)
+{
+    return own < other ? -1 : 1;
+}
+
+template <typename T>
+int threeWay(const T& lhs, const T& rhs)
+{
+    return lhs < rhs ? -1 : (rhs < lhs ? 1 : 0);
+}
+
+// blob bytes for `capacity` rows: room for values of the average length
+// after the `rows` stored
+size_t blobCapacity(size_t blobSize, size_t rows, size_t capacity)
+{
+    if (capacity <= rows)
+    {
+        return blobSize;
+    }
+    size_t average = std::max<size_t>(1, blobSize / std::max<size_t>(1, rows));
+    return blobSize + (capacity - rows) * average;
+}
+
+} // namespace
+
+// IntegerData
+
+void IntegerData::reserve(size_t capacity)
+{
+    values_.reserve(capacity);
+}
+
+void IntegerData::clear()
+{
+    values_.clear();
+}
+
+void IntegerData::push_back(const value_type& value)
+{
+    values_.push_back(std::get<element_type>(value));
+}
+
+bool IntegerData::fits(const value_type&) const
+{
+    return values_.size() < values_.capacity();
+}
+
+IntegerData::value_type IntegerData::get(size_t row) const
+{
+    return values_[row];
+}
+
+void IntegerData::set(size_t row, const value_type& value)
+{
+    values_[row] = std::get<element_type>(value);
+}
+
+int IntegerData::compare(size_t row, const value_type& value) const
+{
+    if (value.index() != kIntegerIndex)
+    {
+        return compareIndex(kIntegerIndex, value.index());
+    }
+    return threeWay(values_[row], std::get<element_type>(value));
+}
+
+void IntegerData::compact(const std::vector<bool>& keep)
+{
+    size_t out = 0;
+    for (size_t i = 0; i < values_.size(); ++i)
+    {
+        if (keep[i])
+        {
+            values_[out++] = values_[i];
+        }
+    }
+    values_.resize(out);
+}
+
+void IntegerData::writeBinary(binary::Writer& out, size_t rows) const
+{
+    out.bytes(values_.data(), rows * sizeof(element_type));
+}
+
+void IntegerData::readBinary(binary::Reader& in, size_t rows,
+                             size_t capacity)
+{
+    in.require(rows, sizeof(element_type));
+    values_.reserve(capacity);
+    values_.resize(rows);
+    in.bytes(values_.data(), rows * sizeof(element_type));
+}
+
+void IntegerData::mapBinary(binary::MappedReader& in, size_t rows,
+                            size_t capacity)
+{
+    auto [region, values] = in.take<element_type>(rows, capacity);
+    values_ = { std::move(region), values, rows, std::max(rows, capacity) };
+}
+
+void IntegerData::appendFrom(const ColumnData& other, size_t rows)
+{
+    auto values = static_cast<const IntegerData&>(other).values();
+    values_.append(values.data(), rows);
+}
+
+// BoolData
+
+void BoolData::reserve(size_t capacity)
+{
+    words_.reserve((capacity + kWordBits - 1) / kWordBits);
+}
+
+void BoolData::clear()
+{
+    words_.clear();
+    size_ = 0;
+}
+
+void BoolData::assign(size_t row, bool value)
+{
+    word_type mask = word_type{ 1 } << (row % kWordBits);
+    if (value)
+    {
+        words_[row / kWordBits] |= mask;
+    }
+    else
+    {
+        words_[row / kWordBits] &= ~mask;
+    }
+}
+
+void BoolData::push_back(const value_type& value)
+{
+    append(std::get<columns::Bool::value_type>(value));
+}
+
+bool BoolData::fits(const value_type&) const
+{
+    return size() % kWordBits != 0 || words_.size() < words_.capacity();
+}
+
+BoolData::value_type BoolData::get(size_t row) const
+{
+    return at(row);
+}
+
+void BoolData::set(size_t row, const value_type& value)
+{
+    assign(row, std::get<columns::Bool::value_type>(value));
+}
+
+int BoolData::compare(size_t row, const value_type& value) const
+{
+    if (value.index() != kBoolIndex)
+    {
+        return compareIndex(kBoolIndex, value.index());
+    }
+    return threeWay(at(row), std::get<columns::Bool::value_type>(value));
+}
+
+void BoolData::compact(const std::vector<bool>& keep)
+{
+    size_t out = 0;
+    for (size_t i = 0; i < size(); ++i)
+    {
+        if (keep[i])
+        {
+            assign(out++, at(i));
+        }
+    }
+    size_ = out;
+    words_.resize((out + kWordBits - 1) / kWordBits);
+}
+
+void BoolData::writeBinary(binary::Writer& out, size_t rows) const
+{
+    size_t words = rows / kWordBits;
+    out.bytes(words_.data(), words * sizeof(word_type));
+    if (rows % kWordBits != 0)
+    {
+        // bits past `rows` may belong to rows appended meanwhile
+        word_type last = std::atomic_ref(words_[words])
+                             .load(std::memory_order_relaxed) &
+                         ((word_type{ 1 } << (rows % kWordBits)) - 1);
+        out.pod(last);
+    }
+}
+
+void BoolData::readBinary(binary::Reader& in, size_t rows, size_t capacity)
+{
+    in.require((rows + kWordBits - 1) / kWordBits, sizeof(word_type));
+    words_.reserve((capacity + kWordBits - 1) / kWordBits);
+    words_.resize((rows + kWordBits - 1) / kWordBits);
+    in.bytes(words_.data(), words_.size() * sizeof(word_type));
+    size_ = rows;
+}
+
+void BoolData::mapBinary(binary::MappedReader& in, size_t rows,
+                         size_t capacity)
+{
+    size_t words = (rows + kWordBits - 1) / kWordBits;
+    size_t room = std::max(words, (capacity + kWordBits - 1) / kWordBits);
+    auto [region, values] = in.take<word_type>(words, room);
+    words_ = { std::move(region), values, words, room };
+    size_ = rows;
+}
+
+void BoolData::appendFrom(const ColumnData& other, size_t rows)
+{
+    auto&& bools = static_cast<const BoolData&>(other);
+    size_t row = 0;
+    if (size() % kWordBits == 0)
+    {
+        // word aligned, whole words can be copied
+        row = rows / kWordBits * kWordBits;
+        words_.append(bools.words_.data(), row / kWordBits);
+        size_ = size() + row;
+    }
+    for (; row < rows; ++row)
+    {
+        append(bools.at(row));
+    }
+}
+
+// VarlenData
+
+size_t VarlenData::alternative() const
+{
+    return type_ == columns::ColumType::Bytes ? kBytesIndex : kStringIndex;
+}
+
+std::string_view VarlenData::bytesOf(const value_type& value) const
+{
+    if (type_ == columns::ColumType::Bytes)
+    {
+        auto&& bytes = std::get<columns::Bytes::value_type>(value);
+        return { reinterpret_cast<const char*>(bytes.data()), bytes.size() };
+    }
+    return std::get<columns::String::value_type>(value);
+}
+
+void VarlenData::reserve(size_t capacity)
+{
+    offsets_.reserve(capacity);
+    lengths_.reserve(capacity);
+    blob_.reserve(blobCapacity(blob_.size(), size(), capacity));
+}
+
+void VarlenData::clear()
+{
+    offsets_.clear();
+    lengths_.clear();
+    blob_.clear();
+}
+
+void VarlenData::push_back(const value_type& value)
+{
+    append(bytesOf(value));
+}
+
+bool VarlenData::fits(const value_type& value) const
+{
+    return offsets_.size() < offsets_.capacity() &&
+           lengths_.size() < lengths_.capacity() &&
+           bytesOf(value).size() <= blob_.capacity() - blob_.size();
+}
+
+VarlenData::value_type VarlenData::get(size_t row) const
+{
+    auto bytes = at(row);
+    if (type_ == columns::ColumType::Bytes)
+    {
+        return columns::Bytes::value_type(bytes.begin(), bytes.end());
+    }
+    return columns::String::value_type(bytes);
+}
+
+void VarlenData::set(size_t row, const value_type& value)
+{
+    auto bytes = bytesOf(value);
+    if (bytes.size() > lengths_[row])
+    {
+        offsets_[row] = blob_.size();
+        blob_.append(bytes.data(), bytes.size());
+    }
+    else
+    {
+        std::copy(bytes.begin(), bytes.end(), blob_.data() + offsets_[row]);
+    }
+    lengths_[row] = static_cast<uint32_t>(bytes.size());
+}
+
+int VarlenData::compare(size_t row, const value_type& value) const
+{
+    if (value.index() != alternative())
+    {
+        return compareIndex(alternative(), value.index());
+    }
+    int result = at(row).compare(bytesOf(value));
+    return result < 0 ? -1 : (result > 0 ? 1 : 0);
+}
+
+void VarlenData::compact(const std::vector<bool>& keep)
+{
+    std::vector<char> blob;
+    blob.reserve(blob_.size());
+    size_t out = 0;
+    for (size_t i = 0; i < offsets_.size(); ++i)
+    {
+        if (!keep[i])
+        {
+            continue;
+        }
+        auto bytes = at(i);
+        offsets_[out] = blob.size();
+        lengths_[out] = lengths_[i];
+        blob.insert(blob.end(), bytes.begin(), bytes.end());
+        ++out;
+    }
+    offsets_.resize(out);
+    lengths_.resize(out);
+    blob_ = std::move(blob);
+}
+
+void VarlenData::writeBinary(binary::Writer& out, size_t rows) const
+{
+    uint64_t offset = 0;
+    for (size_t row = 0; row < rows; ++row)
+    {
+        out.pod(offset);
+        offset += lengths_[row];
+    }
+    out.bytes(lengths_.data(), rows * sizeof(uint32_t));
+    out.align();
+    for (size_t row = 0; row < rows; ++row)
+    {
+        auto bytes = at(row);
+        out.bytes(bytes.data(), bytes.size());
+    }
+}
+
+void VarlenData::readBinary(binary::Reader& in, size_t rows,
+                            size_t capacity)
+{
+    in.require(rows, sizeof(uint64_t) + sizeof(uint32_t));
+    offsets_.reserve(capacity);
+    offsets_.resize(rows);
+    in.bytes(offsets_.data(), rows * sizeof(uint64_t));
+    lengths_.reserve(capacity);
+    lengths_.resize(rows);
+    in.bytes(lengths_.data(), rows * sizeof(uint32_t));
+    in.align();
+    blob_.reserve(blobCapacity(in.remaining(), rows, capacity));
+    blob_.resize(in.remaining());
+    in.bytes(blob_.data(), blob_.size());
+    checkRanges();
+}
+
+void VarlenData::mapBinary(binary::MappedReader& in, size_t rows,
+                           size_t capacity)
+{
+    in.require(rows, sizeof(uint64_t) + sizeof(uint32_t));
+    capacity = std::max(rows, capacity);
+    auto [offsetRegion, offsets] = in.take<uint64_t>(rows, capacity);
+    offsets_ = { std::move(offsetRegion), offsets, rows, capacity };
+    auto [lengthRegion, lengths] = in.take<uint32_t>(rows, capacity);
+    lengths_ = { std::move(lengthRegion), lengths, rows, capacity };
+    in.align();
+    size_t blobSize = in.remaining();
+    size_t blobRoom = blobCapacity(blobSize, rows, capacity);
+    auto [blobRegion, blob] = in.take<char>(blobSize, blobRoom);
+    blob_ = { std::move(blobRegion), blob, blobSize, blobRoom };
+    // touches the offsets and lengths, the values are paged in on demand
+    checkRanges();
+}
+
+void VarlenData::appendFrom(const ColumnData& other, size_t rows)
+{
+    auto&& varlen = static_cast<const VarlenData&>(other);
+    reserve(size() + rows);
+    for (size_t row = 0; row < rows; ++row)
+    {
+        append(varlen.at(row));
+    }
+}
+
+void VarlenData::checkRanges() const
+{
+    // the block may end in padding, but every value has to be inside
+    for (size_t row = 0; row < size(); ++row)
+    {
+        if (offsets_[row] > blob_.size() ||
+            lengths_[row] > blob_.size() - offsets_[row])
+        {
+            throw DatabaseException("Corrupt table file: value out of range");
+        }
+    }
+}
+
+std::unique_ptr<ColumnData> makeColumnData(columns::ColumType type)
+{
+    switch (type)
+    {
+    case columns::ColumType::Integer:
+    case columns::ColumType::Id:
+        return std::make_unique<IntegerData>(type);
+    case columns::ColumType::Bool:
+        return std::make_unique<BoolData>();
+    case columns::ColumType::String:
+    case columns::ColumType::Bytes:
+        return std::make_unique<VarlenData>(type);
+    default:
+        throw DatabaseException("Storage: Unknown column type");
+    }
+}
+
+// ColumnStore
+
+void ColumnStore::addColumn(columns::ColumType type)
+{
+    auto data = makeColumnData(type);
+    if (rows_)
+    {
+        throw DatabaseException("Storage: Cannot add column to a filled table");
+    }
+    columns_.push_back(std::move(data));
+}
+
+void ColumnStore::reserve(size_t rows)
+{
+    for (auto&& column : columns_)
+    {
+        column->reserve(rows);
+    }
+}
+
+void ColumnStore::append(const RowValues& values)
+{
+    if (values.size() != columns_.size())
+    {
+        throw DatabaseException("Storage: Invalid amount of values: " +
+                                std::to_string(values.size()) + "/" +
+                                std::to_string(columns_.size()));
+    }
+    for (size_t i = 0; i < columns_.size(); ++i)
+    {
+        columns_[i]->push_back(values[i]);
+    }
+    ++rows_;
+}
+
+bool ColumnStore::fits(const RowValues& values) const
+{
+    for (size_t i = 0; i < columns_.size(); ++i)
+    {
+        if (!columns_[i]->fits(values[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+ColumnStore::RowValues ColumnStore::read(size_t row) const
+{
+    RowValues values;
+    values.reserve(columns_.size());
+    for (auto&& column : columns_)
+    {
+        values.push_back(column->get(row));
+    }
+    return values;
+}
+
+void ColumnStore::erase(const std::vector<bool>& keep)
+{
+    for (auto&& column : columns_)
+    {
+        column->compact(keep);
+    }
+    rows_ = static_cast<size_t>(std::count(keep.begin(), keep.end(), true));
+}
+
+ColumnStore ColumnStore::emptyCopy() const
+{
+    ColumnStore copy;
+    for (auto&& column : columns_)
+    {
+        copy.addColumn(column->getColumnType());
+    }
+    return copy;
+}
+
+void ColumnStore::append(const ColumnStore& other, size_t rows)
+{
+    for (size_t i = 0; i < columns_.size(); ++i)
+    {
+        columns_[i]->appendFrom(*other.columns_[i], rows);
+    }
+    rows_ += rows;
+}
+
+void ColumnStore::clear()
+{
+    for (auto&& column : columns_)
+    {
+        column->clear();
+    }
+    rows_ = 0;
+}
+
+void ColumnStore::reset()
+{
+    columns_.clear();
+    rows_ = 0;
+}
+
+void ColumnStore::writeBinary(binary::Writer& out, size_t rows) const
+{
+    for (auto&& column : columns_)
+    {
+        out.beginBlock(static_cast<uint32_t>(column->getColumnType()));
+        column->writeBinary(out, rows);
+        out.endBlock();
+    }
+}
+
+void ColumnStore::readBinary(binary::Reader& in, size_t rows,
+                             size_t capacity)
+{
+    for (auto&& column : columns_)
+    {
+        in.beginBlock(static_cast<uint32_t>(column->getColumnType()));
+        column->readBinary(in, rows, capacity);
+        in.endBlock();
+    }
+    rows_ = rows;
+}
+
+void ColumnStore::mapBinary(binary::MappedReader& in, size_t rows,
+                            size_t capacity)
+{
+    for (auto&& column : columns_)
+    {
+        in.beginBlock(static_cast<uint32_t>(column->getColumnType()));
+        column->mapBinary(in, rows, capacity);
+        in.endBlock();
+    }
+    rows_ = rows;
+}
+
+} // namespace storage
+
+} // namespace db
@@ -1,64 +1,88 @@
 #include "Table.hpp"
 #include "Column.hpp"
+#include "CsvReader.hpp"
+#include "CsvWriter.hpp"
 #include "DataBaseException.hpp"
 #include "Filter.hpp"
 #include "Helpers.hpp"
+#include "Storage.hpp"
+#include "Wal.hpp"
 
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <exception>
 #include <filesystem>
 #include <fstream>
+#include <future>
+#include <limits>
 #include <iostream>
 #include <memory>
+#include <numeric>
 #include <ranges>
+#include <span>
+#include <spanstream>
+#include <sstream>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <variant>
 #include <vector>
 
 db::Table::Table(const std::string& name, std::vector<ColumnType> values)
 {
     tableName_ = name;
-    size_t fieldIdx = 0;
     for (auto&& column : values)
     {
-        columns_.push_back(column);
-        columnMap_[column->name()] = column;
-        recordMapping_[column->name()] = fieldIdx++;
-        if (column->isKey())
-        {
-            keyColumn_ = column;
-        }
-        if (column->isUnique())
-        {
-            uniquieColumns_.push_back(column);
-        }
-        if (column->isIndex())
-        {
-            indexColumns_.push_back(column);
-            orderedIndexes_[column->name()] = {};
-        }
-        if (column->isAutoIncrement())
-        {
-            autoIncrementColumnsMap_[column->name()] = 0;
-        }
-        if (column->hasDefault())
-        {
-            defaultColumns_.push_back(column);
-        }
+        addColumn(column);
     }
     if (uniquieColumns_.empty())
     {
-        auto&& idField = db::columns::Id();
-        auto&& sharedIdField = std::make_shared<columns::Id>(idField);
-        columns_.push_back(sharedIdField);
-        columnMap_[idField.name()] = sharedIdField;
-        recordMapping_[idField.name()] = fieldIdx++;
-        autoIncrementColumnsMap_[idField.name()] = 0;
-        uniquieColumns_.push_back(sharedIdField);
-        keyColumn_ = sharedIdField;
+        addColumn(std::make_shared<columns::Id>());
+    }
+}
+
+db::Table::~Table()
+{
+    invalidateViews();
+}
+
+void db::Table::invalidateViews()
+{
+    ++*version_;
+}
+
+void db::Table::addColumn(ColumnType column)
+{
+    generation_->store.addColumn(column->getColumnType());
+    recordMapping_[column->name()] = columns_.size();
+    columns_.push_back(column);
+    columnMap_[column->name()] = column;
+    if (column->isKey())
+    {
+        keyColumn_ = column;
+    }
+    if (column->isUnique())
+    {
+        uniquieColumns_.push_back(column);
+        uniqueIndexes_[column->name()] = {};
+    }
+    if (column->isIndex())
+    {
+        indexColumns_.push_back(column);
+        orderedIndexes_[column->name()] = {};
+    }
+    if (column->isAutoIncrement())
+    {
+        autoIncrementColumnsMap_[column->name()] = 0;
+    }
+    if (column->hasDefault())
+    {
+        defaultColumns_.push_back(column);
     }
 }
 
-void db::Table::validateInsertion(InsertType& mappedRecord)
+void db::Table::validateInsertion(const InsertType& mappedRecord)
 {
     if (mappedRecord.size() > columnMap_.size())
     {
@@ -81,431 +105,2089 @@ void db::Table::validateInsertion(InsertType& mappedRecord)
                                  ": Autoincrement column: " + name +
                                  " cannot be inserted!");
         }
-        // TODO: Additional checks?
+        auto columnType = it->second->getColumnType();
+        if (columnType == columns::ColumType::Id)
+        {
+            columnType = columns::ColumType::Integer;
+        }
+        if (columns::BaseColumn::getValueColumnType(value) != columnType)
+        {
+            throw TableException("Insert " + tableName_ +
+                                 ": Invalid value type for column: " + name +
+                                 "!");
+        }
     }
 }
 
-void db::Table::buildRecord(Record& newRecord, InsertType& mappedRecord)
+void db::Table::buildRecord(RowValues& newRecord, InsertType& mappedRecord)
 {
 
     // Firstly, construct default object
 
+    newRecord.resize(columns_.size());
     for (auto&& column : defaultColumns_)
     {
-        Record::Row newRow;
-        newRow.type = column->getColumnType();
-        newRow.size = column->getValueSize();
-        newRow.rowData = column->getDefaultValue();
+        newRecord[recordMapping_.at(column->name())] = column->getDefaultValue();
     }
 
     // Rewrite defaults with existing values
 
     for (auto&& [name, value] : mappedRecord)
     {
-        Record::Row newRow;
-        newRow.type = columns::BaseColumn::getValueColumnType(value);
-        newRow.size = columnMap_[name]->getValueSize();
-        newRow.rowData = value;
-        newRecord.rows[recordMapping_[name]] = newRow;
+        newRecord[recordMapping_.at(name)] = value;
     }
     for (auto&& [name, value] : autoIncrementColumnsMap_)
     {
-        Record::Row newRow;
-        newRow.size = columnMap_[name]->getValueSize();
-        newRow.rowData = value;
-        newRow.type = columns::BaseColumn::getValueColumnType(value);
+        newRecord[recordMapping_.at(name)] = value;
         autoIncrementColumnsMap_[name]++;
-        newRecord.rows[recordMapping_[name]] = newRow;
     }
 }
 
-void db::Table::validateRecord(std::shared_ptr<Record> newRecord)
+db::Table::UniqueBindings db::Table::bindUniqueIndexes()
+{
+    UniqueBindings bindings;
+    bindings.reserve(uniquieColumns_.size());
+    for (auto&& uniqueField : uniquieColumns_)
+    {
+        bindings.emplace_back(recordMapping_.at(uniqueField->name()),
+                              &uniqueIndexes_.at(uniqueField->name()));
+    }
+    return bindings;
+}
+
+void db::Table::validateRecord(const RowValues& newRecord,
+                               const UniqueBindings& uniques)
 {
-    for (auto&& record : records_)
+    for (auto&& [column, index] : uniques)
     {
-        for (auto&& uniqueField : uniquieColumns_)
+        if (index->contains(newRecord[column]))
         {
-            if (record.rows[recordMapping_[uniqueField->name()]].rowData ==
-                newRecord->rows[recordMapping_[uniqueField->name()]].rowData)
-            {
-                throw TableException(
-                    "Insert " + tableName_ +
-                    ": Constraint unique field: " + uniqueField->name() + "!");
-            }
+            throw TableException("Insert " + tableName_ +
+                                 ": Constraint unique field: " +
+                                 columns_[column]->name() + "!");
         }
     }
 }
 
-void db::Table::createIndexes(std::shared_ptr<Record> sharedRecord)
+void db::Table::addUniqueKeys(const RowValues& newRecord,
+                              const UniqueBindings& uniques)
 {
-    for (auto&& [key, map] : orderedIndexes_)
+    for (auto&& [column, index] : uniques)
     {
-        auto&& indexVal = sharedRecord->rows[recordMapping_[key]].rowData;
-        auto ptrCopy = sharedRecord;
-        map.insert(std::make_pair<columns::BaseColumn::value_type,
-                                  std::shared_ptr<Record>>(std::move(indexVal),
-                                                           std::move(ptrCopy)));
+        addUniqueKey(*index, newRecord[column]);
     }
 }
 
-void db::Table::insertImpl(InsertType mappedRecord)
+void db::Table::addUniqueKey(UniqueIndex& index, const value_type& value)
 {
+    index.insert(value);
+    batch_->keys_.emplace_back(&index, value, true);
+}
 
-    Record newRecord{ mappedRecord.size() + autoIncrementColumnsMap_.size() };
-
-    buildRecord(newRecord, mappedRecord);
-
-    auto shared = std::make_shared<Record>(newRecord);
-
-    validateRecord(shared);
-
-    // Add to our table data
-    records_.push_back(newRecord);
-
-    // Make indexes
-    // createIndexes(shared);
+void db::Table::eraseUniqueKey(UniqueIndex& index, const value_type& value)
+{
+    if (index.erase(value) != 0)
+    {
+        batch_->keys_.emplace_back(&index, value, false);
+    }
 }
 
-void printVal(db::Table::value_type val)
+void db::Table::indexNewRows()
 {
-    if (std::holds_alternative<db::columns::Integer::value_type>(val))
+    auto&& generation = *generation_;
+    size_t rows = generation.store.rowCount();
+    std::unique_lock lock(indexMutex_);
+    // one pass over the batch for all indexes; versions it ended itself
+    // are never visible and stay out
+    std::vector<std::pair<OrderedIndex*, size_t>> indexes;
+    for (auto&& [key, map] : orderedIndexes_)
     {
-        std::cout << std::to_string(std::get<int>(val));
+        indexes.emplace_back(&map, recordMapping_.at(key));
     }
-    else if (std::holds_alternative<db::columns::Bool::value_type>(val))
+    for (size_t row = indexedRows_; row < rows && !indexes.empty(); ++row)
     {
-        std::cout << (std::get<db::columns::Bool::value_type>(val) ? "1" : "0");
+        if (generation.ended[row].load(std::memory_order_relaxed) != kLive)
+        {
+            continue;
+        }
+        for (auto&& [map, column] : indexes)
+        {
+            map->emplace(generation.store.column(column).get(row), row);
+        }
     }
-    else if (std::holds_alternative<db::columns::String::value_type>(val))
+    indexedRows_ = rows;
+}
+
+void db::Table::eraseFromIndexes(const std::vector<bool>& keep)
+{
+    // row ids shift down by the number of deleted rows before them
+    std::vector<size_t> newRowIds(keep.size());
+    size_t next = 0;
+    for (size_t row = 0; row < keep.size(); ++row)
     {
-        std::cout << std::get<db::columns::String::value_type>(val);
+        newRowIds[row] = next;
+        next += keep[row];
     }
-    else if (std::holds_alternative<db::columns::Bytes::value_type>(val))
+    for (auto&& [key, map] : orderedIndexes_)
     {
-        for (auto&& b : std::get<db::columns::Bytes::value_type>(val))
+        for (auto it = map.begin(); it != map.end();)
         {
-            std::cout << b;
+            if (keep[it->second])
+            {
+                it->second = newRowIds[it->second];
+                ++it;
+            }
+            else
+            {
+                it = map.erase(it);
+            }
         }
     }
 }
 
-void db::Table::insert(InsertType mappedRecord)
+db::Table::OrderedIndex db::Table::buildIndex(size_t columnIdx) const
 {
-#if DEBUG
-    std::cout << "New iserion: to table " + tableName_ + ": ";
-    for (auto&& [key, val] : mappedRecord)
+    auto&& data = getStorage().column(columnIdx);
+    std::vector<std::pair<value_type, size_t>> entries;
+    entries.reserve(data.size());
+    for (size_t row = 0; row < data.size(); ++row)
     {
-        std::cout << "{" << key << ", ";
-        printVal(val);
-        std::cout << "} ";
+        entries.emplace_back(data.get(row), row);
     }
-    std::cout << std::endl;
-#endif
-
-    validateInsertion(mappedRecord);
+    // stable, so equal keys stay in row order like incremental inserts do
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](auto&& lhs, auto&& rhs)
+                     { return lhs.first < rhs.first; });
 
-    insertImpl(mappedRecord);
-};
-
-void db::Table::View::print()
-{
-    std::cout << "Table #" + tableName_ << std::endl;
-    for (auto&& [column, _] : recordMapping)
+    OrderedIndex index;
+    for (auto&& [value, row] : entries)
     {
-        std::cout << column << " ";
+        index.emplace_hint(index.end(), std::move(value), row);
     }
-    std::cout << std::endl;
+    return index;
+}
 
-    for (auto&& recordPtr : recordPtrs)
+db::Table::UniqueIndex db::Table::buildUniqueIndex(size_t columnIdx) const
+{
+    auto&& data = getStorage().column(columnIdx);
+    UniqueIndex index;
+    index.reserve(data.size());
+    for (size_t row = 0; row < data.size(); ++row)
     {
-        for (auto&& [column, pos] : recordMapping)
-        {
-            printVal(recordPtr->rows[pos].rowData);
-            std::cout << " ";
-        }
-        std::cout << std::endl;
+        index.insert(data.get(row));
     }
+    return index;
 }
 
-std::unique_ptr<db::Table::View>
-db::Table::select(std::vector<std::string>& selectList,
-                  std::unique_ptr<filters::Filter> filter)
+void db::Table::collectIndexBuilds(bool wait)
 {
-    RecordMappingT viewMapping{};
-    if (selectList.size())
+    if (!indexesPending_ && (!wait || pendingUniqueIndexes_.empty()))
+    {
+        return;
+    }
+    std::unique_lock lock(indexMutex_, std::defer_lock);
+    if (wait)
     {
-        for (auto&& s : selectList)
         {
-            viewMapping[s] = recordMapping_[s];
+            // queries go on with the indexes they have meanwhile
+            std::shared_lock building(indexMutex_);
+            for (auto&& [_, build] : pendingIndexes_)
+            {
+                build.wait();
+            }
+        }
+        for (auto&& [_, build] : pendingUniqueIndexes_)
+        {
+            build.wait();
         }
+        lock.lock();
     }
-    else
+    else if (!lock.try_lock())
     {
-        viewMapping = recordMapping_;
+        return;
     }
-    View result{ tableName_, columns_, viewMapping };
-    for (auto&& record : records_)
+
+    for (auto it = pendingIndexes_.begin(); it != pendingIndexes_.end();)
+    {
+        auto&& [name, build] = *it;
+        if (!wait &&
+            build.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            ++it;
+            continue;
+        }
+        orderedIndexes_[name] = build.get();
+        it = pendingIndexes_.erase(it);
+    }
+    // only writers use unique indexes, and every writer waits
+    if (wait)
     {
-        if (filter.get() == nullptr || filter->matches(record, *this))
+        for (auto&& [name, build] : pendingUniqueIndexes_)
         {
-            result.recordPtrs.push_back(std::make_shared<Record>(record));
+            uniqueIndexes_[name] = build.get();
         }
+        pendingUniqueIndexes_.clear();
     }
-    return std::make_unique<db::Table::View>(result);
+    indexesPending_ = !pendingIndexes_.empty();
 }
 
-void db::Table::update(std::unique_ptr<filters::Filter> filter,
-                       InsertType newValues)
+bool db::Table::hasIndex(const std::string& name) const
 {
-    validateInsertion(newValues);
-    for (auto&& record : records_)
+    std::shared_lock lock(indexMutex_);
+    return orderedIndexes_.contains(name);
+}
+
+namespace
+{
+
+// Bounds on one indexed column collected from the conjuncts of a filter
+struct KeyRange
+{
+    const db::Table::value_type* lower = nullptr;
+    bool lowerInclusive = true;
+    const db::Table::value_type* upper = nullptr;
+    bool upperInclusive = true;
+
+    void tightenLower(const db::Table::value_type& value, bool inclusive)
     {
-        if (filter->matches(record, *this))
+        if (lower == nullptr || value > *lower ||
+            (value == *lower && !inclusive))
         {
-            for (auto [key, val] : newValues)
-            {
-                if (columnMap_[key]->isUnique())
-                {
-                    for (auto&& another : records_)
-                    {
-                        if (another.rows[recordMapping_[key]].rowData == val)
-                        {
-                            throw DatabaseException(
-                                "Unique constraint failed in field " + key);
-                        }
-                    }
-                }
-                record.rows[recordMapping_[key]].rowData = val;
-            }
+            lower = &value;
+            lowerInclusive = inclusive;
         }
     }
-}
 
-void db::Table::del(std::unique_ptr<filters::Filter> filter)
-{
-    for (auto b = records_.begin(); b != records_.end();)
+    void tightenUpper(const db::Table::value_type& value, bool inclusive)
     {
-        if (filter.get() == nullptr || filter->matches(*b, *this))
+        if (upper == nullptr || value < *upper ||
+            (value == *upper && !inclusive))
         {
-            b = records_.erase(b);
+            upper = &value;
+            upperInclusive = inclusive;
         }
-        else
+    }
+
+    bool isEmpty() const
+    {
+        return lower && upper &&
+               (*lower > *upper ||
+                (*lower == *upper && !(lowerInclusive && upperInclusive)));
+    }
+
+    // point lookups first, then two-sided and one-sided ranges
+    int selectivity() const
+    {
+        if (lower && upper)
         {
-            b++;
+            return *lower == *upper ? 3 : 2;
         }
+        return lower || upper ? 1 : 0;
     }
-}
+};
 
-void db::Table::serializeCSV(std::filesystem::path dataFilePath)
+void collectRanges(const db::filters::Filter& filter,
+                   const std::unordered_map<std::string, db::Table::OrderedIndex>&
+                       indexes,
+                   std::map<std::string, KeyRange>& ranges)
 {
-    std::ofstream file(dataFilePath);
-    if (!file.is_open())
+    using db::filters::ComparisonFilter;
+    using db::filters::LogicalFilter;
+
+    if (auto logical = dynamic_cast<const LogicalFilter*>(&filter))
     {
-        throw TableException("Failed to open file for writing: " +
-                             dataFilePath.string());
+        if (logical->op() == LogicalFilter::AND)
+        {
+            collectRanges(logical->left(), indexes, ranges);
+            collectRanges(logical->right(), indexes, ranges);
+        }
+        return;
+    }
+
+    auto comparison = dynamic_cast<const ComparisonFilter*>(&filter);
+    if (auto expression =
+            dynamic_cast<const db::filters::ExpressionFilter*>(&filter))
+    {
+        comparison = expression->lowered();
+    }
+    if (comparison == nullptr || !indexes.contains(comparison->fieldName()))
+    {
+        return;
     }
 
-    // table name
+    auto&& value = comparison->value();
+    switch (comparison->op())
+    {
+    case ComparisonFilter::EQUAL:
+        ranges[comparison->fieldName()].tightenLower(value, true);
+        ranges[comparison->fieldName()].tightenUpper(value, true);
+        break;
+    case ComparisonFilter::LESS_THAN:
+        ranges[comparison->fieldName()].tightenUpper(value, false);
+        break;
+    case ComparisonFilter::LESS_THAN_OR_EQUAL:
+        ranges[comparison->fieldName()].tightenUpper(value, true);
+        break;
+    case ComparisonFilter::GREATER_THAN:
+        ranges[comparison->fieldName()].tightenLower(value, false);
+        break;
+    case ComparisonFilter::GREATER_THAN_OR_EQUAL:
+        ranges[comparison->fieldName()].tightenLower(value, true);
+        break;
+    default:
+        break;
+    }
+}
 
-    file << "#TABLE_NAME" << std::endl;
-    file << tableName_ << std::endl;
+} // namespace
 
-    // columns separator
-    file << "#COLUMNS" << std::endl;
+std::optional<std::vector<size_t>>
+db::Table::indexScan(const filters::Filter& filter, const Snapshot& snapshot)
+{
+    std::shared_lock lock(indexMutex_);
+    std::map<std::string, KeyRange> ranges;
+    collectRanges(filter, orderedIndexes_, ranges);
 
-    // columns
-    for (const auto& column : columns_)
+    const std::string* bestColumn = nullptr;
+    const KeyRange* best = nullptr;
+    for (auto&& [name, range] : ranges)
+    {
+        if (best == nullptr || range.selectivity() > best->selectivity())
+        {
+            bestColumn = &name;
+            best = &range;
+        }
+    }
+    if (best == nullptr)
     {
-        columns::serializeCSV(file, column);
+        return std::nullopt;
     }
 
-    // data separator
-    file << "#DATA" << std::endl;
+    std::vector<size_t> rows;
+    if (best->isEmpty())
+    {
+        return rows;
+    }
 
-    // header for me
-    std::stringstream headerStream;
-    for (const auto& column : columns_)
+    auto&& index = orderedIndexes_[*bestColumn];
+    auto first = index.begin();
+    auto last = index.end();
+    if (best->lower)
     {
-        headerStream << escapeCSVField(column->name()) << ",";
+        first = best->lowerInclusive ? index.lower_bound(*best->lower)
+                                     : index.upper_bound(*best->lower);
     }
-    std::string headerLine = headerStream.str();
-    // remove comma
-    if (!headerLine.empty())
+    if (best->upper)
     {
-        headerLine.pop_back();
+        last = best->upperInclusive ? index.upper_bound(*best->upper)
+                                    : index.lower_bound(*best->upper);
     }
-    file << headerLine << std::endl;
-
-    // records
-    for (const auto& record : records_)
+    for (; first != last; ++first)
     {
-        for (size_t i = 0; i < record.rows.size(); i++)
+        if (first->second < snapshot.rows)
         {
-            auto&& row = record.rows[i];
-            std::string valueStr;
-            if (row.type == columns::ColumType::Bytes)
-            {
-                // bytes to hex
-                auto& bytes = std::get<columns::Bytes::value_type>(row.rowData);
-                valueStr = std::string(bytes.begin(), bytes.end());
-                valueStr = escapeCSVField(valueStr);
-            }
-            else if (row.type == columns::ColumType::String)
-            {
-                valueStr = escapeCSVField(
-                    std::get<columns::String::value_type>(row.rowData));
-            }
-            else if (row.type == columns::ColumType::Integer)
-            {
-                valueStr = std::to_string(
-                    std::get<columns::Integer::value_type>(row.rowData));
-            }
-            else if (row.type == columns::ColumType::Bool)
-            {
-                valueStr = (std::get<columns::Bool::value_type>(row.rowData)
-                                ? "true"
-                                : "false");
-            }
-            else if (row.type == columns::ColumType::Id)
-            {
-                valueStr = std::to_string(
-                    std::get<columns::Integer::value_type>(row.rowData));
-            }
-            file << valueStr;
-            if (i < record.rows.size() - 1){
-                file << ",";
-            }
+            rows.push_back(first->second);
         }
-        file << std::endl;
+    }
+    for (size_t row = indexedRows_; row < snapshot.rows; ++row)
+    {
+        rows.push_back(row);
     }
 
-    file.close();
+    // keep the table order of a full scan
+    std::sort(rows.begin(), rows.end());
+    return rows;
 }
 
-void db::Table::deserializeCSV(std::filesystem::path dataFilePath)
+db::Table::RowValues db::Table::insertImpl(InsertType mappedRecord)
 {
-    std::ifstream file(dataFilePath);
-    if (!file.is_open())
-    {
-        throw TableException("Failed to open file for reading: " +
-                             dataFilePath.string());
-    }
 
-    columns_.clear();
-    columnMap_.clear();
-    records_.clear();
-    recordMapping_.clear();
+    RowValues newRecord;
 
-    std::string line;
+    buildRecord(newRecord, mappedRecord);
 
-    // tableName
-    std::getline(file, line);
-    if (line != "#TABLE_NAME")
+    auto uniques = bindUniqueIndexes();
+    validateRecord(newRecord, uniques);
+
+    appendRecord(newRecord, uniques);
+    return newRecord;
+}
+
+void db::Table::appendRecord(const RowValues& newRecord,
+                             const UniqueBindings& uniques)
+{
+    // Add to our table data, ordered indexes follow at commit
+    appendVersion(newRecord);
+    addUniqueKeys(newRecord, uniques);
+}
+
+db::Table::Record db::Table::readRecord(size_t row) const
+{
+    Record record{ columns_.size() };
+    for (size_t i = 0; i < columns_.size(); ++i)
     {
-        throw TableException("CSV doesnt have table name separator.");
+        auto&& newRow = record.rows[i];
+        newRow.type = columns_[i]->getColumnType();
+        newRow.size = columns_[i]->getValueSize();
+        newRow.rowData = getStorage().column(i).get(row);
     }
-    std::getline(file, line);
-    tableName_ = line;
+    return record;
+}
 
-    // columns
-    std::getline(file, line);
-    if (line != "#COLUMNS")
+size_t db::Table::getColumnIndex(const std::string& name) const
+{
+    auto it = recordMapping_.find(name);
+    if (it == recordMapping_.end())
     {
-        throw TableException("CSV doesnt have columns separator.");
+        throw TableException("Table " + tableName_ +
+                             ": Unknown column: " + name + "!");
     }
-    while (std::getline(file, line))
+    return it->second;
+}
+
+void db::Table::forEachMorsel(
+    size_t count,
+    const std::function<void(size_t morsel, size_t begin, size_t end)>& task)
+{
+    size_t morsels = (count + kMorselSize - 1) / kMorselSize;
+    auto runMorsel = [&](size_t morsel)
     {
-        if (line == "#DATA")
-        {
-            break;
-        }
-        std::istringstream iss(line);
-        std::string columnLine = line;
-        // Use columns::deserializeCSV to read column definition
-        std::istringstream columnStream(columnLine);
-        auto column = columns::deserializeCSV(columnStream);
-        if (column)
-        {
-            columns_.push_back(column);
-            columnMap_[column->name()] = column;
-        }
-        else
-        {
-            throw TableException("Failed to deserialize column from CSV.");
-        }
-    }
+        size_t begin = morsel * kMorselSize;
+        task(morsel, begin, std::min(begin + kMorselSize, count));
+    };
 
-    // header
-    if (!std::getline(file, line))
+    if (workers_ && morsels > 1)
     {
-        throw TableException("No header row found in CSV data.");
+        workers_->parallelFor(morsels, runMorsel);
+        return;
     }
-    std::vector<std::string> columnNames = parseCSVLine(line);
-    if (columnNames.size() != columns_.size())
+    for (size_t morsel = 0; morsel < morsels; ++morsel)
     {
-        throw TableException(
-            "Missmatch between number of columns and header fields.");
+        runMorsel(morsel);
     }
+}
 
-    // record mapping
-    for (size_t i = 0; i < columnNames.size(); ++i)
+std::vector<size_t> db::Table::matchingRows(filters::Filter* filter,
+                                            const Snapshot& snapshot,
+                                            std::optional<size_t> needed)
+{
+    std::vector<size_t> rows;
+    const size_t wanted = needed.value_or(std::numeric_limits<size_t>::max());
+    if (filter == nullptr && snapshot.live == snapshot.rows)
     {
-        recordMapping_[columnNames[i]] = i;
+        rows.resize(std::min(snapshot.rows, wanted));
+        std::iota(rows.begin(), rows.end(), 0);
+        return rows;
     }
-
-    // records
-    while (std::getline(file, line))
+    if (filter == nullptr)
     {
-        std::vector<std::string> fieldValues = parseCSVLine(line);
-        if (fieldValues.size() != columns_.size())
+        for (size_t row = 0; row < snapshot.rows && rows.size() < wanted;
+             ++row)
         {
-            throw TableException(
-                "Missmatch between number of columns and data fields.");
+            if (visible(snapshot, row))
+            {
+                rows.push_back(row);
+            }
         }
+        return rows;
+    }
+    filter->bind(*this);
+    auto program = filters::Program::compile(*filter, *this);
 
-        Record record(columns_.size() + autoIncrementColumnsMap_.size());
+    // the index only narrows the scan, the whole filter still decides
+    auto candidates = indexScan(*filter, snapshot);
+    size_t total = candidates ? candidates->size() : snapshot.rows;
 
-        for (size_t i = 0; i < fieldValues.size(); ++i)
+    // filters [begin, end) of the scan into `part`, a batch at a time,
+    // until `part` holds `stopAt` rows
+    auto scan = [&](size_t begin, size_t end, std::vector<size_t>& part,
+                    size_t stopAt)
+    {
+        filters::Program::Registers registers;
+        filters::Selection selection;
+        selection.reserve(filters::kBatchSize);
+        for (size_t batch = begin; batch < end && part.size() < stopAt;
+             batch += filters::kBatchSize)
         {
-            auto& column = columns_[i];
-            Record::Row row;
-            row.type = column->getColumnType();
-            row.size = column->getValueSize();
-
-            std::string valueStr = fieldValues[i];
-            columns::ColumType colType = column->getColumnType();
-
-            if (colType == columns::ColumType::Integer ||
-                colType == columns::ColumType::Id)
+            size_t batchEnd = std::min(batch + filters::kBatchSize, end);
+            selection.clear();
+            for (size_t pos = batch; pos < batchEnd; ++pos)
             {
-                int value = std::stoi(valueStr);
-                row.rowData = value;
+                size_t row = candidates ? (*candidates)[pos] : pos;
+                if (visible(snapshot, row))
+                {
+                    selection.push_back(row);
+                }
             }
-            else if (colType == columns::ColumType::Bool)
+            program.filterBatch(selection, registers);
+            part.insert(part.end(), selection.begin(), selection.end());
+        }
+    };
+
+    // With a limit the first morsel is scanned on this thread, a small
+    // limit is usually met there. The rest goes in waves of one morsel per
+    // thread until enough rows matched.
+    size_t scanned = 0;
+    if (needed)
+    {
+        scanned = std::min(total, kMorselSize);
+        scan(0, scanned, rows, wanted);
+    }
+    const size_t wave =
+        needed ? (workers_ ? workers_->size() + 1 : 1) * kMorselSize : total;
+    while (scanned < total && rows.size() < wanted)
+    {
+        size_t count = std::min(wave, total - scanned);
+        std::vector<std::vector<size_t>> parts(
+            (count + kMorselSize - 1) / kMorselSize);
+        forEachMorsel(count,
+                      [&](size_t morsel, size_t begin, size_t end)
+                      {
+                          scan(scanned + begin, scanned + end, parts[morsel],
+                               wanted);
+                      });
+
+        // morsels are merged back in table order
+        for (auto&& part : parts)
+        {
+            rows.insert(rows.end(), part.begin(), part.end());
+        }
+        scanned += count;
+    }
+    if (rows.size() > wanted)
+    {
+        rows.resize(wanted);
+    }
+    return rows;
+}
+
+std::vector<size_t>
+db::Table::orderRows(std::vector<size_t> rows,
+                     const std::vector<sort::SortKey>& orderBy,
+                     std::optional<size_t> limit, const Snapshot& snapshot)
+{
+    std::vector<sort::BoundKey> keys;
+    for (auto&& key : orderBy)
+    {
+        keys.push_back({ getColumnIndex(key.column), key.descending });
+    }
+
+    // An index already holds the order. Walking it touches every row of the
+    // table, which beats sorting unless the filter kept only a few rows.
+    std::shared_lock lock(indexMutex_);
+    auto index = orderedIndexes_.find(orderBy.front().column);
+    bool fewRows = rows.size() * std::bit_width(rows.size()) < snapshot.rows;
+    if (keys.size() != 1 || index == orderedIndexes_.end() || fewRows)
+    {
+        lock.unlock();
+        return sort::sortRows(getStorage(), keys, std::move(rows), limit,
+                              sortOptions_);
+    }
+
+    // versions past the snapshot are in the index too
+    std::vector<bool> wanted(snapshot.rows, false);
+    for (auto row : rows)
+    {
+        wanted[row] = true;
+    }
+    const size_t count = limit ? std::min(*limit, rows.size()) : rows.size();
+    std::vector<size_t> sorted;
+    sorted.reserve(count);
+
+    // rows with equal keys keep table order, like the sort
+    auto emitGroup = [&](auto first, auto last)
+    {
+        size_t groupBegin = sorted.size();
+        for (; first != last; ++first)
+        {
+            if (first->second < wanted.size() && wanted[first->second])
             {
-                bool value = valueStr == "true";
-                row.rowData = value;
+                sorted.push_back(first->second);
             }
-            else if (colType == columns::ColumType::String)
+        }
+        std::sort(sorted.begin() + groupBegin, sorted.end());
+    };
+    auto&& map = index->second;
+    if (keys.front().descending)
+    {
+        for (auto it = map.end(); it != map.begin() && sorted.size() < count;)
+        {
+            auto last = it;
+            it = map.lower_bound(std::prev(it)->first);
+            emitGroup(it, last);
+        }
+    }
+    else
+    {
+        for (auto it = map.begin(); it != map.end() && sorted.size() < count;)
+        {
+            auto last = map.upper_bound(it->first);
+            emitGroup(it, last);
+            it = last;
+        }
+    }
+    sorted.resize(std::min(sorted.size(), count));
+    return sorted;
+}
+
+std::vector<size_t> db::Table::indexOrderedRows(filters::Filter* filter,
+                                                const sort::SortKey& key,
+                                                size_t needed,
+                                                const Snapshot& snapshot)
+{
+    std::optional<filters::Program> program;
+    if (filter)
+    {
+        filter->bind(*this);
+        program.emplace(filters::Program::compile(*filter, *this));
+    }
+    filters::Program::Registers registers;
+    filters::Selection selection;
+
+    // Index order is collected into batches. The program wants ascending
+    // row ids, so each batch is filtered sorted and the survivors are
+    // picked back out in index order.
+    std::vector<size_t> rows;
+    std::vector<size_t> pending;
+    pending.reserve(filters::kBatchSize);
+    auto flush = [&]
+    {
+        if (!program)
+        {
+            rows.insert(rows.end(), pending.begin(), pending.end());
+            pending.clear();
+            return;
+        }
+        selection.assign(pending.begin(), pending.end());
+        std::sort(selection.begin(), selection.end());
+        program->filterBatch(selection, registers);
+        for (auto row : pending)
+        {
+            if (std::binary_search(selection.begin(), selection.end(), row))
             {
-                row.rowData = valueStr;
+                rows.push_back(row);
             }
-            else if (colType == columns::ColumType::Bytes)
+        }
+        pending.clear();
+    };
+    // rows with equal keys keep table order, like the sort
+    auto emitGroup = [&](auto first, auto last)
+    {
+        size_t groupBegin = pending.size();
+        for (; first != last; ++first)
+        {
+            if (first->second < snapshot.rows &&
+                visible(snapshot, first->second))
             {
-                std::vector<uint8_t> bytes(valueStr.begin(), valueStr.end());
-                row.rowData = bytes;
+                pending.push_back(first->second);
             }
-            else
+        }
+        std::sort(pending.begin() + groupBegin, pending.end());
+        if (pending.size() >= filters::kBatchSize)
+        {
+            flush();
+        }
+    };
+
+    std::shared_lock lock(indexMutex_);
+    auto&& map = orderedIndexes_.at(key.column);
+    if (key.descending)
+    {
+        for (auto it = map.end(); it != map.begin() && rows.size() < needed;)
+        {
+            auto last = it;
+            it = map.lower_bound(std::prev(it)->first);
+            emitGroup(it, last);
+        }
+    }
+    else
+    {
+        for (auto it = map.begin(); it != map.end() && rows.size() < needed;)
+        {
+            auto last = map.upper_bound(it->first);
+            emitGroup(it, last);
+            it = last;
+        }
+    }
+    flush();
+    rows.resize(std::min(rows.size(), needed));
+    return rows;
+}
+
+void printVal(db::Table::value_type val)
+{
+    if (std::holds_alternative<db::columns::Integer::value_type>(val))
+    {
+        std::cout << std::to_string(std::get<int>(val));
+    }
+    else if (std::holds_alternative<db::columns::Bool::value_type>(val))
+    {
+        std::cout << (std::get<db::columns::Bool::value_type>(val) ? "1" : "0");
+    }
+    else if (std::holds_alternative<db::columns::String::value_type>(val))
+    {
+        std::cout << std::get<db::columns::String::value_type>(val);
+    }
+    else if (std::holds_alternative<db::columns::Bytes::value_type>(val))
+    {
+        for (auto&& b : std::get<db::columns::Bytes::value_type>(val))
+        {
+            std::cout << b;
+        }
+    }
+}
+
+void db::Table::insert(InsertType mappedRecord)
+{
+#if DEBUG
+    std::cout << "New iserion: to table " + tableName_ + ": ";
+    for (auto&& [key, val] : mappedRecord)
+    {
+        std::cout << "{" << key << ", ";
+        printVal(val);
+        std::cout << "} ";
+    }
+    std::cout << std::endl;
+#endif
+
+    Batch batch(*this);
+    batch.insert(std::move(mappedRecord));
+    batch.commit();
+};
+
+bool db::Table::View::isValid() const
+{
+    return !table_ || tableVersion_->load() == version_;
+}
+
+void db::Table::View::checkValid() const
+{
+    if (!isValid())
+    {
+        throw TableException("View of " + tableName_ +
+                             " is stale: the table was modified");
+    }
+}
+
+db::Table::value_type db::Table::View::value(size_t row, size_t column) const
+{
+    if (!table_)
+    {
+        return recordPtrs[row]->rows[column].rowData;
+    }
+    checkValid();
+    return table_->getStorage().column(column).get(rowIds[row]);
+}
+
+db::Table::value_type db::Table::View::value(size_t row,
+                                             const std::string& name) const
+{
+    auto it = recordMapping.find(name);
+    if (it == recordMapping.end())
+    {
+        throw TableException("View of " + tableName_ +
+                             ": Unknown column: " + name);
+    }
+    return value(row, it->second);
+}
+
+db::Table::Record db::Table::View::record(size_t row) const
+{
+    if (!table_)
+    {
+        return *recordPtrs[row];
+    }
+    checkValid();
+    return table_->readRecord(rowIds[row]);
+}
+
+void db::Table::View::print()
+{
+    std::cout << "Table #" + tableName_ << std::endl;
+    for (auto&& [column, _] : recordMapping)
+    {
+        std::cout << column << " ";
+    }
+    std::cout << std::endl;
+
+    for (size_t row = 0; row < size(); ++row)
+    {
+        for (auto&& [column, pos] : recordMapping)
+        {
+            printVal(value(row, pos));
+            std::cout << " ";
+        }
+        std::cout << std::endl;
+    }
+}
+
+db::Table::RecordMappingT
+db::Table::viewMapping(const std::vector<std::string>& selectList)
+{
+    if (selectList.empty())
+    {
+        return recordMapping_;
+    }
+    RecordMappingT mapping{};
+    for (auto&& s : selectList)
+    {
+        mapping[s] = getColumnIndex(s);
+    }
+    return mapping;
+}
+
+std::unique_ptr<db::Table::View>
+db::Table::select(std::vector<std::string>& selectList,
+                  std::unique_ptr<filters::Filter> filter,
+                  const std::vector<sort::SortKey>& orderBy,
+                  const Limit& limit)
+{
+    auto mapping = viewMapping(selectList);
+    auto result = std::make_unique<View>(tableName_, columns_, mapping);
+    collectIndexBuilds(false);
+    auto snapshot = openSnapshot();
+    auto needed = limit.needed();
+    if (orderBy.empty())
+    {
+        result->rowIds = matchingRows(filter.get(), *snapshot, needed);
+    }
+    else if (needed && orderBy.size() == 1 &&
+             hasIndex(orderBy.front().column))
+    {
+        // the index yields rows in order, filtering stops at the limit
+        result->rowIds = indexOrderedRows(filter.get(), orderBy.front(),
+                                          *needed, *snapshot);
+    }
+    else
+    {
+        result->rowIds =
+            orderRows(matchingRows(filter.get(), *snapshot), orderBy, needed,
+                      *snapshot);
+    }
+    limit.apply(result->rowIds);
+    result->table_ = this;
+    result->snapshot_ = std::move(snapshot);
+    result->tableVersion_ = version_;
+    result->version_ = version_->load();
+    return result;
+}
+
+std::unique_ptr<db::Table::View>
+db::Table::aggregate(const std::vector<std::string>& selectList,
+                     const aggregate::Grouping& grouping,
+                     std::unique_ptr<filters::Filter> filter)
+{
+    // result columns: the group columns, then the aggregates
+    std::vector<ColumnType> columns;
+    RecordMappingT layout;
+    std::vector<size_t> groupColumns;
+    for (auto&& name : grouping.columns)
+    {
+        groupColumns.push_back(getColumnIndex(name));
+        layout[name] = columns.size();
+        columns.push_back(columns_[groupColumns.back()]);
+    }
+    std::vector<aggregate::BoundAggregate> aggregates;
+    bool onlyCounts = true;
+    for (auto&& spec : grouping.aggregates)
+    {
+        auto&& bound = aggregates.emplace_back(spec.function);
+        if (!spec.column.empty())
+        {
+            bound.column = getColumnIndex(spec.column);
+        }
+        onlyCounts = onlyCounts && spec.function == aggregate::Function::COUNT;
+        layout[spec.name()] = columns.size();
+        bool extreme = spec.function == aggregate::Function::MIN ||
+                       spec.function == aggregate::Function::MAX;
+        columns.push_back(extreme ? columns_[*bound.column]
+                                  : std::make_shared<columns::Integer>(
+                                        spec.name()));
+    }
+
+    RecordMappingT mapping;
+    for (auto&& name : selectList)
+    {
+        auto it = layout.find(name);
+        if (it == layout.end())
+        {
+            throw TableException("Table " + tableName_ + ": Column " + name +
+                                 " is neither grouped nor aggregated!");
+        }
+        mapping[name] = it->second;
+    }
+    if (selectList.empty())
+    {
+        mapping = layout;
+    }
+
+    collectIndexBuilds(false);
+    auto snapshot = openSnapshot();
+    aggregate::HashAggregation partial(getStorage(), groupColumns,
+                                       aggregates);
+    std::vector<std::vector<value_type>> groups;
+    if (groupColumns.empty() && onlyCounts)
+    {
+        // row counts need no aggregation, without a filter not even a scan
+        size_t count = filter ? matchingRows(filter.get(), *snapshot).size()
+                              : snapshot->live;
+        if (count > static_cast<size_t>(std::numeric_limits<int>::max()))
+        {
+            throw DatabaseException("Aggregate result overflows int32");
+        }
+        groups.emplace_back(aggregates.size(), static_cast<int>(count));
+    }
+    else
+    {
+        auto rows = matchingRows(filter.get(), *snapshot);
+
+        // Every worker pulls morsels into its own partial table, the
+        // partial tables are merged at the end
+        size_t morsels = (rows.size() + kMorselSize - 1) / kMorselSize;
+        size_t threads =
+            std::max<size_t>(1, std::min(workers_ ? workers_->size() + 1 : 1,
+                                         morsels));
+        std::vector<aggregate::HashAggregation> partials(threads, partial);
+        std::atomic<size_t> nextMorsel{ 0 };
+        auto work = [&](size_t thread)
+        {
+            for (size_t morsel; (morsel = nextMorsel++) < morsels;)
             {
-                throw TableException(
-                    "Unknown column type during deserialization.");
+                size_t begin = morsel * kMorselSize;
+                partials[thread].add(std::span<const size_t>(rows).subspan(
+                    begin, std::min(kMorselSize, rows.size() - begin)));
             }
+        };
+        if (workers_ && threads > 1)
+        {
+            workers_->parallelFor(threads, work);
+        }
+        else
+        {
+            work(0);
+        }
+        for (size_t thread = 1; thread < threads; ++thread)
+        {
+            partials[0].merge(partials[thread]);
+        }
+        groups = partials[0].results();
+    }
 
-            record.rows[i] = row;
+    auto result = std::make_unique<View>(tableName_, columns, mapping);
+    for (auto&& values : groups)
+    {
+        auto record = std::make_shared<Record>(0);
+        record->rows.reserve(values.size());
+        for (size_t i = 0; i < values.size(); ++i)
+        {
+            record->rows.push_back({ columns[i]->getColumnType(),
+                                     columns[i]->getValueSize(),
+                                     std::move(values[i]) });
         }
+        result->recordPtrs.push_back(std::move(record));
+    }
+    return result;
+}
+
+std::unique_ptr<db::Table::Cursor>
+db::Table::openCursor(std::vector<std::string>& selectList,
+                      std::unique_ptr<filters::Filter> filter)
+{
+    collectIndexBuilds(false);
+    return std::make_unique<Cursor>(*this, viewMapping(selectList),
+                                    std::move(filter));
+}
 
-        records_.push_back(record);
+db::Table::Cursor::Cursor(Table& table, RecordMappingT recordMapping,
+                          std::unique_ptr<filters::Filter> filter)
+    : table_(table),
+      recordMapping_(std::move(recordMapping)),
+      filter_(std::move(filter)),
+      snapshot_(table.openSnapshot()),
+      version_(table.version_->load())
+{
+    if (filter_)
+    {
+        filter_->bind(table_);
+        program_ = std::make_unique<filters::Program>(
+            filters::Program::compile(*filter_, table_));
+        registers_ = std::make_unique<filters::ProgramRegisters>();
+        candidates_ = table_.indexScan(*filter_, *snapshot_);
     }
+    total_ = candidates_ ? candidates_->size() : snapshot_->rows;
+    batch_.reserve(filters::kBatchSize);
+}
 
-    file.close();
+db::Table::Cursor::~Cursor() = default;
+
+void db::Table::Cursor::checkValid() const
+{
+    if (table_.version_->load() != version_)
+    {
+        throw TableException("Cursor over " + table_.tableName_ +
+                             " is stale: the table was modified");
+    }
+}
+
+bool db::Table::Cursor::fetch()
+{
+    checkValid();
+    batch_.clear();
+    pos_ = 0;
+    if (scanned_ == total_)
+    {
+        return false;
+    }
+    size_t batchEnd = std::min(scanned_ + filters::kBatchSize, total_);
+    for (size_t pos = scanned_; pos < batchEnd; ++pos)
+    {
+        size_t row = candidates_ ? (*candidates_)[pos] : pos;
+        if (table_.visible(*snapshot_, row))
+        {
+            batch_.push_back(row);
+        }
+    }
+    scanned_ = batchEnd;
+    if (program_)
+    {
+        program_->filterBatch(batch_, *registers_);
+    }
+    return true;
+}
+
+bool db::Table::Cursor::next()
+{
+    checkValid();
+    if (pos_ + 1 < batch_.size())
+    {
+        ++pos_;
+        return true;
+    }
+    while (fetch())
+    {
+        if (!batch_.empty())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+const std::vector<size_t>& db::Table::Cursor::nextBatch()
+{
+    while (fetch() && batch_.empty())
+    {
+    }
+    pos_ = batch_.empty() ? 0 : batch_.size() - 1;
+    return batch_;
+}
+
+size_t db::Table::Cursor::rowId() const
+{
+    if (batch_.empty())
+    {
+        throw TableException("Cursor over " + table_.tableName_ +
+                             " has no current row");
+    }
+    return batch_[pos_];
+}
+
+db::Table::value_type db::Table::Cursor::value(size_t column) const
+{
+    size_t row = rowId();
+    checkValid();
+    return table_.getStorage().column(column).get(row);
+}
+
+db::Table::value_type db::Table::Cursor::value(const std::string& name) const
+{
+    auto it = recordMapping_.find(name);
+    if (it == recordMapping_.end())
+    {
+        throw TableException("Cursor over " + table_.tableName_ +
+                             ": Unknown column: " + name);
+    }
+    return value(it->second);
+}
+
+db::Table::Record db::Table::Cursor::record() const
+{
+    size_t row = rowId();
+    checkValid();
+    return table_.readRecord(row);
+}
+
+void db::Table::update(std::unique_ptr<filters::Filter> filter,
+                       InsertType newValues)
+{
+    Batch batch(*this);
+    batch.update(filter.get(), newValues);
+    batch.commit();
+}
+
+void db::Table::applyUpdate(const std::vector<size_t>& rows,
+                            const InsertType& newValues)
+{
+    // resolve the assignments once, the row loop only works on ordinals
+    struct Assignment
+    {
+        const std::string& name;
+        const value_type& value;
+        size_t column;
+        UniqueIndex* unique;
+    };
+    std::vector<Assignment> assignments;
+    assignments.reserve(newValues.size());
+    for (auto&& [key, val] : newValues)
+    {
+        auto unique = uniqueIndexes_.find(key);
+        assignments.push_back(
+            { key, val, recordMapping_.at(key),
+              unique != uniqueIndexes_.end() ? &unique->second : nullptr });
+    }
+
+    // every updated row becomes a new version, snapshots taken before
+    // the commit keep reading the old one
+    for (auto&& row : rows)
+    {
+        auto values = generation_->store.read(row);
+        for (auto&& [key, val, column, unique] : assignments)
+        {
+            if (unique && values[column] != val)
+            {
+                // the batch undoes the rows updated before
+                if (unique->contains(val))
+                {
+                    throw DatabaseException(
+                        "Unique constraint failed in field " + key);
+                }
+                eraseUniqueKey(*unique, values[column]);
+                addUniqueKey(*unique, val);
+            }
+            values[column] = val;
+        }
+        appendVersion(values);
+        endVersion(row);
+    }
+}
+
+void db::Table::del(std::unique_ptr<filters::Filter> filter)
+{
+    Batch batch(*this);
+    batch.del(filter.get());
+    batch.commit();
+}
+
+void db::Table::insertRow(InsertType mappedRecord)
+{
+    validateInsertion(mappedRecord);
+    auto newRecord = insertImpl(std::move(mappedRecord));
+    if (log_)
+    {
+        batch_->log_.push_back(
+            { wal::kInsert, tableName_, {}, std::move(newRecord) });
+    }
+}
+
+void db::Table::updateRows(filters::Filter* filter,
+                           const InsertType& newValues)
+{
+    validateInsertion(newValues);
+    auto rows = matchingRows(filter, latest());
+    auto positions = logPositions(rows);
+    applyUpdate(rows, newValues);
+    logRows(wal::kUpdate, std::move(positions), newValues);
+}
+
+void db::Table::deleteRows(filters::Filter* filter)
+{
+    auto rows = matchingRows(filter, latest());
+    auto positions = logPositions(rows);
+    applyDelete(rows);
+    logRows(wal::kDelete, std::move(positions), {});
+}
+
+void db::Table::applyDelete(const std::vector<size_t>& rows)
+{
+    // the versions stay for older snapshots, indexes included
+    auto uniques = bindUniqueIndexes();
+    for (auto&& row : rows)
+    {
+        for (auto&& [column, index] : uniques)
+        {
+            eraseUniqueKey(*index, generation_->store.column(column).get(row));
+        }
+        endVersion(row);
+    }
+}
+
+void db::Table::logRows(uint32_t kind, std::vector<size_t> rows,
+                        const InsertType& newValues)
+{
+    if (!log_ || rows.empty())
+    {
+        return;
+    }
+    wal::Entry entry{ static_cast<wal::EntryKind>(kind), tableName_ };
+    for (auto&& [name, value] : newValues)
+    {
+        entry.assignments.emplace_back(
+            static_cast<uint32_t>(recordMapping_.at(name)), value);
+    }
+    entry.rows = std::move(rows);
+    batch_->log_.push_back(std::move(entry));
+}
+
+std::vector<size_t>
+db::Table::logPositions(const std::vector<size_t>& rows)
+{
+    if (!log_ || live_ == generation_->store.rowCount())
+    {
+        return rows;
+    }
+    // each position counts the current versions before the row
+    countVersions();
+    std::vector<size_t> positions;
+    positions.reserve(rows.size());
+    for (auto row : rows)
+    {
+        size_t position = 0;
+        for (size_t node = row; node > 0; node -= node & -node)
+        {
+            position += currentCounts_[node];
+        }
+        positions.push_back(position);
+    }
+    return positions;
+}
+
+std::vector<size_t>
+db::Table::rowsAt(const std::vector<size_t>& positions)
+{
+    size_t count = generation_->store.rowCount();
+    if (live_ == count)
+    {
+        if (!positions.empty() && positions.back() >= count)
+        {
+            throw DatabaseException("Replay " + tableName_ +
+                                    ": row out of range");
+        }
+        return positions;
+    }
+    countVersions();
+    size_t top = std::bit_floor(count);
+    std::vector<size_t> rows;
+    rows.reserve(positions.size());
+    for (auto target : positions)
+    {
+        // descends to the last row with at most `target` current versions
+        // before it, which is the one at `target`
+        size_t row = 0;
+        size_t left = target;
+        for (size_t step = top; step > 0; step >>= 1)
+        {
+            if (row + step <= count && currentCounts_[row + step] <= left)
+            {
+                row += step;
+                left -= currentCounts_[row];
+            }
+        }
+        if (row == count)
+        {
+            throw DatabaseException("Replay " + tableName_ +
+                                    ": row out of range");
+        }
+        rows.push_back(row);
+    }
+    return rows;
+}
+
+void db::Table::countVersions()
+{
+    auto&& ended = generation_->ended;
+    size_t rows = generation_->store.rowCount();
+    if (currentCounts_.empty())
+    {
+        currentCounts_.reserve(rows + 1);
+        currentCounts_.push_back(0);
+    }
+    // a node sums its own row and the nodes below it
+    for (size_t node = currentCounts_.size(); node <= rows; ++node)
+    {
+        size_t sum = ended[node - 1].load(std::memory_order_relaxed) == kLive;
+        for (size_t child = node - 1; child > node - (node & -node);
+             child -= child & -child)
+        {
+            sum += currentCounts_[child];
+        }
+        currentCounts_.push_back(sum);
+    }
+}
+
+void db::Table::countVersion(size_t row, bool current)
+{
+    // rows past the tree are counted as they are when it reaches them
+    for (size_t node = row + 1; node < currentCounts_.size();
+         node += node & -node)
+    {
+        current ? ++currentCounts_[node] : --currentCounts_[node];
+    }
+}
+
+void db::Table::replay(const wal::Entry& entry)
+{
+    Batch batch(*this);
+    batch.replay(entry);
+    batch.commit();
+}
+
+void db::Table::replayEntry(const wal::Entry& entry)
+{
+    switch (entry.kind)
+    {
+    case wal::kInsert:
+    {
+        if (entry.values.size() != columns_.size())
+        {
+            throw DatabaseException("Replay " + tableName_ +
+                                    ": wrong number of values");
+        }
+        appendRecord(entry.values, bindUniqueIndexes());
+        // sequences continue after the ids the log handed out
+        for (auto&& [name, value] : autoIncrementColumnsMap_)
+        {
+            value = std::max(
+                value, std::get<columns::Integer::value_type>(
+                           entry.values[recordMapping_.at(name)]) +
+                           1);
+        }
+        break;
+    }
+    case wal::kUpdate:
+    {
+        auto rows = rowsAt(entry.rows);
+        InsertType newValues;
+        for (auto&& [column, value] : entry.assignments)
+        {
+            if (column >= columns_.size())
+            {
+                throw DatabaseException("Replay " + tableName_ +
+                                        ": column out of range");
+            }
+            newValues[columns_[column]->name()] = value;
+        }
+        applyUpdate(rows, newValues);
+        break;
+    }
+    case wal::kDelete:
+        applyDelete(rowsAt(entry.rows));
+        break;
+    default:
+        throw DatabaseException("Replay " + tableName_ + ": unexpected entry");
+    }
+}
+
+void db::Table::createIndex(const std::string& name)
+{
+    auto it = columnMap_.find(name);
+    if (it == columnMap_.end())
+    {
+        throw TableException("Create index " + tableName_ +
+                             ": Invalid column name: " + name + "!");
+    }
+    if (it->second->isIndex())
+    {
+        throw TableException("Create index " + tableName_ +
+                             ": Column already indexed: " + name + "!");
+    }
+
+    auto column = it->second;
+    column->setIndex(true);
+    indexColumns_.push_back(column);
+    std::unique_lock lock(indexMutex_);
+    pendingIndexes_[name] =
+        std::async(std::launch::async, &Table::buildIndex, this,
+                   recordMapping_[name]);
+    indexesPending_ = true;
+}
+
+void db::Table::dropIndex(const std::string& name)
+{
+    collectIndexBuilds(true);
+
+    auto it = columnMap_.find(name);
+    if (it == columnMap_.end() || !it->second->isIndex())
+    {
+        throw TableException("Drop index " + tableName_ +
+                             ": Column is not indexed: " + name + "!");
+    }
+
+    it->second->setIndex(false);
+    std::erase(indexColumns_, it->second);
+    std::unique_lock lock(indexMutex_);
+    orderedIndexes_.erase(name);
+}
+
+void db::Table::waitForIndexes()
+{
+    std::lock_guard write(writeMutex_);
+    collectIndexBuilds(true);
+}
+
+void db::Table::serializeCSV(std::filesystem::path dataFilePath,
+                             csv::WriterOptions options)
+{
+    csv::Writer file(dataFilePath, options);
+
+    // table name, columns and the data separator
+    std::ostringstream schema;
+    schema << "#TABLE_NAME\n" << tableName_ << "\n#COLUMNS\n";
+    for (const auto& column : columns_)
+    {
+        columns::serializeCSV(schema, column);
+    }
+    schema << "#DATA\n";
+    file.raw(schema.str());
+
+    // header for me
+    for (const auto& column : columns_)
+    {
+        file.field(column->name());
+    }
+    file.endRow();
+
+    // records of a snapshot, each column type resolved once
+    auto snapshot = openSnapshot();
+    std::vector<const storage::ColumnData*> data;
+    for (size_t i = 0; i < columns_.size(); ++i)
+    {
+        data.push_back(&getStorage().column(i));
+    }
+    for (size_t row = 0; row < snapshot->rows; ++row)
+    {
+        if (!visible(*snapshot, row))
+        {
+            continue;
+        }
+        for (auto column : data)
+        {
+            switch (column->getColumnType())
+            {
+            case columns::ColumType::Bytes:
+            case columns::ColumType::String:
+                file.field(
+                    static_cast<const storage::VarlenData*>(column)->at(row));
+                break;
+            case columns::ColumType::Integer:
+            case columns::ColumType::Id:
+                file.field(
+                    static_cast<const storage::IntegerData*>(column)->at(row));
+                break;
+            case columns::ColumType::Bool:
+                file.field(
+                    static_cast<const storage::BoolData*>(column)->at(row));
+                break;
+            default:
+                file.field(std::string_view{});
+                break;
+            }
+        }
+        file.endRow();
+    }
+
+    file.close();
+}
+
+void db::Table::deserializeCSV(std::filesystem::path dataFilePath)
+{
+    std::ifstream file(dataFilePath);
+    if (!file.is_open())
+    {
+        throw TableException("Failed to open file for reading: " +
+                             dataFilePath.string());
+    }
+
+    clearSchema();
+
+    std::string line;
+
+    // tableName
+    std::getline(file, line);
+    if (line != "#TABLE_NAME")
+    {
+        throw TableException("CSV doesnt have table name separator.");
+    }
+    std::getline(file, line);
+    tableName_ = line;
+
+    // columns
+    std::getline(file, line);
+    if (line != "#COLUMNS")
+    {
+        throw TableException("CSV doesnt have columns separator.");
+    }
+    while (std::getline(file, line))
+    {
+        if (line == "#DATA")
+        {
+            break;
+        }
+        std::istringstream iss(line);
+        std::string columnLine = line;
+        // Use columns::deserializeCSV to read column definition
+        std::istringstream columnStream(columnLine);
+        auto column = columns::deserializeCSV(columnStream);
+        if (column)
+        {
+            addColumn(column);
+        }
+        else
+        {
+            throw TableException("Failed to deserialize column from CSV.");
+        }
+    }
+
+    // header
+    if (!std::getline(file, line))
+    {
+        throw TableException("No header row found in CSV data.");
+    }
+    std::vector<std::string> columnNames = parseCSVLine(line);
+    if (columnNames.size() != columns_.size())
+    {
+        throw TableException(
+            "Missmatch between number of columns and header fields.");
+    }
+
+    // record mapping
+    for (size_t i = 0; i < columnNames.size(); ++i)
+    {
+        recordMapping_[columnNames[i]] = i;
+    }
+
+    // records, read in large blocks; every block is cut into chunks of
+    // whole rows that are parsed in parallel into chunk stores and appended
+    // in order
+    size_t threads = workers_ ? workers_->size() + 1 : 1;
+    size_t chunkSize =
+        std::max(kCsvChunkSize, kCsvBlockSize / (threads * 4));
+    std::string block;
+    size_t carried = 0;
+    bool final = false;
+    while (!final)
+    {
+        block.resize(carried + kCsvBlockSize);
+        file.read(block.data() + carried, kCsvBlockSize);
+        block.resize(carried + static_cast<size_t>(file.gcount()));
+        final = !file;
+
+        std::vector<std::string_view> chunks;
+        size_t consumed = csv::splitRows(block, final, chunkSize, chunks);
+
+        std::vector<storage::ColumnStore> parsed;
+        parsed.reserve(chunks.size());
+        for (size_t i = 0; i < chunks.size(); ++i)
+        {
+            parsed.push_back(generation_->store.emptyCopy());
+        }
+        std::atomic<size_t> nextChunk{ 0 };
+        std::vector<std::exception_ptr> errors(threads);
+        auto work = [&](size_t thread)
+        {
+            try
+            {
+                for (size_t chunk; (chunk = nextChunk++) < chunks.size();)
+                {
+                    csv::parseRows(chunks[chunk], parsed[chunk]);
+                }
+            }
+            catch (...)
+            {
+                errors[thread] = std::current_exception();
+            }
+        };
+        if (workers_ && chunks.size() > 1)
+        {
+            workers_->parallelFor(threads, work);
+        }
+        else
+        {
+            work(0);
+        }
+        for (auto&& error : errors)
+        {
+            if (error)
+            {
+                std::rethrow_exception(error);
+            }
+        }
+
+        for (auto&& chunk : parsed)
+        {
+            generation_->store.append(chunk);
+        }
+
+        // the incomplete last row goes on with the next block
+        carried = block.size() - consumed;
+        block.erase(0, consumed);
+    }
+
+    resetVersions();
+    rebuildIndexes();
+    restoreSequences();
+
+    file.close();
+}
+
+void db::Table::serialize(std::filesystem::path dataFilePath)
+{
+    // written next to the target and renamed over it, so a table mapped
+    // from that file keeps its pages and the save is all or nothing
+    auto temporary = dataFilePath;
+    temporary += ".tmp";
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+    {
+        throw TableException("Failed to open file for writing: " +
+                             temporary.string());
+    }
+    try
+    {
+        writeBinary(file);
+        file.close();
+        if (!file)
+        {
+            throw TableException("Failed to write file: " +
+                                 temporary.string());
+        }
+    }
+    catch (...)
+    {
+        std::error_code ignored;
+        std::filesystem::remove(temporary, ignored);
+        throw;
+    }
+    std::filesystem::rename(temporary, dataFilePath);
+}
+
+void db::Table::writeBinary(std::ostream& file)
+{
+    // the current versions of a snapshot; they are the first rows unless
+    // some were ended, a compacted copy is written then
+    auto snapshot = openSnapshot();
+    auto&& store = getStorage();
+    std::optional<storage::ColumnStore> compacted;
+    if (snapshot->live != snapshot->rows)
+    {
+        std::vector<bool> keep(snapshot->rows);
+        for (size_t row = 0; row < snapshot->rows; ++row)
+        {
+            keep[row] = visible(*snapshot, row);
+        }
+        compacted.emplace(store.emptyCopy());
+        compacted->append(store, snapshot->rows);
+        compacted->erase(keep);
+    }
+
+    binary::Writer out(file);
+    out.header({ binary::kVersion, static_cast<uint32_t>(columns_.size()),
+                 snapshot->live });
+
+    out.beginBlock(binary::kSchemaBlock);
+    out.string(tableName_);
+    for (auto&& column : columns_)
+    {
+        columns::serializeBinary(out, column);
+    }
+    out.endBlock();
+
+    (compacted ? *compacted : store).writeBinary(out, snapshot->live);
+}
+
+void db::Table::deserialize(std::filesystem::path dataFilePath)
+{
+    std::ifstream file(dataFilePath, std::ios::binary);
+    if (!file.is_open())
+    {
+        throw TableException("Failed to open file for reading: " +
+                             dataFilePath.string());
+    }
+
+    binary::Reader in(file);
+    auto header = readSchema(in);
+    generation_->store.readBinary(in, header.rowCount,
+                                  headroom(header.rowCount));
+
+    resetVersions();
+    rebuildIndexes();
+    restoreSequences();
+}
+
+void db::Table::map(std::filesystem::path dataFilePath)
+{
+    auto file = std::make_shared<binary::MappedFile>(dataFilePath);
+
+    // the header and schema are small and go through the checked reader
+    std::ispanstream stream(file->bytes());
+    binary::Reader in(stream);
+    auto header = readSchema(in);
+
+    binary::MappedReader columns(file, static_cast<uint64_t>(stream.tellg()));
+    // the file rows stay mapped, new versions go to the room after them
+    generation_->store.mapBinary(columns, header.rowCount,
+                                 headroom(header.rowCount));
+
+    resetVersions();
+    rebuildIndexes();
+    restoreSequences();
+}
+
+db::binary::Header db::Table::readSchema(binary::Reader& in)
+{
+    clearSchema();
+
+    auto header = in.header();
+    in.beginBlock(binary::kSchemaBlock);
+    tableName_ = in.string();
+    for (uint32_t i = 0; i < header.columnCount; ++i)
+    {
+        addColumn(columns::deserializeBinary(in));
+    }
+    in.endBlock();
+    return header;
+}
+
+void db::Table::rebuildIndexes()
+{
+    // Indexes are rebuilt a column at a time from the loaded data, in
+    // background like created indexes, so the table serves reads at once.
+    // The next write waits for all of them.
+    for (auto it = orderedIndexes_.begin(); it != orderedIndexes_.end();)
+    {
+        pendingIndexes_[it->first] =
+            std::async(std::launch::async, &Table::buildIndex, this,
+                       recordMapping_[it->first]);
+        it = orderedIndexes_.erase(it);
+        indexesPending_ = true;
+    }
+    for (auto it = uniqueIndexes_.begin(); it != uniqueIndexes_.end();)
+    {
+        pendingUniqueIndexes_[it->first] =
+            std::async(std::launch::async, &Table::buildUniqueIndex, this,
+                       recordMapping_[it->first]);
+        it = uniqueIndexes_.erase(it);
+    }
+}
+
+void db::Table::clearSchema()
+{
+    collectIndexBuilds(true);
+
+    columns_.clear();
+    columnMap_.clear();
+    recordMapping_.clear();
+    keyColumn_.reset();
+    uniquieColumns_.clear();
+    indexColumns_.clear();
+    defaultColumns_.clear();
+    autoIncrementColumnsMap_.clear();
+    orderedIndexes_.clear();
+    uniqueIndexes_.clear();
+    generation_->store.reset();
+    retired_.clear();
+    resetVersions();
+    invalidateViews();
+}
+
+void db::Table::restoreSequences()
+{
+    // continue autoincrement sequences after the loaded data
+    for (auto&& [name, value] : autoIncrementColumnsMap_)
+    {
+        auto&& ids = static_cast<const storage::IntegerData&>(
+                         generation_->store.column(recordMapping_.at(name)))
+                         .values();
+        if (!ids.empty())
+        {
+            value = *std::max_element(ids.begin(), ids.end()) + 1;
+        }
+    }
+}
+
+db::Table::Snapshot db::Table::committed() const
+{
+    std::shared_lock gate = lockCommitGate();
+    std::lock_guard lock(clock_->mutex);
+    return clock_->committed;
+}
+
+std::shared_lock<std::shared_mutex> db::Table::lockCommitGate() const
+{
+    if (!commitGate_)
+    {
+        return {};
+    }
+    return std::shared_lock(*commitGate_);
+}
+
+db::Table::Snapshot db::Table::latest() const
+{
+    // versions ended by the open batch carry the next timestamp
+    return { timestamp_ + 1, generation_->store.rowCount(), live_ };
+}
+
+std::shared_ptr<const db::Table::Snapshot> db::Table::openSnapshot() const
+{
+    std::shared_lock gate = lockCommitGate();
+    std::lock_guard lock(clock_->mutex);
+    ++clock_->open;
+    return std::shared_ptr<const Snapshot>(
+        new Snapshot(clock_->committed),
+        [clock = clock_](const Snapshot* snapshot)
+        {
+            std::lock_guard lock(clock->mutex);
+            --clock->open;
+            delete snapshot;
+        });
+}
+
+bool db::Table::visible(const Snapshot& snapshot, size_t row) const
+{
+    // generations current since the snapshot was taken hold every stamp it
+    // can see
+    return snapshot.live == snapshot.rows ||
+           current_.load(std::memory_order_acquire)
+                   ->ended[row]
+                   .load(std::memory_order_relaxed) > snapshot.timestamp;
+}
+
+size_t db::Table::appendVersion(const RowValues& values)
+{
+    auto&& store = generation_->store;
+    if (store.rowCount() == generation_->capacity || !store.fits(values))
+    {
+        grow(values);
+    }
+    size_t row = generation_->store.rowCount();
+    generation_->store.append(values);
+    generation_->ended[row].store(kLive, std::memory_order_relaxed);
+    ++live_;
+    return row;
+}
+
+void db::Table::endVersion(size_t row)
+{
+    generation_->ended[row].store(timestamp_ + 1, std::memory_order_relaxed);
+    countVersion(row, false);
+    --live_;
+    if (row < batch_->rows_)
+    {
+        batch_->ended_.push_back(row);
+    }
+}
+
+void db::Table::grow(const RowValues& next)
+{
+    auto&& store = generation_->store;
+    size_t rows = store.rowCount();
+    auto grown = std::make_unique<Generation>(store.emptyCopy());
+    grown->store.append(store);
+    grown->capacity = headroom(rows);
+    grown->store.reserve(grown->capacity);
+    while (!grown->store.fits(next))
+    {
+        grown->capacity *= 2;
+        grown->store.reserve(grown->capacity);
+    }
+    grown->ended =
+        std::make_unique<std::atomic<uint64_t>[]>(grown->capacity);
+    for (size_t row = 0; row < rows; ++row)
+    {
+        grown->ended[row].store(
+            generation_->ended[row].load(std::memory_order_relaxed),
+            std::memory_order_relaxed);
+    }
+
+    // snapshots open meanwhile may still read the old generation
+    retired_.push_back(std::move(generation_));
+    generation_ = std::move(grown);
+    current_.store(generation_.get(), std::memory_order_release);
+}
+
+void db::Table::commit()
+{
+    {
+        std::lock_guard lock(clock_->mutex);
+        clock_->committed = { ++timestamp_, generation_->store.rowCount(),
+                              live_ };
+    }
+    size_t garbage = generation_->store.rowCount() - live_;
+    if (!retired_.empty() || (garbage >= kMinGarbage && garbage >= live_))
+    {
+        reclaim();
+    }
+}
+
+void db::Table::rollback()
+{
+    // the versions of the batch stay as garbage, ended before any snapshot
+    // can see them; nothing was committed, so no snapshot reads the stamps
+    // restored meanwhile
+    auto&& generation = *generation_;
+    for (auto row : batch_->ended_)
+    {
+        generation.ended[row].store(kLive, std::memory_order_relaxed);
+        countVersion(row, true);
+    }
+    for (size_t row = batch_->rows_; row < generation.store.rowCount(); ++row)
+    {
+        if (generation.ended[row].exchange(timestamp_ + 1,
+                                           std::memory_order_relaxed) == kLive)
+        {
+            countVersion(row, false);
+        }
+    }
+    for (auto it = batch_->keys_.rbegin(); it != batch_->keys_.rend(); ++it)
+    {
+        auto&& [index, value, added] = *it;
+        if (added)
+        {
+            index->erase(value);
+        }
+        else
+        {
+            index->insert(value);
+        }
+    }
+    live_ = batch_->live_;
+    autoIncrementColumnsMap_ = batch_->sequences_;
+    // the garbage never needs index entries
+    std::unique_lock lock(indexMutex_);
+    indexedRows_ = generation.store.rowCount();
+}
+
+void db::Table::resetVersions()
+{
+    auto&& generation = *generation_;
+    size_t rows = generation.store.rowCount();
+    generation.capacity = headroom(rows);
+    // binary loads made the room already, CSV loads make it here
+    generation.store.reserve(generation.capacity);
+    generation.ended =
+        std::make_unique<std::atomic<uint64_t>[]>(generation.capacity);
+    for (size_t row = 0; row < rows; ++row)
+    {
+        generation.ended[row].store(kLive, std::memory_order_relaxed);
+    }
+    live_ = rows;
+    currentCounts_.clear();
+    {
+        std::unique_lock indexes(indexMutex_);
+        indexedRows_ = live_;
+    }
+    std::lock_guard lock(clock_->mutex);
+    clock_->committed = { ++timestamp_, live_, live_ };
+}
+
+bool db::Table::collectGarbage()
+{
+    std::lock_guard write(writeMutex_);
+    // builds read the rows reclaim() moves
+    collectIndexBuilds(true);
+    return reclaim();
+}
+
+bool db::Table::reclaim()
+{
+    // new snapshots wait until the row ids are settled
+    std::lock_guard lock(clock_->mutex);
+    if (clock_->open != 0)
+    {
+        return false;
+    }
+    retired_.clear();
+
+    auto&& store = generation_->store;
+    size_t rows = store.rowCount();
+    if (live_ == rows)
+    {
+        return true;
+    }
+    std::vector<bool> keep(rows);
+    for (size_t row = 0; row < rows; ++row)
+    {
+        keep[row] =
+            generation_->ended[row].load(std::memory_order_relaxed) == kLive;
+    }
+    {
+        std::unique_lock indexes(indexMutex_);
+        eraseFromIndexes(keep);
+        indexedRows_ = live_;
+    }
+    store.erase(keep);
+    currentCounts_.clear();
+    for (size_t row = 0; row < live_; ++row)
+    {
+        generation_->ended[row].store(kLive, std::memory_order_relaxed);
+    }
+    clock_->committed.rows = live_;
+    return true;
+}
+
+db::Table::Batch::Batch(Table& table)
+    : table_(table), lock_(table.writeMutex_)
+{
+    table_.collectIndexBuilds(true);
+    rows_ = table_.generation_->store.rowCount();
+    live_ = table_.live_;
+    sequences_ = table_.autoIncrementColumnsMap_;
+    table_.batch_ = this;
+}
+
+db::Table::Batch::~Batch()
+{
+    if (!committed_)
+    {
+        table_.rollback();
+    }
+    table_.batch_ = nullptr;
+}
+
+void db::Table::Batch::insert(InsertType insertMap)
+{
+    table_.insertRow(std::move(insertMap));
+}
+
+void db::Table::Batch::update(filters::Filter* filter,
+                              const InsertType& newValues)
+{
+    table_.updateRows(filter, newValues);
+}
+
+void db::Table::Batch::del(filters::Filter* filter)
+{
+    table_.deleteRows(filter);
+}
+
+void db::Table::Batch::replay(const wal::Entry& entry)
+{
+    table_.replayEntry(entry);
+}
+
+std::vector<db::wal::Entry> db::Table::Batch::releaseLog()
+{
+    return std::exchange(log_, {});
+}
+
+void db::Table::Batch::commit()
+{
+    // logged first: if that fails the destructor undoes the batch
+    if (!log_.empty())
+    {
+        table_.log_->append(log_);
+        log_.clear();
+    }
+    table_.indexNewRows();
+    table_.commit();
+    committed_ = true;
 }
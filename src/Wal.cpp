@@ -0,0 +1,399 @@
+#include "Wal.hpp"
+#include "BinaryFormat.hpp"
+#include "DataBaseException.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace db
+{
+
+namespace wal
+{
+
+namespace
+{
+
+[[noreturn]] void fail(const std::string& what, const std::filesystem::path& path)
+{
+    throw DatabaseException(what + " " + path.string() + ": " +
+                            std::strerror(errno));
+}
+
+// Row ids are ascending, so they are stored as (first, count) runs
+void writeRows(binary::Writer& out, const std::vector<size_t>& rows)
+{
+    std::vector<std::pair<uint64_t, uint64_t>> runs;
+    for (auto row : rows)
+    {
+        if (!runs.empty() && runs.back().first + runs.back().second == row)
+        {
+            ++runs.back().second;
+        }
+        else
+        {
+            runs.emplace_back(row, 1);
+        }
+    }
+    out.pod(static_cast<uint64_t>(runs.size()));
+    for (auto&& [first, count] : runs)
+    {
+        out.pod(first);
+        out.pod(count);
+    }
+}
+
+std::vector<size_t> readRows(binary::Reader& in)
+{
+    auto runs = in.pod<uint64_t>();
+    in.require(runs, 2 * sizeof(uint64_t));
+    std::vector<size_t> rows;
+    for (uint64_t run = 0; run < runs; ++run)
+    {
+        auto first = in.pod<uint64_t>();
+        auto count = in.pod<uint64_t>();
+        // a run cannot hold more rows than a table, keep a corrupt count
+        // from allocating everything
+        if (count > (uint64_t{ 1 } << 40))
+        {
+            throw DatabaseException("Corrupt log: bad row run");
+        }
+        for (uint64_t i = 0; i < count; ++i)
+        {
+            rows.push_back(first + i);
+        }
+    }
+    return rows;
+}
+
+std::string encode(const Entry& entry)
+{
+    std::ostringstream stream;
+    binary::Writer out(stream);
+    out.beginBlock(entry.kind);
+    out.string(entry.table);
+    switch (entry.kind)
+    {
+    case kCreateTable:
+        out.pod(static_cast<uint32_t>(entry.columns.size()));
+        for (auto&& column : entry.columns)
+        {
+            columns::serializeBinary(out, column);
+        }
+        break;
+    case kInsert:
+        out.pod(static_cast<uint32_t>(entry.values.size()));
+        for (auto&& value : entry.values)
+        {
+            columns::serializeValue(out, value);
+        }
+        break;
+    case kUpdate:
+        out.pod(static_cast<uint32_t>(entry.assignments.size()));
+        for (auto&& [column, value] : entry.assignments)
+        {
+            out.pod(column);
+            columns::serializeValue(out, value);
+        }
+        writeRows(out, entry.rows);
+        break;
+    case kDelete:
+        writeRows(out, entry.rows);
+        break;
+    case kTransaction:
+        out.pod(entry.count);
+        break;
+    case kCreateIndex:
+    case kDropIndex:
+        out.string(entry.column);
+        break;
+    }
+    out.endBlock();
+    return std::move(stream).str();
+}
+
+Entry decode(binary::Reader& in)
+{
+    Entry entry{ static_cast<EntryKind>(in.nextBlock()), in.string() };
+    switch (entry.kind)
+    {
+    case kCreateTable:
+    {
+        auto count = in.pod<uint32_t>();
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            entry.columns.push_back(columns::deserializeBinary(in));
+        }
+        break;
+    }
+    case kInsert:
+    {
+        auto count = in.pod<uint32_t>();
+        in.require(count, 2);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            entry.values.push_back(columns::deserializeValue(in));
+        }
+        break;
+    }
+    case kUpdate:
+    {
+        auto count = in.pod<uint32_t>();
+        in.require(count, 6);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            auto column = in.pod<uint32_t>();
+            entry.assignments.emplace_back(column, columns::deserializeValue(in));
+        }
+        entry.rows = readRows(in);
+        break;
+    }
+    case kDelete:
+        entry.rows = readRows(in);
+        break;
+    case kTransaction:
+        entry.count = in.pod<uint64_t>();
+        break;
+    case kCreateIndex:
+    case kDropIndex:
+        entry.column = in.string();
+        break;
+    default:
+        throw DatabaseException("Corrupt log: unknown entry kind");
+    }
+    in.endBlock();
+    return entry;
+}
+
+} // namespace
+
+Log::Log(std::filesystem::path path, Options options)
+    : path_(std::move(path)), options_(options)
+{
+    fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+                 0644);
+    if (fd_ < 0)
+    {
+        fail("Failed to open log", path_);
+    }
+    flusher_ = std::thread(&Log::flushLoop, this);
+}
+
+Log::~Log()
+{
+    {
+        std::lock_guard lock(mutex_);
+        stop_ = true;
+    }
+    queued_.notify_one();
+    flusher_.join();
+    if (error_.empty())
+    {
+        ::fdatasync(fd_);
+    }
+    ::close(fd_);
+}
+
+void Log::append(const Entry& entry)
+{
+    enqueue(encode(entry));
+}
+
+void Log::append(const std::vector<Entry>& entries)
+{
+    if (entries.size() == 1)
+    {
+        enqueue(encode(entries.front()));
+        return;
+    }
+    Entry header{ kTransaction, "" };
+    header.count = entries.size();
+    auto bytes = encode(header);
+    for (auto&& entry : entries)
+    {
+        bytes += encode(entry);
+    }
+    enqueue(bytes);
+}
+
+void Log::enqueue(const std::string& bytes)
+{
+    std::unique_lock lock(mutex_);
+    if (!error_.empty())
+    {
+        throw DatabaseException(error_);
+    }
+    pending_ += bytes;
+    uint64_t lsn = ++appended_;
+    queued_.notify_one();
+
+    if (options_.sync == SyncMode::Full)
+    {
+        written_.wait(lock, [&] { return flushed_ >= lsn || !error_.empty(); });
+        if (flushed_ < lsn)
+        {
+            throw DatabaseException(error_);
+        }
+    }
+}
+
+void Log::sync()
+{
+    std::unique_lock lock(mutex_);
+    waitWritten(lock);
+    lock.unlock();
+    // without fsyncs by the flusher, entries may only be written so far
+    if (::fdatasync(fd_) != 0)
+    {
+        fail("Failed to sync log", path_);
+    }
+}
+
+void Log::waitWritten(std::unique_lock<std::mutex>& lock)
+{
+    uint64_t lsn = appended_;
+    written_.wait(lock, [&] { return flushed_ >= lsn || !error_.empty(); });
+    if (flushed_ < lsn)
+    {
+        throw DatabaseException(error_);
+    }
+}
+
+void Log::flushLoop()
+{
+    std::unique_lock lock(mutex_);
+    while (true)
+    {
+        queued_.wait(lock, [&] { return stop_ || !pending_.empty(); });
+        if (pending_.empty())
+        {
+            return;
+        }
+
+        // everything queued so far goes out with one write and one fsync,
+        // writers arriving meanwhile queue up for the next batch
+        std::string batch;
+        batch.swap(pending_);
+        uint64_t lsn = appended_;
+        lock.unlock();
+
+        std::string error;
+        for (size_t done = 0; done < batch.size();)
+        {
+            auto written = ::write(fd_, batch.data() + done, batch.size() - done);
+            if (written < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (written <= 0)
+            {
+                error = "Failed to write log " + path_.string() + ": " +
+                        std::strerror(errno);
+                break;
+            }
+            done += static_cast<size_t>(written);
+        }
+        if (error.empty() && options_.sync != SyncMode::Off &&
+            ::fdatasync(fd_) != 0)
+        {
+            error = "Failed to sync log " + path_.string() + ": " +
+                    std::strerror(errno);
+        }
+
+        lock.lock();
+        if (!error.empty())
+        {
+            // the log may end in a torn entry now, nothing after it would
+            // be replayed, so every later append fails too
+            error_ = std::move(error);
+            pending_.clear();
+        }
+        else
+        {
+            flushed_ = lsn;
+        }
+        written_.notify_all();
+    }
+}
+
+uint64_t replay(const std::filesystem::path& path,
+                const std::function<void(const Entry&)>& apply)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        return 0;
+    }
+
+    binary::Reader in(file);
+    uint64_t valid = 0;
+    // entries of a transaction wait until its last one was read
+    std::vector<Entry> group;
+    uint64_t expected = 0;
+    while (file.peek() != std::ifstream::traits_type::eof())
+    {
+        Entry entry;
+        try
+        {
+            entry = decode(in);
+        }
+        catch (const std::exception&)
+        {
+            // a torn tail may hold anything until its checksum is checked
+            break;
+        }
+        if (entry.kind == kTransaction)
+        {
+            if (expected != 0)
+            {
+                break;
+            }
+            expected = entry.count;
+            continue;
+        }
+        if (expected != 0)
+        {
+            group.push_back(std::move(entry));
+            if (group.size() < expected)
+            {
+                continue;
+            }
+            for (auto&& member : group)
+            {
+                apply(member);
+            }
+            group.clear();
+            expected = 0;
+        }
+        else
+        {
+            apply(entry);
+        }
+        valid = static_cast<uint64_t>(file.tellg());
+    }
+    return valid;
+}
+
+void syncPath(const std::filesystem::path& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        fail("Failed to open", path);
+    }
+    int result = ::fsync(fd);
+    ::close(fd);
+    if (result != 0)
+    {
+        fail("Failed to sync", path);
+    }
+}
+
+} // namespace wal
+
+} // namespace db
@@ -0,0 +1,121 @@
+#include "WorkerPool.hpp"
+
+#include <utility>
+
+namespace db
+{
+
+WorkerPool::WorkerPool(size_t threads)
+{
+    threads_.reserve(threads);
+    for (size_t i = 0; i < threads; ++i)
+    {
+        threads_.emplace_back(&WorkerPool::workerLoop, this);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    stop_ = true;
+    ++generation_;
+    generation_.notify_all();
+    for (auto&& thread : threads_)
+    {
+        thread.join();
+    }
+}
+
+void WorkerPool::runTasks(std::unique_lock<std::mutex>& lock,
+                          const std::function<void(size_t)>& task)
+{
+    // `lock` is held on entry and on exit
+    ++running_;
+    while (next_ < count_)
+    {
+        size_t idx = next_++;
+        lock.unlock();
+        try
+        {
+            task(idx);
+        }
+        catch (...)
+        {
+            lock.lock();
+            if (!error_)
+            {
+                error_ = std::current_exception();
+            }
+            // skip whatever is left
+            next_ = count_;
+            continue;
+        }
+        lock.lock();
+    }
+    if (--running_ == 0)
+    {
+        running_.notify_all();
+    }
+}
+
+void WorkerPool::workerLoop()
+{
+    size_t seen = 0;
+    while (true)
+    {
+        generation_.wait(seen);
+        seen = generation_;
+        if (stop_)
+        {
+            return;
+        }
+        std::unique_lock lock(mutex_);
+        // the loop may already be over when this worker wakes up
+        if (task_ != nullptr)
+        {
+            runTasks(lock, *task_);
+        }
+    }
+}
+
+void WorkerPool::parallelFor(size_t count,
+                             const std::function<void(size_t)>& task)
+{
+    // one loop at a time, concurrent callers queue up here
+    std::lock_guard loopLock(loopMutex_);
+    {
+        std::lock_guard lock(mutex_);
+        task_ = &task;
+        count_ = count;
+        next_ = 0;
+        error_ = nullptr;
+    }
+    ++generation_;
+    generation_.notify_all();
+
+    std::exception_ptr error;
+    {
+        std::unique_lock lock(mutex_);
+        runTasks(lock, task);
+        // every index is claimed, late workers find nothing to do
+        task_ = nullptr;
+        error = std::exchange(error_, nullptr);
+    }
+    // wait for the workers still running a claimed index
+    for (size_t running = running_; running != 0; running = running_)
+    {
+        running_.wait(running);
+    }
+    {
+        std::lock_guard lock(mutex_);
+        if (!error)
+        {
+            error = std::exchange(error_, nullptr);
+        }
+    }
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+} // namespace db
@@ -1,12 +1,37 @@
 
 #include <gtest/gtest.h>
 
+#include <BinaryFormat.hpp>
+#include <CsvReader.hpp>
+#include <CsvWriter.hpp>
+#include <DataBaseException.hpp>
 #include <Database.hpp>
+#include <Filter.hpp>
+#include <Helpers.hpp>
+#include <Parser.hpp>
+#include <Simd.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <filesystem>
+#include <future>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <set>
+#include <streambuf>
+#include <thread>
 
 const std::filesystem::path exampleDbPath{ "../db/example.db" };
 
+std::unique_ptr<db::Table::View> query(const std::string& request)
+{
+    db::lexer::Lexer lexer{ request };
+    db::parser::Parser parser{ lexer };
+    return std::move(parser.parseCommand()->execute().value());
+}
+
 TEST(Operation, Complex)
 {
 
@@ -63,3 +88,1860 @@ TEST(Operation, LoadStore){
     EXPECT_NO_THROW(db::Database::getInstance().storeTableInFile("users", std::filesystem::path{"../db/example_copy.db"}));
 
 }
+
+TEST(Operation, ColumnarStorage)
+{
+    auto& database = db::Database::getInstance();
+    std::string tableName = "notes";
+    std::vector<std::string> selectAll{};
+
+    database.execute("create table notes (title: string[32], body: bytes[8], "
+                     "done: bool = false)");
+    for (int i = 0; i < 100; ++i)
+    {
+        database.execute("insert (title = \"note" + std::to_string(i) +
+                         "\", body = 0xbeef, done = false) to notes");
+    }
+
+    database.execute(
+        "update notes set title = \"a much longer title\" where id = 57");
+    database.execute("update notes set done = true where id >= 90");
+    database.execute("delete notes where id < 50");
+
+    auto view = database.select(tableName, selectAll, nullptr);
+    EXPECT_EQ(view->size(), 50);
+
+    auto updated = database.select(
+        tableName, selectAll,
+        std::make_unique<db::filters::ComparisonFilter>(
+            "title", db::filters::ComparisonFilter::EQUAL,
+            std::string{ "a much longer title" }));
+    ASSERT_EQ(updated->size(), 1);
+    EXPECT_EQ(std::get<int>(updated->value(0, "id")), 57);
+
+    const std::filesystem::path notesPath{ "notes.db" };
+    database.storeTableInFile(tableName, notesPath);
+    database.loadTableFromFile(tableName, notesPath);
+    std::filesystem::remove(notesPath);
+
+    auto done = database.select(
+        tableName, selectAll,
+        std::make_unique<db::filters::ComparisonFilter>(
+            "done", db::filters::ComparisonFilter::EQUAL, true));
+    EXPECT_EQ(done->size(), 10);
+
+    database.execute(
+        "insert (title = \"after load\", body = 0xbeef, done = false) to notes");
+    auto reloaded = database.select(tableName, selectAll, nullptr);
+    EXPECT_EQ(reloaded->size(), 51);
+}
+
+TEST(Operation, UniqueConstraint)
+{
+    auto& database = db::Database::getInstance();
+
+    database.execute("create table accounts ({key, autoincrement} id : int32, "
+                     "{unique} login: string[32])");
+    database.execute("insert (login = \"alice\") to accounts");
+    database.execute("insert (login = \"bob\") to accounts");
+
+    EXPECT_THROW(database.execute("insert (login = \"alice\") to accounts"),
+                 db::TableException);
+    EXPECT_THROW(
+        database.execute("update accounts set login = \"bob\" where id = 0"),
+        db::DatabaseException);
+    EXPECT_NO_THROW(
+        database.execute("update accounts set login = \"alice\" where id = 0"));
+
+    database.execute("update accounts set login = \"carol\" where id = 0");
+    EXPECT_NO_THROW(database.execute("insert (login = \"alice\") to accounts"));
+
+    database.execute("delete accounts where login = bob");
+    EXPECT_NO_THROW(database.execute("insert (login = \"bob\") to accounts"));
+}
+
+TEST(Operation, OrderedIndex)
+{
+    auto& database = db::Database::getInstance();
+
+    database.execute("create table scores ({index} score: int32, "
+                     "name: string[16])");
+    for (int i = 0; i < 200; ++i)
+    {
+        database.execute("insert (score = " + std::to_string(i % 50) +
+                         ", name = \"player" + std::to_string(i) +
+                         "\") to scores");
+    }
+
+    EXPECT_EQ(query("select * from scores where score = 7")->size(),
+              4);
+    EXPECT_EQ(query("select * from scores where score < 10")->size(),
+              40);
+    EXPECT_EQ(
+        query("select * from scores where score >= 10 && score <= 19")
+            ->size(),
+        40);
+    EXPECT_EQ(query("select * from scores where score > 10 && score < 10")
+                  ->size(),
+              0);
+    EXPECT_EQ(query("select * from scores where score = 7 && name = player57")
+                  ->size(),
+              1);
+    EXPECT_EQ(query("select * from scores where id >= 190")->size(),
+              10);
+
+    database.execute("update scores set score = 100 where score = 7");
+    EXPECT_EQ(query("select * from scores where score = 7")->size(),
+              0);
+    EXPECT_EQ(
+        query("select * from scores where score >= 100")->size(), 4);
+
+    database.execute("delete scores where score < 25");
+    auto rest = query("select * from scores where score > 48");
+    ASSERT_EQ(rest->size(), 8);
+    for (size_t row = 0; row < rest->size(); ++row)
+    {
+        EXPECT_GT(std::get<int>(rest->value(row, "score")), 48);
+    }
+}
+
+TEST(Operation, CreateDropIndex)
+{
+    auto& database = db::Database::getInstance();
+
+    database.execute("create table events (kind: int32, payload: string[16])");
+    for (int i = 0; i < 1000; ++i)
+    {
+        database.execute("insert (kind = " + std::to_string(i % 10) +
+                         ", payload = \"event\") to events");
+    }
+
+    database.execute("create index on events(kind)");
+    EXPECT_THROW(database.execute("create index on events(kind)"),
+                 db::TableException);
+    EXPECT_THROW(database.execute("create index on events(missing)"),
+                 db::TableException);
+
+    // served while the index may still be building
+    EXPECT_EQ(query("select * from events where kind = 3")->size(),
+              100);
+
+    database.execute("insert (kind = 3, payload = \"late\") to events");
+    EXPECT_EQ(query("select * from events where kind = 3")->size(),
+              101);
+    database.execute("delete events where kind >= 5");
+    EXPECT_EQ(query("select * from events where kind > 2")->size(),
+              201);
+
+    database.execute("drop index on events(kind)");
+    EXPECT_THROW(database.execute("drop index on events(kind)"),
+                 db::TableException);
+    EXPECT_EQ(query("select * from events where kind = 3")->size(),
+              101);
+}
+
+TEST(Operation, HashJoin)
+{
+    auto& database = db::Database::getInstance();
+
+    database.execute("create table members ({key, autoincrement} id : int32, "
+                     "{unique} name: string[16])");
+    database.execute("create table visits (member_id: int32, page: string[16])");
+    database.execute("create table pages (url: string[16], title: string[16])");
+
+    for (int i = 0; i < 10; ++i)
+    {
+        database.execute("insert (name = \"member" + std::to_string(i) +
+                         "\") to members");
+    }
+    for (int i = 0; i < 100; ++i)
+    {
+        database.execute("insert (member_id = " + std::to_string(i % 20) +
+                         ", page = \"page" + std::to_string(i % 3) +
+                         "\") to visits");
+    }
+    database.execute("insert (url = \"page0\", title = \"Home\") to pages");
+    database.execute("insert (url = \"page1\", title = \"About\") to pages");
+
+    auto joined = query("select members.name, visits.page from members join "
+                        "visits on members.id = visits.member_id");
+    EXPECT_EQ(joined->size(), 50);
+    EXPECT_EQ(joined->recordMapping.size(), 2);
+    ASSERT_TRUE(joined->recordMapping.contains("members.name"));
+
+    for (size_t row = 0; row < joined->size(); ++row)
+    {
+        // members.id is the first column, visits.member_id follows members
+        EXPECT_EQ(joined->value(row, 2), joined->value(row, 0));
+    }
+
+    auto reversed = query("select * from visits join members on "
+                          "members.id = visits.member_id where member_id < 5");
+    EXPECT_EQ(reversed->size(), 25);
+    EXPECT_TRUE(reversed->recordMapping.contains("visits.page"));
+
+    auto chained = query("select name, title from members join visits on "
+                         "id = member_id join pages on page = url");
+    EXPECT_EQ(chained->size(), 33);
+
+    // WHERE names are resolved against every joined table
+    const std::string membersVisits =
+        "select * from members join visits on members.id = visits.member_id ";
+    EXPECT_EQ(query(membersVisits + "where members.id < 3")->size(), 15);
+    EXPECT_EQ(query(membersVisits + "where visits.page = page1")->size(), 16);
+    EXPECT_EQ(query(membersVisits + "where members.id < 3 && page = page1")
+                  ->size(),
+              5);
+    EXPECT_EQ(query(membersVisits + "where members.name = member1")->size(), 5);
+    EXPECT_EQ(query("select name, title from members join visits on "
+                    "id = member_id join pages on page = url "
+                    "where title = Home")
+                  ->size(),
+              17);
+    EXPECT_THROW(query(membersVisits + "where members.age > 21"),
+                 db::DatabaseException);
+    EXPECT_THROW(query(membersVisits + "where members.id = visits.member_id"),
+                 db::DatabaseException);
+
+    EXPECT_THROW(query("select * from members join visits on id < member_id"),
+                 db::DatabaseException);
+}
+
+TEST(Operation, BatchFilter)
+{
+    using db::filters::ComparisonFilter;
+    using db::filters::LogicalFilter;
+    using db::filters::NotFilter;
+
+    auto& database = db::Database::getInstance();
+    std::string tableName = "readings";
+    std::vector<std::string> selectAll{};
+
+    database.execute("create table readings (sensor: string[8], value: int32, "
+                     "valid: bool = true)");
+    for (int i = 0; i < 5000; ++i)
+    {
+        database.execute("insert (sensor = \"s" + std::to_string(i % 7) +
+                         "\", value = " + std::to_string(i % 100) +
+                         ", valid = " + (i % 3 ? "true" : "false") +
+                         ") to readings");
+    }
+
+    auto compare = [](std::string field, ComparisonFilter::Operator op,
+                      db::Table::value_type value)
+    { return std::make_unique<ComparisonFilter>(field, op, value); };
+    auto logical = [](LogicalFilter::LogicalOperator op, auto left, auto right)
+    {
+        return std::make_unique<LogicalFilter>(op, std::move(left),
+                                               std::move(right));
+    };
+
+    std::vector<std::unique_ptr<db::filters::Filter>> filters;
+    filters.push_back(compare("value", ComparisonFilter::LESS_THAN, 10));
+    filters.push_back(logical(
+        LogicalFilter::AND,
+        compare("value", ComparisonFilter::GREATER_THAN_OR_EQUAL, 50),
+        compare("valid", ComparisonFilter::EQUAL, true)));
+    filters.push_back(
+        logical(LogicalFilter::OR,
+                compare("sensor", ComparisonFilter::EQUAL, std::string{ "s3" }),
+                compare("value", ComparisonFilter::EQUAL, 7)));
+    filters.push_back(logical(
+        LogicalFilter::OR,
+        logical(LogicalFilter::AND,
+                std::make_unique<NotFilter>(compare(
+                    "sensor", ComparisonFilter::EQUAL, std::string{ "s1" })),
+                std::make_unique<NotFilter>(
+                    compare("value", ComparisonFilter::GREATER_THAN, 20))),
+        compare("valid", ComparisonFilter::EQUAL, false)));
+    // type mismatch orders by variant alternative for every row
+    filters.push_back(compare("sensor", ComparisonFilter::GREATER_THAN, 5));
+
+    auto& table = *database.getTables()[tableName];
+    for (auto&& filter : filters)
+    {
+        filter->bind(table);
+        std::vector<size_t> expected;
+        for (size_t row = 0; row < table.size(); ++row)
+        {
+            if (filter->matches(row, table))
+            {
+                expected.push_back(row);
+            }
+        }
+
+        db::filters::Selection selection(table.size());
+        std::iota(selection.begin(), selection.end(), 0);
+        filter->filterBatch(selection, table);
+        EXPECT_EQ(selection, expected);
+
+        // the bytecode over dense blocks (bitmaps) and sparse ones (row ids)
+        auto program = db::filters::Program::compile(*filter, table);
+        db::filters::Program::Registers registers;
+        std::vector<size_t> dense, sparseExpected;
+        for (size_t begin = 0; begin < table.size();
+             begin += db::filters::kBatchSize)
+        {
+            selection.resize(
+                std::min(db::filters::kBatchSize, table.size() - begin));
+            std::iota(selection.begin(), selection.end(), begin);
+            program.filterBatch(selection, registers);
+            dense.insert(dense.end(), selection.begin(), selection.end());
+        }
+        EXPECT_EQ(dense, expected);
+
+        selection.clear();
+        for (size_t row = 0; row < table.size(); row += 3)
+        {
+            selection.push_back(row);
+        }
+        std::copy_if(expected.begin(), expected.end(),
+                     std::back_inserter(sparseExpected),
+                     [](size_t row) { return row % 3 == 0; });
+        program.filterBatch(selection, registers);
+        EXPECT_EQ(selection, sparseExpected);
+    }
+
+    auto view = database.select(tableName, selectAll, std::move(filters[2]));
+    EXPECT_EQ(view->size(), 757);
+}
+
+TEST(Simd, KernelsMatchScalar)
+{
+    using db::simd::CompareOp;
+
+    std::vector<int32_t> values(1000);
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        values[i] = static_cast<int32_t>((i * 7919) % 201) - 100;
+    }
+    values[3] = std::numeric_limits<int32_t>::min();
+    values[4] = std::numeric_limits<int32_t>::max();
+
+    const CompareOp ops[] = { CompareOp::Equal,    CompareOp::NotEqual,
+                              CompareOp::Less,     CompareOp::LessEqual,
+                              CompareOp::Greater,  CompareOp::GreaterEqual };
+    const db::simd::Level levels[] = { db::simd::Level::Sse42,
+                                       db::simd::Level::Avx2 };
+
+    // odd counts exercise the scalar tail of every kernel
+    for (size_t count : { 0, 1, 63, 64, 65, 200, 1000 })
+    {
+        for (auto op : ops)
+        {
+            for (int32_t needle : { -100, 0, 17, 100 })
+            {
+                std::vector<uint64_t> expected(db::simd::maskWords(count));
+                db::simd::compareInt32(values.data(), count, op, needle,
+                                       expected.data(),
+                                       db::simd::Level::Scalar);
+                for (auto level : levels)
+                {
+                    std::vector<uint64_t> mask(db::simd::maskWords(count));
+                    db::simd::compareInt32(values.data(), count, op, needle,
+                                           mask.data(), level);
+                    EXPECT_EQ(mask, expected)
+                        << db::simd::levelName(level) << " count " << count;
+                }
+            }
+        }
+    }
+
+    std::vector<uint64_t> words{ 0xF0F0F0F0F0F0F0F0ull, ~0ull };
+    std::vector<uint64_t> mask(2);
+    db::simd::compareBool(words.data(), 70, CompareOp::Equal, false,
+                          mask.data());
+    EXPECT_EQ(mask[0], 0x0F0F0F0F0F0F0F0Full);
+    EXPECT_EQ(mask[1], 0ull);
+    db::simd::compareBool(words.data(), 70, CompareOp::LessEqual, true,
+                          mask.data());
+    EXPECT_EQ(mask[1], 0x3Full);
+}
+
+TEST(Simd, CsvMasksMatchScalar)
+{
+    std::string text;
+    for (int i = 0; i < 300; ++i)
+    {
+        text += "ab,\"c\n"[(i * 7 + i / 5) % 6];
+    }
+    for (size_t offset : { 0, 1, 64, 200, 236, 299 })
+    {
+        auto expected = db::simd::classifyCsv(text.data() + offset,
+                                              text.size() - offset,
+                                              db::simd::Level::Scalar);
+        for (auto level : { db::simd::Level::Sse42, db::simd::Level::Avx2 })
+        {
+            auto masks = db::simd::classifyCsv(
+                text.data() + offset, text.size() - offset, level);
+            EXPECT_EQ(masks.quotes, expected.quotes) << offset;
+            EXPECT_EQ(masks.commas, expected.commas) << offset;
+            EXPECT_EQ(masks.newlines, expected.newlines) << offset;
+        }
+    }
+
+    EXPECT_EQ(db::simd::prefixXor(0b1001000), 0b0111000);
+    EXPECT_EQ(db::simd::prefixXor(1), ~uint64_t{ 0 });
+}
+
+TEST(Operation, ParallelScan)
+{
+    auto& database = db::Database::getInstance();
+    std::string tableName = "samples";
+    std::vector<std::string> selectAll{};
+
+    database.execute("create table samples (bucket: int32, flag: bool)");
+    auto& table = *database.getTables()[tableName];
+    const int rows = 3 * db::Table::kMorselSize + 123;
+    for (int i = 0; i < rows; ++i)
+    {
+        table.insert({ { "bucket", i % 97 }, { "flag", i % 2 == 0 } });
+    }
+
+    auto filter = [] {
+        return std::make_unique<db::filters::LogicalFilter>(
+            db::filters::LogicalFilter::AND,
+            std::make_unique<db::filters::ComparisonFilter>(
+                "bucket", db::filters::ComparisonFilter::LESS_THAN, 10),
+            std::make_unique<db::filters::ComparisonFilter>(
+                "flag", db::filters::ComparisonFilter::EQUAL, true));
+    };
+
+    auto serial = database.select(tableName, selectAll, filter());
+
+    database.setParallelism(4);
+    EXPECT_EQ(database.getParallelism(), 4);
+    auto parallel = database.select(tableName, selectAll, filter());
+    auto everything = database.select(tableName, selectAll, nullptr);
+    database.setParallelism(1);
+
+    ASSERT_EQ(parallel->size(), serial->size());
+    EXPECT_EQ(parallel->rowIds, serial->rowIds);
+    EXPECT_EQ(everything->size(), rows);
+
+    EXPECT_THROW(database.select(tableName, selectAll,
+                                 std::make_unique<db::filters::ComparisonFilter>(
+                                     "missing",
+                                     db::filters::ComparisonFilter::EQUAL, 1)),
+                 db::TableException);
+}
+
+TEST(Operation, RowIdView)
+{
+    auto& database = db::Database::getInstance();
+    std::string tableName = "readings";
+    std::vector<std::string> selectAll{};
+
+    database.execute("create table readings (sensor: string[16], value: int32)");
+    for (int i = 0; i < 20; ++i)
+    {
+        database.execute("insert (sensor = \"s" + std::to_string(i % 4) +
+                         "\", value = " + std::to_string(i) + ") to readings");
+    }
+
+    auto view = query("select * from readings where value >= 15");
+    ASSERT_EQ(view->size(), 5);
+    EXPECT_EQ(view->rowIds, (std::vector<size_t>{ 15, 16, 17, 18, 19 }));
+    EXPECT_TRUE(view->recordPtrs.empty());
+    EXPECT_EQ(std::get<std::string>(view->value(1, "sensor")), "s0");
+    EXPECT_EQ(view->record(4).rows[view->recordMapping["value"]].rowData,
+              db::Table::value_type{ 19 });
+
+    // appends leave existing row ids untouched
+    database.execute("insert (sensor = \"s9\", value = 99) to readings");
+    EXPECT_TRUE(view->isValid());
+    EXPECT_EQ(std::get<int>(view->value(0, "value")), 15);
+
+    // updates and deletes leave the view on the snapshot of its query
+    database.execute("update readings set value = 0 where value = 15");
+    EXPECT_TRUE(view->isValid());
+    EXPECT_EQ(std::get<int>(view->value(0, "value")), 15);
+    EXPECT_EQ(query("select * from readings where value >= 15")->size(), 5);
+
+    auto fresh = query("select value from readings where sensor = \"s1\"");
+    EXPECT_EQ(fresh->size(), 5);
+    database.execute("delete readings where sensor = \"s1\"");
+    EXPECT_TRUE(fresh->isValid());
+    EXPECT_EQ(std::get<int>(fresh->value(4, "value")), 17);
+    EXPECT_EQ(query("select value from readings where sensor = \"s1\"")
+                  ->size(),
+              0);
+
+    std::unique_ptr<db::Table::View> orphan;
+    {
+        db::Table scratch{ "scratch",
+                           { std::make_shared<db::columns::Integer>("x") } };
+        scratch.insert({ { "x", 1 } });
+        orphan = scratch.select(selectAll, nullptr);
+        EXPECT_TRUE(orphan->isValid());
+    }
+    EXPECT_FALSE(orphan->isValid());
+}
+
+TEST(Operation, Cursor)
+{
+    auto& database = db::Database::getInstance();
+    std::string tableName = "ticks";
+    std::vector<std::string> selectAll{};
+
+    database.execute("create table ticks (price: int32, live: bool)");
+    auto& table = *database.getTables()[tableName];
+    for (int i = 0; i < 5000; ++i)
+    {
+        table.insert({ { "price", i % 100 }, { "live", i % 2 == 0 } });
+    }
+
+    auto filter = []
+    {
+        return std::make_unique<db::filters::ComparisonFilter>(
+            "price", db::filters::ComparisonFilter::LESS_THAN, 10);
+    };
+    auto view = database.select(tableName, selectAll, filter());
+
+    // row by row, same rows in the same order as select
+    auto cursor = database.openCursor(tableName, selectAll, filter());
+    std::vector<size_t> streamed;
+    while (cursor->next())
+    {
+        streamed.push_back(cursor->rowId());
+        EXPECT_LT(std::get<int>(cursor->value("price")), 10);
+    }
+    EXPECT_EQ(streamed, view->rowIds);
+    EXPECT_FALSE(cursor->next());
+
+    // batch by batch
+    auto batches = database.openCursor(tableName, selectAll, filter());
+    std::vector<size_t> paged;
+    for (auto* batch = &batches->nextBatch(); !batch->empty();
+         batch = &batches->nextBatch())
+    {
+        EXPECT_LE(batch->size(), db::filters::kBatchSize);
+        paged.insert(paged.end(), batch->begin(), batch->end());
+    }
+    EXPECT_EQ(paged, view->rowIds);
+
+    // stopping early, appended rows are not visited
+    auto early = database.openCursor(tableName, selectAll, nullptr);
+    ASSERT_TRUE(early->next());
+    EXPECT_EQ(early->record().rows[early->getRecordMapping().at("price")]
+                  .rowData,
+              db::Table::value_type{ 0 });
+    table.insert({ { "price", 1 }, { "live", true } });
+    size_t visited = 1;
+    while (early->next())
+    {
+        ++visited;
+    }
+    EXPECT_EQ(visited, 5000);
+
+    // deletes after the cursor was opened do not show
+    auto snapshot = database.openCursor(tableName, selectAll, filter());
+    ASSERT_TRUE(snapshot->next());
+    database.execute("delete ticks where price < 5");
+    size_t matched = 1;
+    while (snapshot->next())
+    {
+        EXPECT_LT(std::get<int>(snapshot->value("price")), 10);
+        ++matched;
+    }
+    // the row appended above included
+    EXPECT_EQ(matched, view->size() + 1);
+    EXPECT_EQ(database.select(tableName, selectAll, filter())->size(),
+              view->size() / 2);
+}
+
+TEST(Operation, Binding)
+{
+    auto& database = db::Database::getInstance();
+    std::string tableName = "accounts";
+
+    database.execute(
+        "create table accounts ({key, autoincrement} id: int32, "
+        "{unique} email: string[32], balance: int32)");
+    for (int i = 0; i < 10; ++i)
+    {
+        database.execute("insert (email = \"user" + std::to_string(i) +
+                         "\", balance = " + std::to_string(i * 10) +
+                         ") to accounts");
+    }
+
+    // unknown columns are rejected before any row is touched
+    EXPECT_THROW(query("select * from accounts where missing = 1"),
+                 db::TableException);
+    EXPECT_THROW(query("select missing from accounts"), db::TableException);
+    EXPECT_THROW(database.execute("update accounts set balance = 0 where "
+                                  "balance > 10 && missing = 1"),
+                 db::TableException);
+    EXPECT_EQ(query("select * from accounts where balance = 0")->size(), 1);
+    EXPECT_THROW(database.execute("delete accounts where missing = 1"),
+                 db::TableException);
+    EXPECT_EQ(query("select * from accounts")->size(), 10);
+
+    db::filters::ComparisonFilter unbound{
+        "balance", db::filters::ComparisonFilter::EQUAL, 0
+    };
+    auto& table = *database.getTables()[tableName];
+    EXPECT_THROW(unbound.matches(0, table), db::DatabaseException);
+    unbound.bind(table);
+    EXPECT_EQ(unbound.column(), table.getColumnIndex("balance"));
+    EXPECT_TRUE(unbound.matches(0, table));
+
+    // bound assignments keep the unique index in sync
+    database.execute("update accounts set email = \"admin\" where id = 3");
+    EXPECT_THROW(
+        database.execute("update accounts set email = \"admin\" where id = 4"),
+        db::DatabaseException);
+    auto admins = query("select * from accounts where email = \"admin\"");
+    ASSERT_EQ(admins->size(), 1);
+    EXPECT_EQ(std::get<int>(admins->value(0, "id")), 3);
+    database.execute("insert (email = \"user3\", balance = 5) to accounts");
+    EXPECT_EQ(query("select * from accounts")->size(), 11);
+}
+
+TEST(Operation, Expressions)
+{
+    auto& database = db::Database::getInstance();
+
+    database.execute("create table pairs ({key, autoincrement} id: int32, "
+                     "a: int32, b: int32, name: string[16], lit: bool)");
+    for (int i = 0; i < 3000; ++i)
+    {
+        database.execute("insert (a = " + std::to_string(i % 50) +
+                         ", b = " + std::to_string(i % 7) + ", name = \"" +
+                         std::string(i % 9, 'x') + "\", lit = " +
+                         (i % 2 ? "true" : "false") + ") to pairs");
+    }
+
+    auto count = [](const std::string& where)
+    {
+        auto view = query("select * from pairs where " + where);
+        return view->size();
+    };
+    auto expected = [](auto pred)
+    {
+        size_t n = 0;
+        for (int i = 0; i < 3000; ++i)
+        {
+            n += pred(i % 50, i % 7, i % 9, i % 2 == 1) ? 1 : 0;
+        }
+        return n;
+    };
+
+    // column against column, with arithmetic on either side
+    EXPECT_EQ(count("a + 1 < b"),
+              expected([](int a, int b, int, bool) { return a + 1 < b; }));
+    EXPECT_EQ(count("a % 7 = b * 1"),
+              expected([](int a, int b, int, bool) { return a % 7 == b; }));
+    EXPECT_EQ(
+        count("|name| > 5 && a >= b"),
+        expected([](int a, int b, int len, bool) { return len > 5 && a >= b; }));
+    EXPECT_EQ(count("!(b - a = 0) && |name| < 4"),
+              expected([](int a, int b, int len, bool)
+                       { return b - a != 0 && len < 4; }));
+    EXPECT_EQ(count("(a = b)"),
+              expected([](int a, int b, int, bool) { return a == b; }));
+    EXPECT_EQ(count("lit = true && 10 > a"),
+              expected([](int a, int, int, bool on) { return on && a < 10; }));
+
+    // constants are folded, the mirrored form is lowered to a column filter
+    EXPECT_EQ(count("a = 2 * 3 + 1"), count("a = 7"));
+    EXPECT_EQ(count("(1 + 2) * 3 <= a"), count("a >= 9"));
+
+    // bare words stay strings unless they name a column
+    EXPECT_EQ(count("name = xxx"), expected([](int, int, int len, bool)
+                                            { return len == 3; }));
+    // but only against a string column, a typo is an unknown column
+    EXPECT_THROW(count("a + 1 < nope"), db::DatabaseException);
+    EXPECT_THROW(count("nope = 3"), db::TableException);
+    EXPECT_THROW(count("lit = true && a < nope"), db::DatabaseException);
+    EXPECT_THROW(count("nope = \"xxx\""), db::TableException);
+    EXPECT_THROW(count("nope"), db::DatabaseException);
+    EXPECT_THROW(count("a + nope > 1"), db::DatabaseException);
+    EXPECT_THROW(count("-nope > 1"), db::DatabaseException);
+    EXPECT_THROW(count("|nope| > 1"), db::DatabaseException);
+    EXPECT_EQ(count("xxx = name && a >= 0"),
+              expected([](int, int, int len, bool) { return len == 3; }));
+
+    EXPECT_THROW(query("select * from pairs where a + name > 1"),
+                 db::DatabaseException);
+    EXPECT_THROW(query("select * from pairs where |a| > 1"),
+                 db::DatabaseException);
+    EXPECT_THROW(query("select * from pairs where (a + 1)"),
+                 db::DatabaseException);
+
+    database.execute("update pairs set lit = false where a - b > 40");
+    EXPECT_EQ(count("lit = true && a - b > 40"), 0);
+}
+
+TEST(Operation, ExpressionOverflow)
+{
+    auto& database = db::Database::getInstance();
+    database.execute("create table limits (a: int32, b: int32)");
+    database.execute("insert (a = 2147483647, b = 0) to limits");
+    auto count = [](const std::string& where)
+    { return query("select * from limits where " + where)->size(); };
+
+    // results past int32 throw instead of wrapping, in every operator
+    EXPECT_THROW(count("(a + 1) / (b - 1) = 1"), db::DatabaseException);
+    EXPECT_THROW(count("a + 1 > 0"), db::DatabaseException);
+    EXPECT_THROW(count("0 - a - 2 < 0"), db::DatabaseException);
+    EXPECT_THROW(count("a * 2 > 0"), db::DatabaseException);
+    EXPECT_THROW(count("-(0 - a - 1) > 0"), db::DatabaseException);
+    // INT_MIN / -1 and INT_MIN % -1 trap in int
+    EXPECT_THROW(count("(0 - a - 1) / (b - 1) > 0"), db::DatabaseException);
+    EXPECT_THROW(count("(0 - a - 1) % (b - 1) = 0"), db::DatabaseException);
+    // folded constants too
+    EXPECT_THROW(count("a = 2147483647 + 1"), db::DatabaseException);
+
+    // the edges themselves are fine
+    EXPECT_EQ(count("0 - a - 1 < 0"), 1);
+    EXPECT_EQ(count("(0 - a - 1) / (b + 1) < 0"), 1);
+    EXPECT_EQ(count("a - 1 + 1 = 2147483647"), 1);
+}
+
+TEST(Operation, OrderBy)
+{
+    auto& database = db::Database::getInstance();
+
+    database.execute("create table ranking ({key, autoincrement} id: int32, "
+                     "points: int32, team: string[16], active: bool)");
+    for (int i = 0; i < 500; ++i)
+    {
+        database.execute("insert (points = " + std::to_string((i * 37) % 101) +
+                         ", team = \"team" + std::to_string(i % 13) +
+                         "\", active = " + (i % 4 ? "true" : "false") +
+                         ") to ranking");
+    }
+
+    auto column = [](const db::Table::View& view, const std::string& name)
+    {
+        std::vector<db::Table::value_type> values;
+        for (size_t row = 0; row < view.size(); ++row)
+        {
+            values.push_back(view.value(row, name));
+        }
+        return values;
+    };
+    auto sortedBy = [&](const std::string& request, const std::string& name,
+                        bool descending)
+    {
+        auto values = column(*query(request), name);
+        auto expected = values;
+        std::stable_sort(expected.begin(), expected.end(),
+                         [&](auto&& l, auto&& r)
+                         { return descending ? r < l : l < r; });
+        return values == expected;
+    };
+
+    EXPECT_TRUE(sortedBy("select * from ranking order by points", "points",
+                         false));
+    EXPECT_TRUE(sortedBy("select * from ranking order by points desc",
+                         "points", true));
+    EXPECT_TRUE(sortedBy("select * from ranking order by team asc", "team",
+                         false));
+    EXPECT_TRUE(sortedBy("select * from ranking where active = true order by "
+                         "ranking.points desc",
+                         "points", true));
+
+    // ties on the first key are ordered by the second, then by row id
+    auto multi = query("select * from ranking order by team desc, points");
+    ASSERT_EQ(multi->size(), 500);
+    for (size_t row = 1; row < multi->size(); ++row)
+    {
+        auto team = std::make_pair(multi->value(row - 1, "team"),
+                                   multi->value(row, "team"));
+        EXPECT_GE(team.first, team.second);
+        if (team.first == team.second)
+        {
+            auto points = std::make_pair(multi->value(row - 1, "points"),
+                                         multi->value(row, "points"));
+            EXPECT_LE(points.first, points.second);
+            if (points.first == points.second)
+            {
+                EXPECT_LT(multi->value(row - 1, "id"), multi->value(row, "id"));
+            }
+        }
+    }
+
+    // an ordered index is walked instead of sorting, with the same result
+    auto before = query("select * from ranking order by points desc")->rowIds;
+    database.execute("create index on ranking(points)");
+    EXPECT_EQ(query("select * from ranking order by points desc")->rowIds,
+              before);
+    EXPECT_EQ(query("select * from ranking where points > 10 order by points")
+                  ->rowIds,
+              query("select * from ranking where points > 10 order by points "
+                    "asc, id")
+                  ->rowIds);
+
+    database.execute("create table owners (team: string[16], owner: "
+                     "string[16])");
+    database.execute("insert (team = \"team3\", owner = \"zed\") to owners");
+    database.execute("insert (team = \"team7\", owner = \"amy\") to owners");
+    EXPECT_TRUE(sortedBy("select points, owners.owner from ranking join owners on "
+                         "ranking.team = owners.team order by owner, points",
+                         "owners.owner", false));
+
+    EXPECT_THROW(query("select * from ranking order by missing"),
+                 db::TableException);
+
+    // top-K and spilled runs agree with a full stable sort
+    auto& table = *database.getTables()["ranking"];
+    std::vector<size_t> rows(table.size());
+    std::iota(rows.begin(), rows.end(), 0);
+    std::vector<db::sort::BoundKey> keys{
+        { table.getColumnIndex("team"), true },
+        { table.getColumnIndex("points"), false }
+    };
+    auto&& store = table.getStorage();
+    auto expected = rows;
+    std::stable_sort(expected.begin(), expected.end(),
+                     [&](size_t l, size_t r)
+                     {
+                         auto lt = store.column(keys[0].column).get(l);
+                         auto rt = store.column(keys[0].column).get(r);
+                         if (lt != rt)
+                         {
+                             return rt < lt;
+                         }
+                         return store.column(keys[1].column).get(l) <
+                                store.column(keys[1].column).get(r);
+                     });
+
+    EXPECT_EQ(db::sort::sortRows(store, keys, rows), expected);
+    auto top = db::sort::sortRows(store, keys, rows, 20);
+    EXPECT_EQ(top, std::vector<size_t>(expected.begin(), expected.begin() + 20));
+    db::sort::SortOptions tiny{ 64 * 16 };
+    EXPECT_EQ(db::sort::sortRows(store, keys, rows, std::nullopt, tiny),
+              expected);
+    EXPECT_EQ(db::sort::sortRows(store, keys, rows, 100, tiny),
+              std::vector<size_t>(expected.begin(), expected.begin() + 100));
+}
+
+TEST(Operation, Limit)
+{
+    auto& database = db::Database::getInstance();
+    std::string tableName = "feed";
+    std::vector<std::string> selectAll{};
+
+    database.execute("create table feed (seq: int32, bucket: int32, "
+                     "flag: bool)");
+    auto& table = *database.getTables()[tableName];
+    const int rows = 3 * db::Table::kMorselSize + 123;
+    for (int i = 0; i < rows; ++i)
+    {
+        table.insert({ { "seq", rows - i },
+                       { "bucket", i % 97 },
+                       { "flag", i % 2 == 0 } });
+    }
+
+    auto page = [](std::vector<size_t> rows, size_t count, size_t offset)
+    {
+        rows.erase(rows.begin(), rows.begin() + std::min(offset, rows.size()));
+        rows.resize(std::min(rows.size(), count));
+        return rows;
+    };
+
+    auto all = query("select * from feed")->rowIds;
+    EXPECT_EQ(query("select * from feed limit 20")->rowIds, page(all, 20, 0));
+    EXPECT_EQ(query("select * from feed limit 20 offset 30")->rowIds,
+              page(all, 20, 30));
+    EXPECT_TRUE(query("select * from feed limit 5 offset 999999")->rowIds
+                    .empty());
+    EXPECT_TRUE(query("select * from feed limit 0")->rowIds.empty());
+
+    // the scan stops early, in parallel waves the rows stay in table order
+    std::string rare = "select * from feed where bucket = 96 && flag = false";
+    auto matching = query(rare)->rowIds;
+    ASSERT_GT(matching.size(), 200);
+    database.setParallelism(4);
+    EXPECT_EQ(query(rare + " limit 10")->rowIds, page(matching, 10, 0));
+    EXPECT_EQ(query(rare + " limit 150 offset 50")->rowIds,
+              page(matching, 150, 50));
+    database.setParallelism(1);
+    EXPECT_EQ(query(rare + " limit 150 offset 50")->rowIds,
+              page(matching, 150, 50));
+
+    // ordering before the limit, by sorting and by walking an index
+    auto ordered = query(rare + " order by seq")->rowIds;
+    EXPECT_EQ(query(rare + " order by seq limit 7 offset 3")->rowIds,
+              page(ordered, 7, 3));
+    database.execute("create index on feed(seq)");
+    table.waitForIndexes();
+    EXPECT_EQ(query(rare + " order by seq limit 7 offset 3")->rowIds,
+              page(ordered, 7, 3));
+    EXPECT_EQ(query("select * from feed order by seq desc limit 4")->rowIds,
+              (std::vector<size_t>{ 0, 1, 2, 3 }));
+    EXPECT_EQ(query("select * from feed where seq < 100 order by seq limit 3")
+                  ->rowIds,
+              (std::vector<size_t>{ static_cast<size_t>(rows - 1),
+                                    static_cast<size_t>(rows - 2),
+                                    static_cast<size_t>(rows - 3) }));
+
+    EXPECT_THROW(query("select * from feed limit"), db::DatabaseException);
+    EXPECT_THROW(query("select * from feed limit 3 offset"),
+                 db::DatabaseException);
+}
+
+TEST(Operation, GroupBy)
+{
+    auto& database = db::Database::getInstance();
+    std::string tableName = "sales";
+
+    database.execute("create table sales (region: string[16], store: int32, "
+                     "amount: int32, shipped: bool)");
+    auto& table = *database.getTables()[tableName];
+    const int rows = 2 * db::Table::kMorselSize + 321;
+    struct Totals
+    {
+        int count = 0;
+        int sum = 0;
+        int low = std::numeric_limits<int>::max();
+        int high = std::numeric_limits<int>::min();
+    };
+    std::map<std::string, Totals> expected;
+    std::vector<std::string> firstSeen;
+    for (int i = 0; i < rows; ++i)
+    {
+        std::string region = "region" + std::to_string((i * 7) % 23);
+        int amount = (i * 31) % 1000 - 200;
+        table.insert({ { "region", region },
+                       { "store", i % 5 },
+                       { "amount", amount },
+                       { "shipped", i % 3 == 0 } });
+        auto&& totals = expected[region];
+        if (totals.count++ == 0)
+        {
+            firstSeen.push_back(region);
+        }
+        totals.sum += amount;
+        totals.low = std::min(totals.low, amount);
+        totals.high = std::max(totals.high, amount);
+    }
+
+    auto check = [&](const std::string& request)
+    {
+        auto view = query(request);
+        ASSERT_EQ(view->size(), expected.size());
+        for (size_t row = 0; row < view->size(); ++row)
+        {
+            auto region = std::get<std::string>(view->value(row, "region"));
+            // groups come out in the order they first appear
+            EXPECT_EQ(region, firstSeen[row]);
+            auto&& totals = expected[region];
+            EXPECT_EQ(view->value(row, "count(*)"), db::Table::value_type(totals.count));
+            EXPECT_EQ(view->value(row, "sum(amount)"), db::Table::value_type(totals.sum));
+            EXPECT_EQ(view->value(row, "min(amount)"), db::Table::value_type(totals.low));
+            EXPECT_EQ(view->value(row, "max(amount)"), db::Table::value_type(totals.high));
+            EXPECT_EQ(view->value(row, "avg(amount)"),
+                      db::Table::value_type(totals.sum / totals.count));
+        }
+    };
+    std::string grouped = "select region, count(*), sum(amount), "
+                          "min(amount), MAX(sales.amount), avg(amount) "
+                          "from sales group by region";
+    check(grouped);
+    database.setParallelism(4);
+    check(grouped);
+    database.setParallelism(1);
+
+    // ungrouped aggregates, counts without a filter read the row count
+    auto total = query("select count(*), min(region), max(shipped) from sales");
+    ASSERT_EQ(total->size(), 1);
+    EXPECT_EQ(total->value(0, "count(*)"), db::Table::value_type(rows));
+    EXPECT_EQ(total->value(0, "min(region)"),
+              db::Table::value_type(expected.begin()->first));
+    EXPECT_EQ(total->value(0, "max(shipped)"), db::Table::value_type(true));
+    EXPECT_EQ(query("select count(amount) from sales where shipped = true")
+                  ->value(0, "count(amount)"),
+              db::Table::value_type((rows + 2) / 3));
+    auto none = query("select count(*), sum(amount) from sales where store > 9");
+    ASSERT_EQ(none->size(), 1);
+    EXPECT_EQ(none->value(0, "sum(amount)"), db::Table::value_type(0));
+
+    // several group columns, ordering and limits over the groups
+    auto pairs = query("select store, shipped, count(*) from sales group by "
+                       "store, shipped order by count(*) desc, store limit 4");
+    ASSERT_EQ(pairs->size(), 4);
+    for (size_t row = 1; row < pairs->size(); ++row)
+    {
+        EXPECT_GE(pairs->value(row - 1, "count(*)"),
+                  pairs->value(row, "count(*)"));
+    }
+    EXPECT_EQ(query("select store from sales group by store")->size(), 5);
+
+    EXPECT_THROW(query("select region, amount, count(*) from sales group by "
+                       "region"),
+                 db::TableException);
+    EXPECT_THROW(query("select sum(region) from sales"), db::DatabaseException);
+    EXPECT_THROW(query("select median(amount) from sales"),
+                 db::DatabaseException);
+    EXPECT_THROW(query("select sum(*) from sales"), db::DatabaseException);
+}
+
+TEST(Operation, BinaryFormat)
+{
+    auto& database = db::Database::getInstance();
+    std::string tableName = "archive";
+
+    database.createTable(
+        tableName,
+        std::vector<db::Table::ColumnType>{
+            std::make_shared<db::columns::Id>(),
+            std::make_shared<db::columns::String>("code", 16, "", false, true),
+            std::make_shared<db::columns::Integer>("score", 7, true),
+            std::make_shared<db::columns::Bytes>("payload", 8),
+            std::make_shared<db::columns::Bool>("flag", true) });
+    auto& table = *database.getTables()[tableName];
+    for (int i = 0; i < 2000; ++i)
+    {
+        table.insert({ { "code", "code" + std::to_string(i) },
+                       { "score", i % 37 - 10 },
+                       { "payload", std::vector<uint8_t>(i % 9, uint8_t(i)) },
+                       { "flag", i % 5 == 0 } });
+    }
+    // leaves stale bytes in the string blob and gaps in the ids
+    database.execute("update archive set code = \"a much longer code\" "
+                     "where id = 3");
+    database.execute("delete archive where score = 0");
+
+    auto path = std::filesystem::temp_directory_path() / "small-sql-archive.bin";
+    table.serialize(path);
+
+    db::Table loaded{ "loaded" };
+    loaded.deserialize(path);
+    ASSERT_EQ(loaded.size(), table.size());
+    std::vector<std::string> selectAll{};
+    auto original = table.select(selectAll, nullptr);
+    auto copy = loaded.select(selectAll, nullptr);
+    for (size_t row = 0; row < table.size(); ++row)
+    {
+        for (auto&& name : { "id", "code", "score", "payload", "flag" })
+        {
+            ASSERT_EQ(copy->value(row, name), original->value(row, name));
+        }
+    }
+
+    // schema, indexes and sequences survive the round trip
+    std::string copyName = "archive_copy";
+    database.createTable(copyName, {});
+    auto& reloaded = *database.getTables()[copyName];
+    reloaded.deserialize(path);
+    auto ids = [](const std::string& table)
+    {
+        std::vector<db::Table::value_type> ids;
+        auto view = query("select id from " + table + " where score = 5");
+        for (size_t row = 0; row < view->size(); ++row)
+        {
+            ids.push_back(view->value(row, "id"));
+        }
+        return ids;
+    };
+    EXPECT_EQ(ids("archive"), ids("archive_copy"));
+    reloaded.insert({ { "code", std::string("fresh") } });
+    auto fresh = query("select * from archive_copy where code = \"fresh\"");
+    ASSERT_EQ(fresh->size(), 1);
+    EXPECT_EQ(fresh->value(0, "id"), db::Table::value_type(2000));
+    EXPECT_EQ(fresh->value(0, "score"), db::Table::value_type(7));
+    EXPECT_EQ(fresh->value(0, "flag"), db::Table::value_type(true));
+    EXPECT_THROW(reloaded.insert({ { "code", std::string("code11") } }),
+                 db::TableException);
+
+    // a flipped block length is caught before anything is sized by it
+    auto size = std::filesystem::file_size(path);
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        for (uint64_t block = db::binary::kHeaderSize; block < size;)
+        {
+            uint64_t length = 0;
+            file.seekg(static_cast<std::streamoff>(block + 8));
+            file.read(reinterpret_cast<char*>(&length), sizeof(length));
+            for (int bit : { 20, 33, 49 })
+            {
+                uint64_t flipped = length ^ (uint64_t{ 1 } << bit);
+                file.seekp(static_cast<std::streamoff>(block + 8));
+                file.write(reinterpret_cast<const char*>(&flipped), 8);
+                file.flush();
+                try
+                {
+                    loaded.deserialize(path);
+                    ADD_FAILURE() << "length of block at " << block;
+                }
+                catch (const db::DatabaseException& e)
+                {
+                    EXPECT_TRUE(std::string(e.what()).starts_with(
+                        "Corrupt table file"))
+                        << e.what();
+                }
+            }
+            file.seekp(static_cast<std::streamoff>(block + 8));
+            file.write(reinterpret_cast<const char*>(&length), 8);
+            file.flush();
+            block += db::binary::kBlockHeaderSize + length +
+                     db::binary::padding(length);
+        }
+    }
+
+    // flipped bits and truncation are detected
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(static_cast<std::streamoff>(size / 2));
+        file.put('\x5a');
+    }
+    EXPECT_THROW(loaded.deserialize(path), db::DatabaseException);
+    std::filesystem::resize_file(path, size / 3);
+    EXPECT_THROW(loaded.deserialize(path), db::DatabaseException);
+    std::filesystem::remove(path);
+}
+
+TEST(Operation, MappedTable)
+{
+    auto& database = db::Database::getInstance();
+    std::string tableName = "ledger";
+
+    database.createTable(
+        tableName,
+        std::vector<db::Table::ColumnType>{
+            std::make_shared<db::columns::Id>(),
+            std::make_shared<db::columns::String>("memo", 16, "", false, true),
+            std::make_shared<db::columns::Integer>("amount", 0, true),
+            std::make_shared<db::columns::Bool>("cleared", false) });
+    auto& table = *database.getTables()[tableName];
+    for (int i = 0; i < 5000; ++i)
+    {
+        table.insert({ { "memo", "memo" + std::to_string(i) },
+                       { "amount", i % 100 },
+                       { "cleared", i % 3 == 0 } });
+    }
+
+    auto path = std::filesystem::temp_directory_path() / "small-sql-ledger.bin";
+    table.serialize(path);
+    auto size = std::filesystem::file_size(path);
+
+    database.mapTableFromFile("ledger_mapped", path);
+    auto compare = [&](const std::string& where)
+    {
+        auto expected = query("select * from ledger" + where);
+        auto actual = query("select * from ledger_mapped" + where);
+        ASSERT_EQ(actual->size(), expected->size());
+        for (size_t row = 0; row < expected->size(); ++row)
+        {
+            for (auto&& name : { "id", "memo", "amount", "cleared" })
+            {
+                ASSERT_EQ(actual->value(row, name), expected->value(row, name));
+            }
+        }
+    };
+    compare("");
+    compare(" where amount = 42 and cleared = true");
+    compare(" where amount > 90 order by memo desc limit 7");
+
+    // writes change the mapped table, never the file
+    for (auto&& table : { "ledger", "ledger_mapped" })
+    {
+        database.execute(std::string("update ") + table +
+                         " set memo = \"short\" where id = 10");
+        database.execute(std::string("update ") + table +
+                         " set memo = \"a much longer memo\", amount = 1000 "
+                         "where id = 20");
+        database.execute(std::string("delete ") + table +
+                         " where amount = 7");
+        database.execute(std::string("insert (memo = \"appended\") to ") +
+                         table);
+    }
+    compare("");
+    compare(" where amount = 1000");
+    EXPECT_EQ(std::filesystem::file_size(path), size);
+
+    db::Table pristine{ "pristine" };
+    pristine.map(path);
+    EXPECT_EQ(pristine.size(), 5000);
+    std::vector<std::string> selectAll{};
+    auto rows = pristine.select(selectAll, nullptr);
+    EXPECT_EQ(rows->value(20, "memo"), db::Table::value_type("memo20"));
+
+    // a mapped table saves back over its own file
+    pristine.serialize(path);
+    EXPECT_EQ(pristine.select(selectAll, nullptr)->value(4999, "memo"),
+              db::Table::value_type("memo4999"));
+    db::Table reread{ "reread" };
+    reread.deserialize(path);
+    EXPECT_EQ(reread.size(), 5000);
+    EXPECT_EQ(reread.select(selectAll, nullptr)->value(20, "memo"),
+              db::Table::value_type("memo20"));
+
+    // writes append to the room after the mapped rows, which stay in place
+    auto ids = [&]
+    {
+        return static_cast<const db::storage::IntegerData&>(
+                   pristine.getStorage().column(0))
+            .values()
+            .data();
+    };
+    auto mappedIds = ids();
+    for (int i = 0; i < 100; ++i)
+    {
+        pristine.insert({ { "memo", "fresh" + std::to_string(i) } });
+    }
+    pristine.update(std::make_unique<db::filters::ComparisonFilter>(
+                        "memo", db::filters::ComparisonFilter::EQUAL,
+                        std::string("memo7")),
+                    { { "amount", 700 } });
+    EXPECT_EQ(ids(), mappedIds);
+    EXPECT_EQ(pristine.size(), 5100);
+    EXPECT_EQ(pristine.versions(), 5101);
+    auto fresh = pristine.select(
+        selectAll, std::make_unique<db::filters::ComparisonFilter>(
+                       "amount", db::filters::ComparisonFilter::EQUAL, 700));
+    ASSERT_EQ(fresh->size(), 1);
+    EXPECT_EQ(fresh->value(0, "memo"), db::Table::value_type("memo7"));
+
+    // the mapping outlives the file name
+    std::filesystem::remove(path);
+    compare(" where memo = \"memo4999\"");
+
+    std::ofstream(path, std::ios::binary) << "SSQLTBL";
+    EXPECT_THROW(pristine.map(path), db::DatabaseException);
+    std::filesystem::remove(path);
+    EXPECT_THROW(pristine.map(path), db::DatabaseException);
+}
+
+TEST(Operation, WriteAheadLog)
+{
+    auto& database = db::Database::getInstance();
+    auto directory = std::filesystem::temp_directory_path() / "small-sql-wal";
+    std::filesystem::remove_all(directory);
+
+    auto snapshot = [&](const std::string& table)
+    {
+        std::vector<std::vector<db::Table::value_type>> rows;
+        auto view = query("select * from " + table);
+        for (size_t row = 0; row < view->size(); ++row)
+        {
+            rows.push_back({ view->value(row, "id"), view->value(row, "name"),
+                             view->value(row, "stock") });
+        }
+        return rows;
+    };
+    auto changeRows = [&](int first)
+    {
+        for (int i = first; i < first + 300; ++i)
+        {
+            database.execute("insert (name = \"item" + std::to_string(i) +
+                             "\", stock = " + std::to_string(i % 50) +
+                             ") to inventory");
+        }
+        database.execute("update inventory set stock = 99 where stock = 3");
+        database.execute("delete inventory where stock < 5");
+        // point updates between the garbage of the ones before
+        for (int id = first + 1; id < first + 300; id += 37)
+        {
+            database.execute("update inventory set stock = " +
+                             std::to_string(id % 7 + 10) +
+                             " where id = " + std::to_string(id));
+        }
+        // fails at the second row, the first one is undone too
+        EXPECT_THROW(
+            database.execute("update inventory set name = \"dup\" where "
+                             "stock = 49"),
+            db::DatabaseException);
+    };
+
+    database.open(directory);
+    database.execute("create table inventory ({key, autoincrement} id : "
+                     "int32, {unique} name: string[32], {index} stock: "
+                     "int32)");
+    changeRows(0);
+    auto expected = snapshot("inventory");
+    database.close();
+
+    // recovery replays the log on an empty checkpoint
+    database.open(directory);
+    EXPECT_EQ(snapshot("inventory"), expected);
+
+    // then on top of a checkpoint
+    database.checkpoint();
+    EXPECT_EQ(std::filesystem::file_size(directory / "wal-1.log"), 0);
+    changeRows(300);
+    expected = snapshot("inventory");
+    database.close();
+
+    // a torn entry at the end is dropped and the log continues after it
+    auto log = directory / "wal-1.log";
+    auto size = std::filesystem::file_size(log);
+    std::ofstream(log, std::ios::binary | std::ios::app) << "\x01\x02torn";
+    database.open(directory, { db::wal::SyncMode::Normal });
+    EXPECT_EQ(std::filesystem::file_size(log), size);
+    EXPECT_EQ(snapshot("inventory"), expected);
+    EXPECT_FALSE(std::filesystem::exists(directory / "checkpoint-0"));
+
+    // sequences continue where the log left them
+    database.execute("insert (name = \"last\") to inventory");
+    auto last = query("select * from inventory where name = \"last\"");
+    ASSERT_EQ(last->size(), 1);
+    EXPECT_EQ(std::get<int>(last->value(0, "id")), 600);
+    expected = snapshot("inventory");
+    database.close();
+
+    database.open(directory, { db::wal::SyncMode::Off });
+    EXPECT_EQ(snapshot("inventory"), expected);
+
+    // index DDL is logged as well, no checkpoint in between
+    std::string tableName = "inventory";
+    std::string columnName = "name";
+    auto isIndexed = [&]
+    {
+        auto indexes = database.lockShared(tableName)->getInndexColumns();
+        return std::ranges::any_of(indexes, [&](auto&& column)
+                                   { return column->name() == columnName; });
+    };
+    database.createIndex(tableName, columnName);
+    database.close();
+    database.open(directory);
+    EXPECT_TRUE(isIndexed());
+    EXPECT_EQ(snapshot("inventory"), expected);
+    database.dropIndex(tableName, columnName);
+    database.close();
+    database.open(directory);
+    EXPECT_FALSE(isIndexed());
+    database.close();
+    std::filesystem::remove_all(directory);
+}
+
+TEST(Operation, CsvWriter)
+{
+    auto path = std::filesystem::temp_directory_path() / "small-sql-writer.csv";
+    auto contents = [&]
+    {
+        std::ifstream file(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(file), {});
+    };
+
+    // a buffer smaller than a row, and a value larger than the buffer
+    std::string large(10000, 'x');
+    {
+        db::csv::Writer writer(path, { 16 });
+        writer.raw("#DATA\n");
+        writer.field("plain");
+        writer.field("with,comma");
+        writer.field("say \"hi\"");
+        writer.field(-2147483647 - 1);
+        writer.field(true);
+        writer.endRow();
+        writer.field(large);
+        writer.field(false);
+        writer.endRow();
+        writer.close();
+    }
+    std::string expected = "#DATA\nplain,\"with,comma\",\"say \"\"hi\"\"\","
+                           "-2147483648,true\n" +
+                           large + ",false\n";
+    EXPECT_EQ(contents(), expected);
+    for (auto&& field : { "plain", "with,comma", "say \"hi\"" })
+    {
+        std::string text = field;
+        EXPECT_NE(expected.find(db::escapeCSVField(text)), std::string::npos);
+    }
+
+    // a table round trips through the direct writer with a partial block
+    auto& database = db::Database::getInstance();
+    database.execute("create table exports ({key, autoincrement} id : int32, "
+                     "label: string[64], flag: bool, blob: bytes[4])");
+    auto& table = *database.getTables()["exports"];
+    for (int i = 0; i < 3000; ++i)
+    {
+        table.insert({ { "label", "a,b " + std::to_string(i) },
+                       { "flag", i % 2 == 0 },
+                       { "blob",
+                         std::vector<uint8_t>{ 'q', uint8_t('0' + i % 10) } } });
+    }
+    table.serializeCSV(path, { 4096, true });
+    EXPECT_NE(std::filesystem::file_size(path) %
+                  db::csv::Writer::kDirectAlignment,
+              0);
+
+    db::Table copy{ "exports" };
+    copy.deserializeCSV(path);
+    ASSERT_EQ(copy.size(), table.size());
+    std::vector<std::string> selectAll{};
+    auto original = table.select(selectAll, nullptr);
+    auto loaded = copy.select(selectAll, nullptr);
+    for (size_t row = 0; row < table.size(); ++row)
+    {
+        for (auto&& name : { "id", "label", "flag", "blob" })
+        {
+            ASSERT_EQ(loaded->value(row, name), original->value(row, name));
+        }
+    }
+    std::filesystem::remove(path);
+}
+
+TEST(Operation, CsvReader)
+{
+    // rows split on newlines outside quotes only
+    std::string data = "1,\"a\nb\",true\n2,\"x,\"\"y\"\"\",false\n3,tail";
+    std::vector<std::string_view> chunks;
+    EXPECT_EQ(db::csv::splitRows(data, false, 1, chunks),
+              data.find("3,tail"));
+    ASSERT_EQ(chunks.size(), 2);
+    EXPECT_EQ(chunks[0], "1,\"a\nb\",true\n");
+    chunks.clear();
+    EXPECT_EQ(db::csv::splitRows(data, true, 1 << 20, chunks), data.size());
+    ASSERT_EQ(chunks.size(), 1);
+
+    db::storage::ColumnStore store;
+    store.addColumn(db::columns::ColumType::Integer);
+    store.addColumn(db::columns::ColumType::String);
+    store.addColumn(db::columns::ColumType::Bool);
+    auto chunk = store.emptyCopy();
+    EXPECT_EQ(db::csv::parseRows("1,\"a\nb\",true\n2,\"x,\"\"y\"\"\",false\n",
+                                 chunk),
+              2);
+    store.append(chunk);
+    ASSERT_EQ(store.rowCount(), 2);
+    EXPECT_EQ(store.column(1).get(0), db::Table::value_type(std::string("a\nb")));
+    EXPECT_EQ(store.column(1).get(1), db::Table::value_type(std::string("x,\"y\"")));
+    EXPECT_EQ(store.column(2).get(1), db::Table::value_type(false));
+
+    // quoted runs crossing 64-byte blocks, plain fields come out in place
+    std::string longText(100, 'z');
+    std::string row = "\"" + longText + ",\n\"\"x\"\"\"," + longText + ",\"\"\n";
+    std::string text = row + row;
+    db::csv::Tokenizer tokens(text);
+    std::vector<std::pair<std::string, bool>> fields;
+    std::string_view field;
+    bool rowEnd = false;
+    while (tokens.next(field, rowEnd))
+    {
+        fields.emplace_back(field, rowEnd);
+    }
+    ASSERT_EQ(fields.size(), 6);
+    EXPECT_EQ(fields[0].first, longText + ",\n\"x\"");
+    EXPECT_FALSE(fields[0].second);
+    EXPECT_EQ(fields[4].first, longText);
+    EXPECT_EQ(fields[5].first, "");
+    EXPECT_TRUE(fields[5].second);
+
+    // the line helpers agree with the writer's quoting
+    std::string awkward = longText + "\"," + longText + "\"\"";
+    auto escaped = db::escapeCSVField(awkward);
+    EXPECT_EQ(escaped, "\"" + longText + "\"\"," + longText + "\"\"\"\"\"");
+    EXPECT_EQ(db::parseCSVLine("a," + escaped + ","),
+              (std::vector<std::string>{ "a", awkward, "" }));
+    EXPECT_EQ(db::escapeCSVField(longText), longText);
+
+    auto bad = store.emptyCopy();
+    EXPECT_THROW(db::csv::parseRows("1,a\n", bad), db::TableException);
+    EXPECT_THROW(db::csv::parseRows("one,a,true\n", bad), db::TableException);
+    EXPECT_THROW(db::csv::parseRows("1,\"a,true\n", bad), db::TableException);
+
+    // a table spanning several chunks loads the same on a worker pool
+    auto path = std::filesystem::temp_directory_path() / "small-sql-reader.csv";
+    auto& database = db::Database::getInstance();
+    database.execute("create table imports ({key, autoincrement} id : int32, "
+                     "label: string[32], flag: bool)");
+    auto& table = *database.getTables()["imports"];
+    auto* coutBuffer = std::cout.rdbuf(nullptr);
+    for (int i = 0; i < 120000; ++i)
+    {
+        table.insert({ { "label", "row " + std::to_string(i) },
+                       { "flag", i % 3 == 0 } });
+    }
+    std::cout.rdbuf(coutBuffer);
+    table.serializeCSV(path);
+    ASSERT_GT(std::filesystem::file_size(path), 2 * db::Table::kCsvChunkSize);
+
+    db::Table copy{ "imports" };
+    copy.setWorkerPool(std::make_shared<db::WorkerPool>(3));
+    copy.deserializeCSV(path);
+    ASSERT_EQ(copy.size(), table.size());
+    std::vector<std::string> selectAll{};
+    auto original = table.select(selectAll, nullptr);
+    auto loaded = copy.select(selectAll, nullptr);
+    for (size_t row = 0; row < table.size(); row += 997)
+    {
+        for (auto&& name : { "id", "label", "flag" })
+        {
+            ASSERT_EQ(loaded->value(row, name), original->value(row, name));
+        }
+    }
+    // sequences continue after the loaded rows
+    copy.insert({ { "label", "next" }, { "flag", true } });
+    auto last = copy.select(selectAll, nullptr);
+    EXPECT_EQ(std::get<int32_t>(last->value(copy.size() - 1, "id")),
+              std::get<int32_t>(original->value(table.size() - 1, "id")) + 1);
+    std::filesystem::remove(path);
+}
+
+TEST(Operation, ConcurrentStatements)
+{
+    // statements print, the threads write to a buffer dropping everything
+    struct NullBuffer : std::streambuf
+    {
+        int overflow(int c) override
+        {
+            return c;
+        }
+    } nullBuffer;
+    auto* coutBuffer = std::cout.rdbuf(&nullBuffer);
+
+    auto& database = db::Database::getInstance();
+    database.execute("create table stress ({key, autoincrement} id : int32, "
+                     "amount: int32, flag: bool)");
+    database.execute("create index on stress(amount)");
+
+    constexpr int kWriters = 4;
+    constexpr int kRowsPerWriter = 200;
+    std::atomic<bool> stop = false;
+    std::atomic<size_t> failures = 0;
+    std::vector<std::thread> threads;
+    for (int writer = 0; writer < kWriters; ++writer)
+    {
+        threads.emplace_back(
+            [&, writer]
+            {
+                for (int i = 0; i < kRowsPerWriter; ++i)
+                {
+                    database.execute("insert (amount = " +
+                                     std::to_string(writer * 1000 + i % 10) +
+                                     ", flag = false) to stress");
+                }
+            });
+    }
+    threads.emplace_back(
+        [&]
+        {
+            while (!stop)
+            {
+                database.execute("update stress set flag = true where "
+                                 "amount = 1007");
+            }
+        });
+    for (int reader = 0; reader < 4; ++reader)
+    {
+        threads.emplace_back(
+            [&]
+            {
+                std::string tableName = "stress";
+                std::vector<std::string> selectAll{};
+                size_t seen = 0;
+                while (!stop)
+                {
+                    database.execute("select id, amount from stress where "
+                                     "amount < 1000");
+                    // rows are only appended, a reader never sees fewer
+                    auto lock = database.lockShared(tableName);
+                    auto view = database.select(tableName, selectAll, nullptr);
+                    if (view->size() < seen)
+                    {
+                        ++failures;
+                    }
+                    seen = view->size();
+                    for (size_t row = 0; row < view->size(); ++row)
+                    {
+                        if (std::get<int>(view->value(row, "amount")) % 1000 >=
+                            10)
+                        {
+                            ++failures;
+                        }
+                    }
+                }
+            });
+    }
+    for (int writer = 0; writer < kWriters; ++writer)
+    {
+        threads[writer].join();
+    }
+    stop = true;
+    for (size_t thread = kWriters; thread < threads.size(); ++thread)
+    {
+        threads[thread].join();
+    }
+    std::cout.rdbuf(coutBuffer);
+
+    EXPECT_EQ(failures, 0);
+    auto& table = *database.getTables()["stress"];
+    ASSERT_EQ(table.size(), kWriters * kRowsPerWriter);
+    std::vector<std::string> selectAll{};
+    auto view = table.select(selectAll, nullptr);
+    std::set<int> ids;
+    for (size_t row = 0; row < view->size(); ++row)
+    {
+        ids.insert(std::get<int>(view->value(row, "id")));
+    }
+    EXPECT_EQ(ids.size(), table.size());
+
+    // rows change under a shared lock, the schema does not; unknown tables
+    // are refused
+    std::string tableName = "stress";
+    std::string columnName = "flag";
+    auto lock = database.lockShared(tableName);
+    database.insert(tableName, { { "amount", 1 } });
+    EXPECT_THROW(database.createIndex(tableName, columnName),
+                 db::DatabaseException);
+    EXPECT_THROW(database.findTable("missing"), db::DatabaseException);
+}
+
+TEST(Operation, Snapshots)
+{
+    auto& database = db::Database::getInstance();
+    std::string tableName = "ledger";
+    std::vector<std::string> selectAll{};
+    database.execute("create table ledger ({key, autoincrement} id : int32, "
+                     "{unique} account: string[16], {index} balance: int32)");
+    auto& table = *database.getTables()[tableName];
+    for (int i = 0; i < 100; ++i)
+    {
+        table.insert({ { "account", "acc" + std::to_string(i) },
+                       { "balance", i } });
+    }
+    auto total = [&](const db::Table::View& view)
+    {
+        int sum = 0;
+        for (size_t row = 0; row < view.size(); ++row)
+        {
+            sum += std::get<int>(view.value(row, "balance"));
+        }
+        return sum;
+    };
+
+    // every update appends a version, the open view keeps reading the old
+    // ones and keeps them from being collected
+    auto before = database.select(tableName, selectAll, nullptr);
+    auto cursor = database.openCursor(tableName, selectAll, nullptr);
+    for (int round = 0; round < 30; ++round)
+    {
+        database.execute("update ledger set balance = " +
+                         std::to_string(round) + " where id < 50");
+    }
+    database.execute("delete ledger where id >= 90");
+    EXPECT_EQ(table.size(), 90);
+    EXPECT_EQ(table.versions(), 100 + 30 * 50);
+    EXPECT_FALSE(table.collectGarbage());
+    EXPECT_EQ(total(*before), 99 * 100 / 2);
+    size_t streamed = 0;
+    while (cursor->next())
+    {
+        EXPECT_EQ(std::get<int>(cursor->value("balance")),
+                  static_cast<int>(streamed++));
+    }
+    EXPECT_EQ(streamed, 100);
+
+    auto after = database.select(tableName, selectAll, nullptr);
+    EXPECT_EQ(total(*after), 29 * 50 + (50 + 89) * 40 / 2);
+    std::vector<db::sort::SortKey> byBalance{ { "balance", true } };
+    auto top = database.select(tableName, selectAll, nullptr, byBalance,
+                               db::Limit{ 3 });
+    ASSERT_EQ(top->size(), 3);
+    EXPECT_EQ(std::get<int>(top->value(0, "balance")), 89);
+    EXPECT_EQ(query("select * from ledger where balance = 29")->size(), 50);
+
+    // once the snapshots are gone the ended versions go too, the rows and
+    // indexes stay intact
+    before.reset();
+    cursor.reset();
+    after.reset();
+    top.reset();
+    EXPECT_TRUE(table.collectGarbage());
+    EXPECT_EQ(table.versions(), 90);
+    EXPECT_EQ(query("select * from ledger where balance = 29")->size(), 50);
+    EXPECT_EQ(query("select * from ledger where balance > 80")->size(), 9);
+    EXPECT_THROW(table.insert({ { "account", std::string("acc7") } }),
+                 db::TableException);
+    table.insert({ { "account", std::string("acc95") } });
+
+    // writers go on while a reader holds the table and its snapshot
+    {
+        auto lock = database.lockShared(tableName);
+        auto held = database.select(tableName, selectAll, nullptr);
+        auto writer = std::async(std::launch::async,
+                                 [&]
+                                 {
+                                     for (int i = 0; i < 2000; ++i)
+                                     {
+                                         database.execute(
+                                             "update ledger set balance = 1 "
+                                             "where id = 3");
+                                     }
+                                 });
+        ASSERT_EQ(writer.wait_for(std::chrono::seconds(60)),
+                  std::future_status::ready);
+        writer.get();
+        EXPECT_EQ(held->size(), 91);
+        EXPECT_EQ(table.versions(), 91 + 2000);
+    }
+    // the next commit collects what piled up
+    database.execute("update ledger set balance = 2 where id = 3");
+    EXPECT_EQ(table.versions(), 91);
+
+    // collecting waits for an index still being built over the old rows
+    database.execute("delete ledger where id >= 60");
+    std::string indexed = "account";
+    database.createIndex(tableName, indexed);
+    EXPECT_TRUE(table.collectGarbage());
+    EXPECT_EQ(table.versions(), 60);
+    EXPECT_EQ(query("select * from ledger where account = \"acc50\"")->size(),
+              1);
+    EXPECT_EQ(query("select * from ledger where account = \"acc75\"")->size(),
+              0);
+}
+
+TEST(Operation, Transactions)
+{
+    auto& database = db::Database::getInstance();
+    database.execute("create table orders ({key, autoincrement} id : int32, "
+                     "{unique} code: string[16], {index} qty: int32)");
+    database.execute("create table stock ({key, autoincrement} id : int32, "
+                     "{unique} sku: string[16], level: int32)");
+    for (int i = 0; i < 20; ++i)
+    {
+        database.execute("insert (code = \"o" + std::to_string(i) +
+                         "\", qty = " + std::to_string(i % 4) + ") to orders");
+    }
+    auto count = [](const std::string& request)
+    { return query(request)->size(); };
+
+    // a statement failing midway changes nothing, unique keys included
+    EXPECT_THROW(database.execute("update orders set code = \"same\" where "
+                                  "qty = 1"),
+                 db::DatabaseException);
+    EXPECT_EQ(count("select * from orders where qty = 1"), 5);
+    EXPECT_EQ(count("select * from orders where code = \"same\""), 0);
+    EXPECT_THROW(database.execute("insert (code = \"o1\") to orders"),
+                 db::TableException);
+    database.execute("update orders set code = \"same\" where id = 1");
+    database.execute("update orders set code = \"o1\" where id = 1");
+
+    // buffered until commit, later statements see the earlier ones then
+    database.execute("begin");
+    EXPECT_TRUE(database.inTransaction());
+    EXPECT_THROW(database.execute("begin"), db::DatabaseException);
+    EXPECT_THROW(database.execute("insert (code = \"x\") to missing"),
+                 db::DatabaseException);
+    database.execute("insert (code = \"o20\", qty = 7) to orders");
+    database.execute("insert (code = \"o21\", qty = 7) to orders");
+    database.execute("update orders set qty = 8 where qty = 7");
+    database.execute("delete orders where qty = 0");
+    database.execute("insert (sku = \"s1\", level = 3) to stock");
+    EXPECT_EQ(count("select * from orders"), 20);
+    EXPECT_EQ(count("select * from stock"), 0);
+    database.execute("commit");
+    EXPECT_FALSE(database.inTransaction());
+    EXPECT_EQ(count("select * from orders"), 17);
+    EXPECT_EQ(count("select * from orders where qty = 8"), 2);
+    EXPECT_EQ(count("select * from orders where qty >= 7"), 2);
+    EXPECT_EQ(count("select * from stock"), 1);
+
+    // one failing statement fails the whole transaction, on every table
+    auto& orders = *database.getTables()["orders"];
+    size_t versions = orders.versions();
+    database.execute("begin");
+    database.execute("insert (code = \"o22\", qty = 9) to orders");
+    database.execute("update orders set qty = 9 where qty = 1");
+    database.execute("insert (sku = \"s2\", level = 1) to stock");
+    database.execute("insert (sku = \"s1\", level = 1) to stock");
+    EXPECT_THROW(database.execute("commit"), db::TableException);
+    EXPECT_FALSE(database.inTransaction());
+    EXPECT_EQ(count("select * from orders where qty = 9"), 0);
+    EXPECT_EQ(count("select * from orders where qty = 1"), 5);
+    EXPECT_EQ(count("select * from stock"), 1);
+    EXPECT_EQ(orders.size(), 17);
+    // the undone versions are garbage, never seen by any snapshot
+    EXPECT_GE(orders.versions(), versions);
+    database.execute("insert (code = \"o22\", qty = 9) to orders");
+    auto added = query("select * from orders where qty = 9");
+    ASSERT_EQ(added->size(), 1);
+    // sequences are rolled back too
+    EXPECT_EQ(std::get<int>(added->value(0, "id")), 22);
+
+    database.execute("begin");
+    database.execute("delete orders where qty >= 0");
+    database.execute("rollback");
+    EXPECT_EQ(count("select * from orders"), 18);
+    EXPECT_THROW(database.execute("commit"), db::DatabaseException);
+    EXPECT_THROW(database.execute("rollback"), db::DatabaseException);
+
+    // readers see every table of a transaction committed or none
+    database.execute("create table pairs_a ({key, autoincrement} id : int32)");
+    database.execute("create table pairs_b ({key, autoincrement} id : int32, "
+                     "{index} batch: int32)");
+    auto& pairsA = *database.getTables()["pairs_a"];
+    auto& pairsB = *database.getTables()["pairs_b"];
+    std::string nameA = "pairs_a";
+    std::string nameB = "pairs_b";
+    std::atomic<bool> done = false;
+    auto reader = std::async(std::launch::async,
+                             [&]
+                             {
+                                 size_t torn = 0;
+                                 while (!done)
+                                 {
+                                     // pairs_a commits first
+                                     size_t a = pairsA.size();
+                                     torn += pairsB.size() < a * 500;
+                                 }
+                                 return torn;
+                             });
+    for (int i = 0; i < 40; ++i)
+    {
+        database.begin();
+        database.insert(nameA, {});
+        for (int row = 0; row < 500; ++row)
+        {
+            database.insert(nameB, { { "batch", i } });
+        }
+        database.commit();
+    }
+    done = true;
+    EXPECT_EQ(reader.get(), 0);
+    EXPECT_EQ(pairsB.size(), 40 * 500);
+
+    auto directory =
+        std::filesystem::temp_directory_path() / "small-sql-transactions";
+    std::filesystem::remove_all(directory);
+    database.open(directory);
+    database.execute("create table ledger ({key, autoincrement} id : int32, "
+                     "{unique} account: string[16], balance: int32)");
+    database.execute("begin");
+    for (int i = 0; i < 100; ++i)
+    {
+        database.execute("insert (account = \"a" + std::to_string(i) +
+                         "\", balance = 10) to ledger");
+    }
+    database.execute("update ledger set balance = 20 where id < 50");
+    database.execute("commit");
+
+    // a transaction goes to one log, tables logged elsewhere are refused
+    database.execute("create table audit ({key, autoincrement} id : int32, "
+                     "note: string[16])");
+    auto& ledger = *database.getTables()["ledger"];
+    auto& audit = *database.getTables()["audit"];
+    audit.setLog(std::make_shared<db::wal::Log>(directory / "elsewhere.log"));
+    database.execute("begin");
+    database.execute("insert (account = \"apart\") to ledger");
+    database.execute("insert (note = \"apart\") to audit");
+    EXPECT_THROW(database.execute("commit"), db::DatabaseException);
+    EXPECT_FALSE(database.inTransaction());
+    EXPECT_EQ(count("select * from ledger where account = \"apart\""), 0);
+    EXPECT_EQ(audit.size(), 0);
+    audit.setLog(ledger.getLog());
+    database.close();
+    auto log = directory / "wal-0.log";
+    auto size = std::filesystem::file_size(log);
+
+    database.open(directory);
+    database.execute("begin");
+    database.execute("update ledger set balance = 0 where id = 0");
+    database.execute("insert (account = \"late\") to ledger");
+    database.execute("commit");
+    database.close();
+    // a transaction torn anywhere is dropped as a whole
+    std::filesystem::resize_file(log, std::filesystem::file_size(log) - 4);
+    database.open(directory);
+    EXPECT_EQ(std::filesystem::file_size(log), size);
+    EXPECT_EQ(count("select * from ledger"), 100);
+    EXPECT_EQ(count("select * from ledger where balance = 20"), 50);
+    EXPECT_EQ(count("select * from ledger where account = \"late\""), 0);
+    database.close();
+    std::filesystem::remove_all(directory);
+}